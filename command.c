@@ -0,0 +1,683 @@
+#include "command.h"
+#include "fsfind.h"
+#include "fstext.h"
+#include "terminal.h"
+#include "trie.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Commands in registration order, indexed by an open-addressing hash table of
+// slot numbers (-1 = empty) kept at most half full.
+static Command* commands = NULL;
+static int commands_count = 0;
+static int commands_capacity = 0;
+static int* command_slots = NULL;
+static int command_slot_count = 0;  // Power of two
+static Trie* command_names = NULL;  // Same names in sorted prefix order, for completion
+
+static unsigned int command_hash(const char* name) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns the hash slot holding name, or the empty slot where it would go
+static int command_probe(const char* name) {
+    unsigned int mask = (unsigned int)command_slot_count - 1;
+    unsigned int slot = command_hash(name) & mask;
+    while (command_slots[slot] >= 0 && strcmp(commands[command_slots[slot]].name, name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return (int)slot;
+}
+
+static void command_rehash(int slot_count) {
+    free(command_slots);
+    command_slots = malloc(sizeof(int) * slot_count);
+    command_slot_count = slot_count;
+    for (int i = 0; i < slot_count; i++) command_slots[i] = -1;
+    for (int i = 0; i < commands_count; i++) {
+        command_slots[command_probe(commands[i].name)] = i;
+    }
+}
+
+void command_register_filter(const char* name, const char* usage, const char* description,
+                             CommandHandler handler, CommandFilter filter, CommandFinish finish) {
+    if (command_slot_count == 0) {
+        command_rehash(64);
+    }
+
+    int slot = command_probe(name);
+    if (command_slots[slot] >= 0) {
+        // Re-registering a name replaces the previous handler
+        Command* existing = &commands[command_slots[slot]];
+        existing->usage = usage;
+        existing->description = description;
+        existing->handler = handler;
+        existing->filter = filter;
+        existing->finish = finish;
+        return;
+    }
+
+    if (commands_count == commands_capacity) {
+        commands_capacity = commands_capacity ? commands_capacity * 2 : 32;
+        commands = realloc(commands, sizeof(Command) * commands_capacity);
+    }
+    commands[commands_count] = (Command){name, usage, description, handler, filter, finish};
+    command_slots[slot] = commands_count++;
+
+    if (!command_names) command_names = trie_create();
+    trie_insert(command_names, name, (void*)(intptr_t)commands_count);  // Index + 1, never NULL
+
+    if (commands_count * 2 > command_slot_count) {
+        command_rehash(command_slot_count * 2);
+    }
+}
+
+void command_register(const char* name, const char* usage, const char* description, CommandHandler handler) {
+    command_register_filter(name, usage, description, handler, NULL, NULL);
+}
+
+const Command* command_find(const char* name) {
+    if (command_slot_count == 0) return NULL;
+    int slot = command_probe(name);
+    return command_slots[slot] >= 0 ? &commands[command_slots[slot]] : NULL;
+}
+
+const Trie* command_index(void) {
+    if (!command_names) command_names = trie_create();
+    return command_names;
+}
+
+int command_count(void) {
+    return commands_count;
+}
+
+const Command* command_at(int index) {
+    return (index >= 0 && index < commands_count) ? &commands[index] : NULL;
+}
+
+// command_parse, also noting which words have wildcards outside quotes
+static int command_parse_words(const char* line, char* buffer, size_t buffer_size, char** argv, int max_args,
+                               bool* globbed) {
+    int argc = 0;
+    size_t out = 0;
+    const char* p = line;
+
+    while (*p && argc < max_args) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (!*p) break;
+
+        char* word = buffer + out;
+        if (globbed) globbed[argc] = false;
+        while (*p && *p != ' ' && *p != '\t') {
+            if (*p == '"' || *p == '\'') {
+                char quote = *p++;
+                while (*p && *p != quote) {
+                    if (out + 1 < buffer_size) buffer[out++] = *p;
+                    p++;
+                }
+                if (*p) p++;  // Closing quote
+            } else {
+                if (globbed && (*p == '*' || *p == '?' || *p == '[')) globbed[argc] = true;
+                if (out + 1 < buffer_size) buffer[out++] = *p;
+                p++;
+            }
+        }
+        if (out >= buffer_size) break;
+        buffer[out++] = '\0';
+        argv[argc++] = word;
+    }
+    if (argc < max_args) argv[argc] = NULL;
+    return argc;
+}
+
+int command_parse(const char* line, char* buffer, size_t buffer_size, char** argv, int max_args) {
+    return command_parse_words(line, buffer, buffer_size, argv, max_args, NULL);
+}
+
+void command_stream_init(CommandStream* stream, CommandStreamSink sink, void* user) {
+    stream->used = 0;
+    stream->closed = false;
+    stream->sink = sink;
+    stream->user = user;
+}
+
+// Hands the buffered line to the sink as a NUL-terminated string
+static void command_stream_emit(CommandStream* stream) {
+    stream->buffer[stream->used] = '\0';
+    stream->sink(stream, stream->buffer, stream->used);
+    stream->used = 0;
+}
+
+bool command_stream_write(CommandStream* stream, const char* text, size_t length) {
+    while (length > 0 && !stream->closed) {
+        const char* newline = memchr(text, '\n', length);
+        size_t take = newline ? (size_t)(newline - text) : length;
+        size_t room = COMMAND_STREAM_SIZE - stream->used;
+
+        if (take > room) {
+            // Line does not fit: pass on what we have and keep going
+            memcpy(stream->buffer + stream->used, text, room);
+            stream->used += room;
+            text += room;
+            length -= room;
+            command_stream_emit(stream);
+            continue;
+        }
+
+        memcpy(stream->buffer + stream->used, text, take);
+        stream->used += take;
+        text += take;
+        length -= take;
+        if (newline) {
+            text++;
+            length--;
+            command_stream_emit(stream);
+        }
+    }
+    return !stream->closed;
+}
+
+void command_stream_flush(CommandStream* stream) {
+    if (stream->used > 0 && !stream->closed) {
+        command_stream_emit(stream);
+    }
+    stream->used = 0;
+}
+
+typedef struct {
+    const Command* command;
+    CommandContext ctx;
+    CommandStream out;
+    char buffer[COMMAND_LINE_LENGTH];
+    char* argv[COMMAND_MAX_ARGS + 1];
+    int argc;
+    int status;
+    char* expanded[COMMAND_MAX_ARGS];  // Paths glob expansion put into argv
+    int expanded_count;
+} CommandStage;
+
+// Feeds a line into the next stage of the pipeline
+static void command_pipe_sink(CommandStream* stream, const char* line, size_t length) {
+    CommandStage* next = stream->user;
+    if (!next->command->filter || next->ctx.done) {
+        stream->closed = true;
+        return;
+    }
+    next->command->filter(&next->ctx, line, length);
+    if (next->ctx.done) stream->closed = true;
+}
+
+// Appends a line to the redirect target through its open handle
+static void command_file_sink(CommandStream* stream, const char* line, size_t length) {
+    FsHandle* redirect = stream->user;
+    if (fs_write(redirect, line, length) != (long)length || fs_write(redirect, "\n", 1) != 1) {
+        stream->closed = true;
+    }
+}
+
+// Splits a line in place at unquoted '|' and cuts off a trailing unquoted '>'
+// or '>>' redirect. Quotes are left in so command_parse still groups words.
+// Returns the number of stages, or -1 if there are too many.
+static int command_split_pipeline(char* line, char** stages, char** redirect, bool* append) {
+    int count = 0;
+    char quote = 0;
+    stages[count++] = line;
+    *redirect = NULL;
+    *append = false;
+
+    for (char* p = line; *p; p++) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+        } else if (*p == '|') {
+            if (count == COMMAND_MAX_STAGES) return -1;
+            *p = '\0';
+            stages[count++] = p + 1;
+        } else if (*p == '>') {
+            *append = p[1] == '>';
+            *p = '\0';
+            *redirect = p + (*append ? 2 : 1);
+            break;
+        }
+    }
+    return count;
+}
+
+// Replaces each word with unquoted wildcards by the paths it matches, in
+// order. As in sh, a word that matches nothing is passed on as it is.
+static bool command_expand(CommandContext* ctx, CommandStage* stage, const bool* globbed) {
+    char* argv[COMMAND_MAX_ARGS + 1];
+    int argc = 0;
+    for (int i = 0; i < stage->argc; i++) {
+        char** paths = NULL;
+        long count = i > 0 && globbed[i] ? fs_glob_paths(ctx->fs, stage->argv[i], &paths) : 0;
+        if (count < 0) {
+            command_print(ctx, "Error: Out of memory");
+            return false;
+        }
+        if (argc + (count > 0 ? count : 1) > COMMAND_MAX_ARGS) {
+            for (long k = 0; k < count; k++) free(paths[k]);
+            free(paths);
+            command_printf(ctx, "Error: %s: Too many arguments", stage->argv[i]);
+            return false;
+        }
+        if (count == 0) argv[argc++] = stage->argv[i];
+        for (long k = 0; k < count; k++) {
+            argv[argc++] = paths[k];
+            stage->expanded[stage->expanded_count++] = paths[k];
+        }
+        free(paths);
+    }
+    memcpy(stage->argv, argv, argc * sizeof(char*));
+    stage->argv[argc] = NULL;
+    stage->argc = argc;
+    return true;
+}
+
+// Opens the redirect target, creating it, or truncating it for '>'
+static FsHandle* command_open_redirect(CommandContext* ctx, const char* path, bool append) {
+    int flags = FS_OPEN_APPEND | FS_OPEN_CREATE | (append ? 0 : FS_OPEN_TRUNCATE);
+    FsHandle* handle = fs_open(ctx->fs, path, flags);
+    if (!handle) command_printf(ctx, "Error: Cannot write to %s", path);
+    return handle;
+}
+
+int command_run_line(CommandContext* ctx, const char* line) {
+    char copy[COMMAND_LINE_LENGTH];
+    snprintf(copy, sizeof(copy), "%s", line);
+
+    char* sources[COMMAND_MAX_STAGES];
+    char* redirect_source;
+    bool append;
+    int count = command_split_pipeline(copy, sources, &redirect_source, &append);
+    if (count < 0) {
+        command_print(ctx, "Error: Too many commands in pipeline");
+        return -1;
+    }
+
+    CommandStage* stages = calloc(count, sizeof(CommandStage));
+    FsHandle* redirect = NULL;
+    char redirect_buffer[MAX_PATH];
+    int status = -1;
+
+    for (int i = 0; i < count; i++) {
+        CommandStage* stage = &stages[i];
+        bool globbed[COMMAND_MAX_ARGS];
+        stage->argc = command_parse_words(sources[i], stage->buffer, sizeof(stage->buffer),
+                                          stage->argv, COMMAND_MAX_ARGS, globbed);
+        if (stage->argc == 0) {
+            if (count == 1 && !redirect_source) status = 0;  // Blank line
+            else command_print(ctx, "Error: Empty command in pipeline");
+            goto cleanup;
+        }
+        stage->command = command_find(stage->argv[0]);
+        if (!stage->command) {
+            command_printf(ctx, "Unknown command: %s", stage->argv[0]);
+            goto cleanup;
+        }
+        if (!command_expand(ctx, stage, globbed)) goto cleanup;
+    }
+
+    if (redirect_source) {
+        char* target[2];
+        if (command_parse(redirect_source, redirect_buffer, sizeof(redirect_buffer), target, 2) != 1) {
+            command_print(ctx, "Error: Redirect needs exactly one file name");
+            goto cleanup;
+        }
+        redirect = command_open_redirect(ctx, target[0], append);
+        if (!redirect) goto cleanup;
+    }
+
+    // Each stage writes into its own stream, which pushes complete lines into
+    // the next stage's filter. The last stage writes to the redirect target or
+    // straight to the caller's output.
+    for (int i = 0; i < count; i++) {
+        CommandStage* stage = &stages[i];
+        stage->ctx = (CommandContext){ctx->term, ctx->fs, &stage->out, NULL, false,
+                                      ctx->cancel, ctx->script_depth};
+        if (i + 1 < count) {
+            command_stream_init(&stage->out, command_pipe_sink, &stages[i + 1]);
+        } else if (redirect) {
+            command_stream_init(&stage->out, command_file_sink, redirect);
+        } else {
+            stage->ctx.out = ctx->out;
+        }
+    }
+
+    // Start from the end so every consumer is ready before its producer runs
+    for (int i = count - 1; i >= 0; i--) {
+        CommandStage* stage = &stages[i];
+        // A section per stage, so nodes a handler holds outlive concurrent
+        // deletes without pinning the epoch for a whole job
+        fs_read_begin(ctx->fs);
+        stage->status = stage->command->handler(&stage->ctx, stage->argc, stage->argv);
+        fs_read_end(ctx->fs);
+        if (stage->status != 0) stage->ctx.done = true;
+    }
+
+    // Drain front to back: a filter finishes once everything upstream is flushed
+    for (int i = 0; i < count; i++) {
+        CommandStage* stage = &stages[i];
+        if (stage->command->finish) {
+            int result = stage->command->finish(&stage->ctx);
+            if (stage->status == 0) stage->status = result;
+        }
+        if (stage->ctx.out == &stage->out) {
+            command_stream_flush(&stage->out);
+        }
+    }
+    status = stages[count - 1].status;
+
+cleanup:
+    fs_close(redirect);
+    for (int i = 0; i < count; i++) {
+        for (int k = 0; k < stages[i].expanded_count; k++) free(stages[i].expanded[k]);
+    }
+    free(stages);
+    return status;
+}
+
+bool command_cancelled(CommandContext* ctx) {
+    return ctx->cancel && SDL_AtomicGet(ctx->cancel);
+}
+
+bool command_require_foreground(CommandContext* ctx, const char* name) {
+    if (!ctx->cancel) return true;
+    command_printf(ctx, "Error: %s cannot run in the background", name);
+    return false;
+}
+
+bool command_print(CommandContext* ctx, const char* text) {
+    if (!ctx->out) {
+        terminal_add_line(ctx->term, text);
+        return true;
+    }
+    command_stream_write(ctx->out, text, strlen(text));
+    return command_stream_write(ctx->out, "\n", 1) && !command_cancelled(ctx);
+}
+
+bool command_printf(CommandContext* ctx, const char* format, ...) {
+    char line[COMMAND_LINE_LENGTH];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    return command_print(ctx, line);
+}
+
+bool command_print_text(CommandContext* ctx, const char* text, size_t length) {
+    if (!ctx->out) {
+        terminal_add_text(ctx->term, text, length);
+        return true;
+    }
+    command_stream_write(ctx->out, text, length);
+    // Like terminal_add_text, text always ends on a line boundary
+    if (length == 0 || text[length - 1] != '\n') {
+        command_stream_write(ctx->out, "\n", 1);
+    }
+    return !ctx->out->closed && !command_cancelled(ctx);
+}
+
+// Generic text builtins
+
+// Runs a filter over the lines of a body of size bytes
+static void command_filter_text(CommandContext* ctx, const char* content, size_t size, CommandFilter filter) {
+    char line[COMMAND_STREAM_SIZE + 1];
+    const char* end = content + size;
+    while (content < end && !ctx->done && !command_cancelled(ctx)) {
+        const char* newline = memchr(content, '\n', end - content);
+        size_t length = (newline ? newline : end) - content;
+        if (length > COMMAND_STREAM_SIZE) length = COMMAND_STREAM_SIZE;
+        memcpy(line, content, length);
+        line[length] = '\0';
+        filter(ctx, line, length);
+        content = newline ? newline + 1 : end;
+    }
+}
+
+// Runs a filter over a file's lines, for "grep foo file" and friends
+static int command_filter_file(CommandContext* ctx, const char* path, CommandFilter filter) {
+    size_t size;
+    const char* content = fs_read_file_n(ctx->fs, path, &size);
+    if (!content) {
+        command_printf(ctx, "Error: %s: File not found or cannot be read.", path);
+        return 1;
+    }
+    command_filter_text(ctx, content, size, filter);
+    return 0;
+}
+
+static int command_cmd_echo(CommandContext* ctx, int argc, char** argv) {
+    char line[COMMAND_LINE_LENGTH];
+    size_t used = 0;
+    line[0] = '\0';
+    for (int i = 1; i < argc; i++) {
+        used += snprintf(line + used, sizeof(line) - used, i > 1 ? " %s" : "%s", argv[i]);
+        if (used >= sizeof(line)) break;
+    }
+    command_print(ctx, line);
+    return 0;
+}
+
+typedef struct {
+    const char* pattern;
+    bool ignore_case;
+    bool invert;
+    int matches;
+    const char* prefix;     // File name printed before each match, for grep -r
+} GrepState;
+
+// Searches all length bytes of text, so a NUL in a line does not end it
+static bool command_contains(const char* text, size_t length, const char* pattern, bool ignore_case) {
+    size_t n = strlen(pattern);
+    if (n == 0) return true;
+    for (size_t start = 0; start + n <= length; start++) {
+        if (!ignore_case) {
+            const char* first = memchr(text + start, pattern[0], length - n + 1 - start);
+            if (!first) return false;
+            start = first - text;
+            if (memcmp(first, pattern, n) == 0) return true;
+            continue;
+        }
+        size_t i = 0;
+        while (i < n && tolower((unsigned char)text[start + i]) == tolower((unsigned char)pattern[i])) i++;
+        if (i == n) return true;
+    }
+    return false;
+}
+
+static void command_grep_line(CommandContext* ctx, const char* line, size_t length) {
+    GrepState* state = ctx->state;
+    if (command_contains(line, length, state->pattern, state->ignore_case) != state->invert) {
+        state->matches++;
+        bool more = state->prefix ? command_printf(ctx, "%s:%s", state->prefix, line) : command_print(ctx, line);
+        if (!more) ctx->done = true;
+    }
+}
+
+static int command_grep_finish(CommandContext* ctx) {
+    GrepState* state = ctx->state;
+    if (!state) return 1;
+    int status = state->matches > 0 ? 0 : 1;
+    free(state);
+    ctx->state = NULL;
+    return status;
+}
+
+// A grep -r candidate, sorted by path
+typedef struct {
+    char* path;
+    FileNode* node;
+} GrepFile;
+
+static int command_compare_files(const void* a, const void* b) {
+    return strcmp(((const GrepFile*)a)->path, ((const GrepFile*)b)->path);
+}
+
+// grep -r: the trigram index picks the files that can match, which are then
+// scanned in path order
+static int command_grep_tree(CommandContext* ctx, const char* path) {
+    GrepState* state = ctx->state;
+    FileNode* root = fs_get_file(ctx->fs, path);
+    if (!root) {
+        command_printf(ctx, "Error: %s: No such file or directory", path);
+        return 1;
+    }
+    if (!root->is_directory) return command_filter_file(ctx, path, command_grep_line);
+
+    FileNode** nodes;
+    // Any file can have a line without the pattern
+    long count = fs_text_candidates(ctx->fs, state->invert ? "" : state->pattern, root, &nodes);
+    GrepFile* files = count > 0 ? malloc(count * sizeof(GrepFile)) : NULL;
+    if (count < 0 || (count > 0 && !files)) {
+        free(nodes);
+        command_print(ctx, "Error: Out of memory");
+        return 1;
+    }
+    long found = 0;
+    char buffer[MAX_PATH];
+    for (long i = 0; i < count; i++) {
+        if (fs_node_path(nodes[i], buffer, sizeof(buffer)) && (files[found].path = strdup(buffer))) {
+            files[found++].node = nodes[i];
+        }
+    }
+    free(nodes);
+    if (found > 1) qsort(files, found, sizeof(GrepFile), command_compare_files);
+
+    // The bodies are read from the nodes the index chose, with the sizes the
+    // index saw, so both agree on bytes past an embedded NUL. Between files
+    // nothing is held, so a long search lets reclamation move on; once it
+    // has, the remaining nodes may be gone and are looked up again.
+    bool stale = false;
+    for (long i = 0; i < found; i++) {
+        if (fs_read_quiesce(ctx->fs)) stale = true;
+        FileNode* node = stale ? fs_get_file(ctx->fs, files[i].path) : files[i].node;
+        size_t size;
+        const char* content = ctx->done || command_cancelled(ctx) || !node || node->is_directory
+                                  ? NULL : fs_file_body(ctx->fs, node, &size);
+        if (content) {
+            state->prefix = files[i].path;
+            command_filter_text(ctx, content, size, command_grep_line);
+        }
+        free(files[i].path);
+    }
+    state->prefix = NULL;
+    free(files);
+    return 0;
+}
+
+static int command_cmd_grep(CommandContext* ctx, int argc, char** argv) {
+    GrepState state = {NULL, false, false, 0, NULL};
+    bool recursive = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+        for (const char* flag = argv[i] + 1; *flag; flag++) {
+            if (*flag == 'i') state.ignore_case = true;
+            else if (*flag == 'v') state.invert = true;
+            else if (*flag == 'r') recursive = true;
+        }
+    }
+    if (i >= argc) {
+        command_print(ctx, "Usage: grep [-i] [-v] [-r] <pattern> [path]");
+        return 1;
+    }
+    // argv lives in the pipeline stage, so the pattern outlives the filter
+    state.pattern = argv[i++];
+    ctx->state = malloc(sizeof(GrepState));
+    *(GrepState*)ctx->state = state;
+    if (recursive) {
+        int status = command_grep_tree(ctx, i < argc ? argv[i] : ".");
+        ctx->done = true;  // Searches files, not piped input
+        return status;
+    }
+    return i < argc ? command_filter_file(ctx, argv[i], command_grep_line) : 0;
+}
+
+static void command_head_line(CommandContext* ctx, const char* line, size_t length) {
+    int* remaining = ctx->state;
+    if (*remaining > 0) {
+        command_print(ctx, line);
+        (*remaining)--;
+    }
+    if (*remaining == 0) ctx->done = true;
+}
+
+static int command_head_finish(CommandContext* ctx) {
+    free(ctx->state);
+    ctx->state = NULL;
+    return 0;
+}
+
+static int command_cmd_head(CommandContext* ctx, int argc, char** argv) {
+    int lines = 10;
+    int i = 1;
+    if (i < argc && strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+        lines = atoi(argv[i + 1]);
+        i += 2;
+    } else if (i < argc && argv[i][0] == '-' && isdigit((unsigned char)argv[i][1])) {
+        lines = atoi(argv[i] + 1);
+        i++;
+    }
+    ctx->state = malloc(sizeof(int));
+    *(int*)ctx->state = lines < 0 ? 0 : lines;
+    if (lines <= 0) ctx->done = true;
+    return i < argc ? command_filter_file(ctx, argv[i], command_head_line) : 0;
+}
+
+typedef struct {
+    long lines;
+    long words;
+    long bytes;
+} WcState;
+
+static void command_wc_line(CommandContext* ctx, const char* line, size_t length) {
+    WcState* state = ctx->state;
+    state->lines++;
+    state->bytes += (long)length + 1;
+    bool in_word = false;
+    for (size_t i = 0; i < length; i++) {
+        bool space = isspace((unsigned char)line[i]) != 0;
+        if (!space && !in_word) state->words++;
+        in_word = !space;
+    }
+}
+
+static int command_wc_finish(CommandContext* ctx) {
+    WcState* state = ctx->state;
+    if (!state) return 1;
+    command_printf(ctx, "%ld %ld %ld", state->lines, state->words, state->bytes);
+    free(state);
+    ctx->state = NULL;
+    return 0;
+}
+
+static int command_cmd_wc(CommandContext* ctx, int argc, char** argv) {
+    ctx->state = calloc(1, sizeof(WcState));
+    if (argc > 1 && command_filter_file(ctx, argv[1], command_wc_line) != 0) {
+        // No counts to report for a missing file
+        free(ctx->state);
+        ctx->state = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+void command_register_filters(void) {
+    command_register("echo", "echo <text>", "Print text", command_cmd_echo);
+    command_register_filter("grep", "grep [-r] <pattern> [path]", "Print lines containing pattern (-i, -v, -r)",
+                            command_cmd_grep, command_grep_line, command_grep_finish);
+    command_register_filter("head", "head [-n N]", "Print the first N lines (default 10)",
+                            command_cmd_head, command_head_line, command_head_finish);
+    command_register_filter("wc", "wc [file]", "Count lines, words and bytes",
+                            command_cmd_wc, command_wc_line, command_wc_finish);
+}
@@ -0,0 +1,116 @@
+#ifndef MICROOS_COMMAND_H
+#define MICROOS_COMMAND_H
+
+#include "filesystem.h"
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define COMMAND_MAX_ARGS 64        // Arguments passed to a handler, including argv[0]
+#define COMMAND_LINE_LENGTH 1024   // Longest command line the parser accepts
+#define COMMAND_STREAM_SIZE 4096   // Bytes a stream buffers before it must hand a line on
+#define COMMAND_MAX_STAGES 8       // Commands in one pipeline
+
+struct Terminal;
+struct CommandStream;
+struct Trie;
+
+// Receives one line (without its newline) from a stream
+typedef void (*CommandStreamSink)(struct CommandStream* stream, const char* line, size_t length);
+
+// Bounded output stream. Bytes are buffered only until a line is complete and
+// then pushed to the sink, so no stage ever holds more than one line of
+// another stage's output. A line longer than the buffer is split.
+typedef struct CommandStream {
+    char buffer[COMMAND_STREAM_SIZE];
+    size_t used;
+    bool closed;              // The consumer wants no more input
+    CommandStreamSink sink;
+    void* user;
+} CommandStream;
+
+// State a builtin runs against. Handlers write output through command_print
+// instead of touching the terminal directly.
+typedef struct CommandContext {
+    struct Terminal* term;
+    FileSystem* fs;
+    CommandStream* out;       // Where command_print writes; NULL means the terminal
+    void* state;              // Per-run state owned by a filter
+    bool done;                // Set by a filter that needs no more input
+    SDL_atomic_t* cancel;     // Non-NULL when running as a background job
+    int script_depth;         // Nested run calls, to stop runaway recursion
+} CommandContext;
+
+// A builtin gets argv-style arguments (argv[0] is the command name) and
+// returns 0 on success. For a filter this only sets up ctx->state.
+typedef int (*CommandHandler)(CommandContext* ctx, int argc, char** argv);
+
+// Filters also get every line piped into them, then a finish call once the
+// upstream stage is done. finish runs even if the handler failed, must release
+// ctx->state (which may be NULL) and returns the status.
+typedef void (*CommandFilter)(CommandContext* ctx, const char* line, size_t length);
+typedef int (*CommandFinish)(CommandContext* ctx);
+
+typedef struct {
+    const char* name;
+    const char* usage;        // e.g. "cd <dir>", shown by help
+    const char* description;
+    CommandHandler handler;
+    CommandFilter filter;     // NULL for commands that ignore piped input
+    CommandFinish finish;
+} Command;
+
+// Adds a builtin to the global command table, replacing any command with the
+// same name. Strings must outlive the table (string literals in practice).
+void command_register(const char* name, const char* usage, const char* description, CommandHandler handler);
+
+// Same as command_register for a command that reads piped input.
+void command_register_filter(const char* name, const char* usage, const char* description,
+                             CommandHandler handler, CommandFilter filter, CommandFinish finish);
+
+// Registers the generic text builtins (echo, grep, head, wc).
+void command_register_filters(void);
+
+// Hashed O(1) lookup of a registered command, or NULL.
+const Command* command_find(const char* name);
+
+// Registered commands in registration order, for help.
+int command_count(void);
+const Command* command_at(int index);
+
+// Prefix index over command names, for Tab completion.
+const struct Trie* command_index(void);
+
+// Splits a line into argv without modifying it. Words are separated by
+// whitespace; single or double quotes group words. The words are written into
+// buffer. Returns argc.
+int command_parse(const char* line, char* buffer, size_t buffer_size, char** argv, int max_args);
+
+// Parses and runs one command line, which may be a pipeline ("a | b | c")
+// ending in "> file" or ">> file". Arguments with unquoted * ? or [ expand
+// to the paths they match. Returns the last stage's result, or -1 if a
+// command is unknown or the line is malformed.
+int command_run_line(CommandContext* ctx, const char* line);
+
+// Stream plumbing. write returns false once the consumer has closed the
+// stream, so producers can stop early.
+void command_stream_init(CommandStream* stream, CommandStreamSink sink, void* user);
+bool command_stream_write(CommandStream* stream, const char* text, size_t length);
+void command_stream_flush(CommandStream* stream);
+
+// True once the job running this command has been cancelled. Long-running
+// handlers should poll it; the print helpers already stop producing output.
+bool command_cancelled(CommandContext* ctx);
+
+// Builtins that touch the terminal or OS state directly call this first. On a
+// job thread it prints an error and returns false.
+bool command_require_foreground(CommandContext* ctx, const char* name);
+
+// Output helpers for handlers. print and printf emit one line; print_text
+// emits raw text that may span several lines. All return false once the
+// downstream stage stops reading or the job is cancelled.
+bool command_print(CommandContext* ctx, const char* text);
+bool command_printf(CommandContext* ctx, const char* format, ...);
+bool command_print_text(CommandContext* ctx, const char* text, size_t length);
+
+#endif // MICROOS_COMMAND_H
@@ -1,5 +1,6 @@
 #include "fileui.h"    // Assuming both UI headers share the same fileui.h
 #include "editor.h"
+#include "glyph_atlas.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -124,20 +125,12 @@ void editor_render(TextEditor* editor, SDL_Renderer* renderer, TTF_Font* font) {
             SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
             SDL_RenderFillRect(renderer, &btn);
             
-            SDL_Surface* surface = TTF_RenderText_Solid(font, buttons[i], 
-                                                      (SDL_Color){0, 0, 0, 255});
-            if (surface) {
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_Rect text_pos = {
-                    btn.x + (btn.w - surface->w) / 2,
-                    btn.y + (btn.h - surface->h) / 2,
-                    surface->w,
-                    surface->h
-                };
-                SDL_RenderCopy(renderer, texture, NULL, &text_pos);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(surface);
-            }
+            int text_w, text_h;
+            glyph_atlas_size_text(renderer, font, buttons[i], &text_w, &text_h);
+            glyph_atlas_draw_text(renderer, font, buttons[i],
+                                  btn.x + (btn.w - text_w) / 2,
+                                  btn.y + (btn.h - text_h) / 2,
+                                  (SDL_Color){0, 0, 0, 255});
         }
     }
 
@@ -160,20 +153,8 @@ void editor_render(TextEditor* editor, SDL_Renderer* renderer, TTF_Font* font) {
             if (written >= sizeof(num)) {
                 fprintf(stderr, "Line number truncation detected in editor_render\n");
             }
-            SDL_Surface* surface = TTF_RenderText_Solid(font, num, 
-                                                      (SDL_Color){128, 128, 128, 255});
-            if (surface) {
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_Rect pos = {
-                    ruler.x + i * 50 + 5,
-                    ruler.y + 2,
-                    surface->w,
-                    surface->h
-                };
-                SDL_RenderCopy(renderer, texture, NULL, &pos);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(surface);
-            }
+            glyph_atlas_draw_text(renderer, font, num, ruler.x + i * 50 + 5, ruler.y + 2,
+                                  (SDL_Color){128, 128, 128, 255});
         }
     }
 
@@ -205,20 +186,8 @@ void editor_render(TextEditor* editor, SDL_Renderer* renderer, TTF_Font* font) {
             }
 
             // Draw text
-            SDL_Surface* surface = TTF_RenderText_Solid(font, editor->lines[i].text,
-                                                      editor->text_color);
-            if (surface) {
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_Rect pos = {
-                    content.x + 5 - editor->scroll_x,
-                    y,
-                    surface->w,
-                    surface->h
-                };
-                SDL_RenderCopy(renderer, texture, NULL, &pos);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(surface);
-            }
+            glyph_atlas_draw_text_n(renderer, font, editor->lines[i].text, editor->lines[i].length,
+                                    content.x + 5 - editor->scroll_x, y, editor->text_color);
         }
         y += editor->font_size + 2;
     }
@@ -322,18 +291,20 @@ bool editor_save(TextEditor* editor, FileSystem* fs) {
 }
 
 bool editor_load(TextEditor* editor, FileSystem* fs, const char* path) {
-    char* content = fs_read_file(fs, path);
+    const char* content = fs_read_file(fs, path);
     if (!content) return false;
 
     editor->file_path = strdup(path);
     editor->line_count = 0;
 
-    char* line = strtok(content, "\n");
-    while (line && editor->line_count < MAX_DOCUMENT_LINES) {
-        editor->lines[editor->line_count].text = strdup(line);
-        editor->lines[editor->line_count].length = strlen(line);
+    // Split without writing into the file body, which the filesystem owns
+    while (*content && editor->line_count < MAX_DOCUMENT_LINES) {
+        const char* newline = strchr(content, '\n');
+        size_t length = newline ? (size_t)(newline - content) : strlen(content);
+        editor->lines[editor->line_count].text = strndup(content, length);
+        editor->lines[editor->line_count].length = (int)length;
         editor->line_count++;
-        line = strtok(NULL, "\n");
+        content += length + (newline ? 1 : 0);
     }
 
     return true;
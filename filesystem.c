@@ -1,50 +1,297 @@
 #include "filesystem.h"
+#include "fsepoch.h"
+#include "fsimage.h"
+#include "fsjournal.h"
+#include "fsmount.h"
+#include "fssnapshot.h"
+#include "fsstore.h"
+#include "fstext.h"
+#include "fswatch.h"
+#include "command.h"
+#include "trie.h"
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-// Helper function to split path
-static char** split_path(const char* path, int* count) {
-    char* path_copy = strdup(path);
-    char** parts = malloc(sizeof(char*) * MAX_PATH);
-    *count = 0;
-    
-    char* token = strtok(path_copy, "/");
-    while (token != NULL) {
-        parts[*count] = strdup(token);
-        (*count)++;
-        token = strtok(NULL, "/");
+// Fixed-size nodes come from slabs so a large tree is a few big allocations
+typedef struct FsSlab {
+    struct FsSlab* next;
+    FileNode nodes[FS_SLAB_NODES];
+} FsSlab;
+
+// Interned name, refcounted by the nodes that use it
+typedef struct FsName {
+    struct FsName* next;    // Bucket chain
+    unsigned hash;
+    int refs;
+    char text[];
+} FsName;
+
+static FileNode* fs_alloc_node(FileSystem* fs) {
+    if (!fs->free_nodes) {
+        FsSlab* slab = malloc(sizeof(FsSlab));
+        if (!slab) return NULL;
+        slab->next = fs->slabs;
+        fs->slabs = slab;
+        for (int i = FS_SLAB_NODES - 1; i >= 0; i--) {
+            slab->nodes[i].parent = fs->free_nodes;
+            fs->free_nodes = &slab->nodes[i];
+        }
     }
-    
-    free(path_copy);
-    return parts;
+    FileNode* node = fs->free_nodes;
+    fs->free_nodes = node->parent;
+    memset(node, 0, sizeof(FileNode));
+    return node;
+}
+
+static unsigned fs_hash_name(const char* name) {
+    unsigned hash = 2166136261u;  // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static void fs_grow_names(FileSystem* fs) {
+    int buckets = fs->name_buckets ? fs->name_buckets * 2 : 256;
+    FsName** names = calloc(buckets, sizeof(FsName*));
+    for (int i = 0; i < fs->name_buckets; i++) {
+        FsName* name = fs->names[i];
+        while (name) {
+            FsName* next = name->next;
+            name->next = names[name->hash & (buckets - 1)];
+            names[name->hash & (buckets - 1)] = name;
+            name = next;
+        }
+    }
+    free(fs->names);
+    fs->names = names;
+    fs->name_buckets = buckets;
+}
+
+// Returns the shared copy of text, adding a reference
+static const char* fs_intern(FileSystem* fs, const char* text) {
+    if (fs->name_count >= fs->name_buckets) fs_grow_names(fs);
+    unsigned hash = fs_hash_name(text);
+    FsName** bucket = &fs->names[hash & (fs->name_buckets - 1)];
+    for (FsName* name = *bucket; name; name = name->next) {
+        if (name->hash == hash && strcmp(name->text, text) == 0) {
+            name->refs++;
+            return name->text;
+        }
+    }
+    size_t length = strlen(text);
+    FsName* name = malloc(sizeof(FsName) + length + 1);
+    memcpy(name->text, text, length + 1);
+    name->hash = hash;
+    name->refs = 1;
+    name->next = *bucket;
+    *bucket = name;
+    fs->name_count++;
+    return name->text;
+}
+
+static void fs_release_name(FileSystem* fs, const char* text) {
+    FsName* name = (FsName*)(text - offsetof(FsName, text));
+    if (--name->refs > 0) return;
+    FsName** link = &fs->names[name->hash & (fs->name_buckets - 1)];
+    while (*link != name) link = &(*link)->next;
+    *link = name->next;
+    fs->name_count--;
+    fs_epoch_retire(fs->epoch, NULL, name, NULL);  // Readers may be comparing it
+}
+
+typedef struct {
+    FsVisitor visit;
+    void* user;
+} FsChildVisit;
+
+static bool fs_visit_child(const char* name, void* value, void* user) {
+    FsChildVisit* child_visit = user;
+    return child_visit->visit(value, child_visit->user);
+}
+
+void fs_each_child(const FileNode* dir, const char* prefix, int skip, FsVisitor visit, void* user) {
+    if (!dir || !dir->is_directory) return;
+    FsChildVisit child_visit = {visit, user};
+    trie_each_range(SDL_AtomicGetPtr((void**)&dir->index), prefix, skip, fs_visit_child, &child_visit);
 }
 
-// New function: computes size of a node.
-// For files, returns file->size. For directories, recursively sums sizes.
 size_t fs_get_size(FileNode* node) {
-    if (!node) return 0;
-    if (!node->is_directory)
-        return node->size;
-    size_t total = 0;
-    for (int i = 0; i < node->child_count; i++) {
-        total += fs_get_size(node->children[i]);
+    return node ? node->size : 0;
+}
+
+// Applies a change in bytes and file count to every directory from dir up
+// to the root, keeping the aggregates exact in O(depth)
+static void fs_propagate(FileNode* dir, long long bytes, long long files) {
+    for (; dir; dir = dir->parent) {
+        dir->size += bytes;
+        dir->file_count += files;
     }
-    return total;
 }
 
-FileSystem* fs_init(void) {
-    FileSystem* fs = malloc(sizeof(FileSystem));
-    fs->root = malloc(sizeof(FileNode));
-    strcpy(fs->root->name, "/");
+unsigned fs_get_generation(const FileNode* node) {
+    return node ? node->generation : 0;
+}
+
+// Stamps node and its ancestors with a new change number and queues the
+// watches on them. Numbers only grow, so a node freed and reused never
+// matches a generation remembered for the old one.
+static void fs_changed(FileSystem* fs, FileNode* node) {
+    unsigned generation = ++fs->changes;
+    for (int depth = 0; node; node = node->parent, depth++) {
+        node->generation = generation;
+        if (node->watched) fs_watch_notify(fs, node, depth);
+    }
+}
+
+// Logs a change to node for crash recovery, if a journal is open
+static void fs_log(FileSystem* fs, FsJournalOp op, const FileNode* node, const char* data, size_t length) {
+    char path[MAX_PATH];
+    if (fs->journal && fs_node_path(node, path, sizeof(path))) {
+        fs_journal_record(fs, op, path, node->is_directory, data, length);
+    }
+}
+
+static void fs_log_at(FileSystem* fs, FsJournalOp op, const FileNode* node, size_t offset, const char* data,
+                      size_t length) {
+    char path[MAX_PATH];
+    if (fs->journal && fs_node_path(node, path, sizeof(path))) {
+        fs_journal_record_at(fs, op, path, offset, data, length);
+    }
+}
+
+// Bytes and files a node contributes to its ancestors
+static long long fs_node_files(const FileNode* node) {
+    return node->is_directory ? (long long)node->file_count : 1;
+}
+
+// Walks path from base, splitting components in place. "." and ".." behave
+// as in a shell; ".." at the root stays at the root. Host directories on the
+// way, and the one reached, are listed if they have not been yet.
+static FileNode* fs_resolve(FileSystem* fs, FileNode* base, const char* path, size_t path_length) {
+    FileNode* current = base;
+    const char* p = path;
+    const char* end = path + path_length;
+    while (p < end) {
+        if (*p == '/') {
+            p++;
+            continue;
+        }
+        const char* slash = memchr(p, '/', end - p);
+        size_t length = (slash ? slash : end) - p;
+        if (length == 1 && p[0] == '.') {
+            // Stay in the current directory
+        } else if (length == 2 && p[0] == '.' && p[1] == '.') {
+            if (current->parent) current = current->parent;
+        } else {
+            if (current->unloaded) fs_mount_load(fs, current);
+            current = current->is_directory ? trie_find_n(SDL_AtomicGetPtr((void**)&current->index), p, length) : NULL;
+            if (!current) return NULL;
+        }
+        p += length;
+    }
+    if (current->unloaded && current->is_directory) fs_mount_load(fs, current);
+    return current;
+}
+
+static unsigned fs_dentry_hash(const FileNode* base, const char* path) {
+    unsigned hash = fs_hash_name(path);
+    uintptr_t bits = (uintptr_t)base;
+    return hash ^ (unsigned)(bits >> 4) * 2654435761u;
+}
+
+// Resolves a path through the dentry cache. Only hits are cached, so creating
+// a node never stales an entry; deletes and renames bump the generation.
+// Entries are seqlocks: a reader keeps what it copied only if no one wrote
+// the entry meanwhile, and a thread finding one being written skips caching.
+static FileNode* fs_lookup(FileSystem* fs, FileNode* base, const char* path) {
+    size_t length = strlen(path);
+    if (length >= FS_DENTRY_PATH) return fs_resolve(fs, base, path, length);
+
+    unsigned hash = fs_dentry_hash(base, path);
+    FsDentry* entry = &fs->dentries[hash & (FS_DENTRY_SLOTS - 1)];
+    unsigned generation = (unsigned)SDL_AtomicGet(&fs->generation);
+    int seq = SDL_AtomicGet(&entry->seq);
+    if (!(seq & 1) && entry->generation == generation && entry->hash == hash && entry->base == base &&
+        strcmp(entry->path, path) == 0) {
+        FileNode* node = entry->node;
+        SDL_MemoryBarrierAcquire();
+        if (SDL_AtomicGet(&entry->seq) == seq) return node;
+    }
+
+    // Cached under the generation read before the walk, so a delete that
+    // races with it leaves the entry stale rather than wrong
+    FileNode* node = fs_resolve(fs, base, path, length);
+    if (node && !(seq & 1) && SDL_AtomicCAS(&entry->seq, seq, seq + 1)) {
+        entry->base = base;
+        entry->node = node;
+        entry->hash = hash;
+        entry->generation = generation;
+        memcpy(entry->path, path, length + 1);
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&entry->seq, seq + 2);
+    }
+    return node;
+}
+
+// Drops every cached lookup in O(1)
+static void fs_invalidate(FileSystem* fs) {
+    if (SDL_AtomicAdd(&fs->generation, 1) + 1 != 0) return;
+    // Wrapped around: old entries could look current again
+    for (int i = 0; i < FS_DENTRY_SLOTS; i++) {
+        FsDentry* entry = &fs->dentries[i];
+        int seq;
+        do {
+            seq = SDL_AtomicGet(&entry->seq) & ~1;
+        } while (!SDL_AtomicCAS(&entry->seq, seq, seq + 1));
+        entry->generation = 0;
+        SDL_AtomicSet(&entry->seq, seq + 2);
+    }
+    SDL_AtomicSet(&fs->generation, 1);
+}
+
+// Finds the directory a new entry at path goes into and the entry's name.
+// Returns NULL if the parent does not exist or the name is unusable.
+static FileNode* fs_resolve_parent(FileSystem* fs, const char* path, char* name) {
+    size_t length = strlen(path);
+    while (length > 1 && path[length - 1] == '/') length--;  // "dir/" names dir
+    size_t start = length;
+    while (start > 0 && path[start - 1] != '/') start--;
+
+    size_t name_length = length - start;
+    if (name_length == 0 || name_length >= MAX_FILENAME) return NULL;
+    memcpy(name, path + start, name_length);
+    name[name_length] = '\0';
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return NULL;
+
+    FileNode* base = path[0] == '/' ? fs->root : fs->current_dir;
+    FileNode* parent = fs_resolve(fs, base, path, start);
+    return parent && parent->is_directory ? parent : NULL;
+}
+
+FileSystem* fs_create(void) {
+    FileSystem* fs = calloc(1, sizeof(FileSystem));
+    fs->dentries = calloc(FS_DENTRY_SLOTS, sizeof(FsDentry));
+    SDL_AtomicSet(&fs->generation, 1);
+    fs->write_lock = SDL_CreateMutex();
+    fs->epoch = fs_epoch_create();
+    fs->store = fs_store_create(fs->epoch);
+    fs->root = fs_alloc_node(fs);
+    fs->root->name = fs_intern(fs, "/");
     fs->root->is_directory = true;
     fs->root->created = time(NULL);
     fs->root->modified = time(NULL);
-    fs->root->size = 0;
-    fs->root->parent = NULL;
-    fs->root->child_count = 0;
     fs->current_dir = fs->root;
+    return fs;
+}
+
+FileSystem* fs_init(void) {
+    FileSystem* fs = fs_create();
     
     // Create some default directories
     fs_create_file(fs, "/home", true);
@@ -58,186 +305,807 @@ FileSystem* fs_init(void) {
     return fs;
 }
 
-FileNode* fs_create_file(FileSystem* fs, const char* path, bool is_directory) {
-    int count;
-    char** parts = split_path(path, &count);
-    
-    FileNode* current = fs->root;
-    FileNode* parent = NULL;
-    
-    // Navigate to parent directory
-    for (int i = 0; i < count - 1; i++) {
-        bool found = false;
-        for (int j = 0; j < current->child_count; j++) {
-            if (strcmp(current->children[j]->name, parts[i]) == 0) {
-                parent = current;
-                current = current->children[j];
-                found = true;
-                break;
-            }
-        }
-        if (!found) return NULL;
+void fs_write_begin(FileSystem* fs) {
+    SDL_LockMutex(fs->write_lock);
+}
+
+void fs_write_end(FileSystem* fs) {
+    // Writers reclaim, in batches so a burst of changes stays cheap
+    if (fs->epoch->pending >= FS_EPOCH_BATCH) fs_epoch_poll(fs->epoch);
+    SDL_UnlockMutex(fs->write_lock);
+}
+
+void fs_read_begin(FileSystem* fs) {
+    fs_epoch_enter(fs->epoch);
+}
+
+void fs_read_end(FileSystem* fs) {
+    fs_epoch_leave(fs->epoch);
+}
+
+bool fs_read_quiesce(FileSystem* fs) {
+    return fs_epoch_quiesce(fs->epoch);
+}
+
+void fs_reclaim(FileSystem* fs) {
+    if (SDL_TryLockMutex(fs->write_lock) != 0) return;  // The busy writer will get to it
+    fs_epoch_poll(fs->epoch);
+    SDL_UnlockMutex(fs->write_lock);
+}
+
+// Where directory indexes put the pools they replace
+static void fs_retire_memory(void* memory, void* user) {
+    FileSystem* fs = user;
+    fs_epoch_retire(fs->epoch, NULL, memory, NULL);
+}
+
+// A freed node goes back to the slabs only once no reader can hold it
+static void fs_recycle_node(void* memory, void* user) {
+    FileSystem* fs = user;
+    FileNode* node = memory;
+    node->parent = fs->free_nodes;
+    fs->free_nodes = node;
+}
+
+// Readers may look at a directory's index at any moment, so it is published whole
+static Trie* fs_child_index(FileSystem* fs, FileNode* dir) {
+    if (!dir->index) {
+        Trie* index = trie_create_shared(fs_retire_memory, fs);
+        SDL_AtomicSetPtr((void**)&dir->index, index);
+    }
+    return dir->index;
+}
+
+FileNode* fs_make_child(FileSystem* fs, FileNode* dir, const char* name, bool is_directory) {
+    size_t length = strlen(name);
+    if (!dir->is_directory || length == 0 || length >= MAX_FILENAME || strchr(name, '/') ||
+        strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        return NULL;
     }
+    if (trie_find(dir->index, name)) return NULL;  // Names are unique within a directory
     
     // Create new node
-    FileNode* new_node = malloc(sizeof(FileNode));
-    strcpy(new_node->name, parts[count - 1]);
+    FileNode* new_node = fs_alloc_node(fs);
+    if (!new_node) return NULL;
+    new_node->name = fs_intern(fs, name);
     new_node->is_directory = is_directory;
     new_node->created = time(NULL);
     new_node->modified = time(NULL);
-    new_node->size = 0;
-    new_node->parent = current;
-    new_node->child_count = 0;
-    
-    // Add to parent
-    if (current->child_count < MAX_CHILDREN) {
-        current->children[current->child_count++] = new_node;
-        current->size += fs_get_size(new_node);  // Update parent directory size
-    }
-    
-    // Cleanup
-    for (int i = 0; i < count; i++) {
-        free(parts[i]);
-    }
-    free(parts);
+    new_node->parent = dir;
+    // An entry of a host directory is a host one, read on first use
+    new_node->host = dir->host;
+    new_node->unloaded = dir->host;
     
+    // Add to parent; readers can find it from here on
+    trie_insert(fs_child_index(fs, dir), new_node->name, new_node);
+    dir->child_count++;
+    fs_changed(fs, new_node);
+    if (!is_directory) fs_propagate(dir, 0, 1);
     return new_node;
 }
 
-void fs_list_directory(FileSystem* fs, const char* path, FileNode*** files, int* count) {
-    FileNode* dir = fs_get_file(fs, path);
-    if (dir && dir->is_directory) {
-        *files = dir->children;
-        *count = dir->child_count;
+static FileNode* fs_add_child_locked(FileSystem* fs, FileNode* dir, const char* name, bool is_directory) {
+    if (dir->host) return NULL;  // Mounts are read-only
+    FileNode* new_node = fs_make_child(fs, dir, name, is_directory);
+    if (!new_node) return NULL;
+    fs->dirty = true;
+    fs_log(fs, FS_JOURNAL_CREATE, new_node, NULL, 0);
+    fs_snapshot_created(fs, new_node);
+    return new_node;
+}
+
+FileNode* fs_add_child(FileSystem* fs, FileNode* dir, const char* name, bool is_directory) {
+    fs_write_begin(fs);
+    FileNode* node = fs_add_child_locked(fs, dir, name, is_directory);
+    fs_write_end(fs);
+    return node;
+}
+
+FileNode* fs_create_file(FileSystem* fs, const char* path, bool is_directory) {
+    // Relative paths are created under the current directory, as they resolve
+    char name[MAX_FILENAME];
+    fs_write_begin(fs);
+    FileNode* current = fs_resolve_parent(fs, path, name);
+    FileNode* node = current ? fs_add_child_locked(fs, current, name, is_directory) : NULL;
+    fs_write_end(fs);
+    return node;
+}
+
+void fs_set_content(FileSystem* fs, FileNode* file, char* content, FsBlob* blob, size_t size) {
+    FsBlob* old = file->blob;
+    fs_propagate(file->parent, (long long)size - (long long)file->size, 0);
+    // fs_file_content checks blob, content, then blob again, so storing the
+    // non-NULL one first never shows a reader an empty body
+    if (blob) {
+        SDL_AtomicSetPtr((void**)&file->blob, blob);
+        SDL_AtomicSetPtr((void**)&file->content, content);
     } else {
-        *files = NULL;
-        *count = 0;
+        SDL_AtomicSetPtr((void**)&file->content, content);
+        SDL_AtomicSetPtr((void**)&file->blob, blob);
     }
+    file->size = size;
+    if (old) fs_store_release(fs->store, old);
+    fs_text_changed(fs, file);
+    fs_changed(fs, file);
 }
 
-// Modified fs_get_file: Supports absolute paths (starting with '/'),
-// relative paths (starting without '/'), and tokens "." and "..".
-FileNode* fs_get_file(FileSystem* fs, const char* path) {
-    int count;
-    char** parts = split_path(path, &count);
-    
-    // Start from root if path begins with '/', otherwise from current directory.
-    FileNode* current = (path[0]=='/') ? fs->root : fs->current_dir;
-    
-    for (int i = 0; i < count; i++) {
-        if (strcmp(parts[i], ".") == 0) {
-            // Do nothing, remain in current directory.
-        } else if (strcmp(parts[i], "..") == 0) {
-            if (current->parent != NULL)
-                current = current->parent;
-        } else {
-            bool found = false;
-            for (int j = 0; j < current->child_count; j++) {
-                if (strcmp(current->children[j]->name, parts[i]) == 0) {
-                    current = current->children[j];
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                current = NULL;
-                break;
-            }
+void fs_map_content(FileSystem* fs, FileNode* file, const char* data, size_t size) {
+    fs_write_begin(fs);
+    fs_set_content(fs, file, (char*)data, NULL, size);
+    fs_write_end(fs);
+}
+
+void fs_unlink(FileSystem* fs, FileNode* node) {
+    fs_changed(fs, node);  // While the old ancestors are still reachable
+    FileNode* parent = node->parent;
+    trie_remove(parent->index, node->name);
+    parent->child_count--;
+    fs_propagate(parent, -(long long)node->size, -fs_node_files(node));
+    node->parent = NULL;
+    fs_invalidate(fs);  // Cached lookups may point into the subtree
+    fs->dirty = true;
+}
+
+void fs_link(FileSystem* fs, FileNode* dir, FileNode* node, const char* name) {
+    if (name && strcmp(name, node->name) != 0) {
+        const char* old_name = node->name;
+        node->name = fs_intern(fs, name);
+        fs_release_name(fs, old_name);
+    }
+    node->parent = dir;
+    trie_insert(fs_child_index(fs, dir), node->name, node);
+    dir->child_count++;
+    fs_propagate(dir, (long long)node->size, fs_node_files(node));
+    fs_changed(fs, node);
+    fs->dirty = true;
+}
+
+static bool fs_free_child(FileNode* node, void* user);
+
+void fs_free_node(FileSystem* fs, FileNode* node) {
+    if (node->watched) fs_watch_forget(fs, node);
+    if (node->host) fs_mount_forget(fs, node);
+    if (node->opens > 0) {
+        // Its handles keep reading it; the last fs_close comes back here
+        node->orphaned = true;
+        node->parent = NULL;
+        fs_text_forget(fs, node);
+        return;
+    }
+    // Children are freed while their index is walked; it is destroyed right after
+    fs_each_child(node, "", 0, fs_free_child, fs);
+    trie_destroy(node->index);
+    if (node->blob) fs_store_release(fs->store, node->blob);
+    fs_text_forget(fs, node);
+    fs_release_name(fs, node->name);
+    fs_epoch_retire(fs->epoch, fs_recycle_node, node, fs);
+}
+
+static bool fs_free_child(FileNode* node, void* user) {
+    fs_free_node(user, node);
+    return true;
+}
+
+void fs_destroy(FileSystem* fs) {
+    if (!fs) return;
+    fs_journal_close(fs);
+    fs_snapshot_release(fs);  // Hands bodies back to the nodes still using them
+    fs_text_release(fs);
+    fs_watch_release(fs);
+    fs_mount_release(fs);
+    fs_free_node(fs, fs->root);
+    fs_store_destroy(fs->store);  // Stops its packer, which reads in the epoch
+    fs_epoch_destroy(fs->epoch);  // Releases what the nodes retired
+    fs_image_release(fs);  // After the nodes, which may point into the images
+    free(fs->dentries);
+    while (fs->slabs) {
+        FsSlab* next = fs->slabs->next;
+        free(fs->slabs);
+        fs->slabs = next;
+    }
+    free(fs->names);
+    SDL_DestroyMutex(fs->write_lock);
+    free(fs);
+}
+
+static bool fs_delete_locked(FileSystem* fs, const char* path) {
+    FileNode* node = fs_get_file(fs, path);
+    if (!node || node == fs->root || node->host) return false;  // Mounts go with fs_unmount
+
+    // Never leave the shell inside a directory that no longer exists
+    for (FileNode* dir = fs->current_dir; dir; dir = dir->parent) {
+        if (dir == node) {
+            fs->current_dir = node->parent;
+            break;
         }
     }
-    
-    for (int i = 0; i < count; i++) {
-        free(parts[i]);
+
+    fs_log(fs, FS_JOURNAL_DELETE, node, NULL, 0);
+    FileNode* parent = node->parent;
+    fs_unlink(fs, node);
+    fs_snapshot_preserve(fs, parent);
+    parent->modified = time(NULL);
+    // A snapshot keeps the subtree so the delete can be rolled back
+    if (!fs_snapshot_deleted(fs, node, parent)) fs_free_node(fs, node);
+    return true;
+}
+
+bool fs_delete_file(FileSystem* fs, const char* path) {
+    fs_write_begin(fs);
+    bool deleted = fs_delete_locked(fs, path);
+    fs_write_end(fs);
+    return deleted;
+}
+
+static bool fs_rename_locked(FileSystem* fs, const char* old_path, const char* new_path) {
+    FileNode* node = fs_get_file(fs, old_path);
+    char name[MAX_FILENAME];
+    FileNode* parent = fs_resolve_parent(fs, new_path, name);
+    if (!node || node == fs->root || !parent || node->host || parent->host || trie_find(parent->index, name)) {
+        return false;
     }
-    free(parts);
-    
-    return current;
+
+    // A directory cannot move inside itself
+    for (FileNode* dir = parent; dir; dir = dir->parent) {
+        if (dir == node) return false;
+    }
+
+    char from[MAX_PATH];
+    bool logged = fs->journal && fs_node_path(node, from, sizeof(from));
+
+    fs_snapshot_renamed(fs, node);
+    FileNode* old_parent = node->parent;
+    // Readers find the node under its new path before the old one goes away
+    trie_insert(fs_child_index(fs, parent), name, node);
+    fs_unlink(fs, node);  // Paths through the old name stop resolving
+    fs_snapshot_preserve(fs, old_parent);
+    old_parent->modified = time(NULL);
+    fs_link(fs, parent, node, name);
+    fs_snapshot_preserve(fs, parent);
+    parent->modified = time(NULL);
+
+    char to[MAX_PATH];
+    if (logged && fs_node_path(node, to, sizeof(to))) {
+        fs_journal_record(fs, FS_JOURNAL_RENAME, from, node->is_directory, to, strlen(to));
+    }
+    return true;
 }
 
-bool fs_write_file(FileSystem* fs, const char* path, const char* content) {
+bool fs_rename(FileSystem* fs, const char* old_path, const char* new_path) {
+    fs_write_begin(fs);
+    bool renamed = fs_rename_locked(fs, old_path, new_path);
+    fs_write_end(fs);
+    return renamed;
+}
+
+typedef struct {
+    FileNode** files;
+    int count;
+    int max;
+} FsListing;
+
+static bool fs_collect_child(FileNode* node, void* user) {
+    FsListing* listing = user;
+    listing->files[listing->count++] = node;
+    return listing->count < listing->max;
+}
+
+int fs_list_directory(FileSystem* fs, const char* path, int first, FileNode** files, int max) {
+    fs_read_begin(fs);
+    FileNode* dir = fs_get_file(fs, path);
+    FsListing listing = {files, 0, max};
+    if (dir && max > 0) {
+        fs_each_child(dir, "", first, fs_collect_child, &listing);
+    }
+    fs_read_end(fs);
+    return listing.count;
+}
+
+// Supports absolute paths (starting with '/'), relative paths (starting
+// without '/'), and tokens "." and "..".
+FileNode* fs_get_file(FileSystem* fs, const char* path) {
+    fs_read_begin(fs);
+    FileNode* node = fs_lookup(fs, path[0] == '/' ? fs->root : fs->current_dir, path);
+    fs_read_end(fs);
+    return node;
+}
+
+static bool fs_write_locked(FileSystem* fs, const char* path, const char* content, size_t length) {
     FileNode* file = fs_get_file(fs, path);
-    if (file && !file->is_directory) {
-        strncpy(file->content, content, MAX_CONTENT);
-        file->size = strlen(content);
+    if (file && !file->is_directory && !file->host) {
+        if (length >= MAX_CONTENT) length = MAX_CONTENT - 1;
+        fs_snapshot_preserve(fs, file);
+        // Identical bodies are stored once; the old body's chunk hashes are reused where it matches
+        FsBlob* blob = fs_store_put(fs->store, content, length, file->blob);
+        if (!blob) return false;
+        fs_set_content(fs, file, NULL, blob, length);
         file->modified = time(NULL);
+        file->image_offset = 0;
+        fs->dirty = true;
+        fs_log(fs, FS_JOURNAL_WRITE, file, content, length);
         return true;
     }
     return false;
 }
 
-char* fs_read_file(FileSystem* fs, const char* path) {
+bool fs_write_file(FileSystem* fs, const char* path, const char* content) {
+    return fs_write_file_n(fs, path, content, strlen(content));
+}
+
+bool fs_write_file_n(FileSystem* fs, const char* path, const char* data, size_t length) {
+    fs_write_begin(fs);
+    bool written = fs_write_locked(fs, path, data, length);
+    fs_write_end(fs);
+    return written;
+}
+
+// Whether node is still in the tree, rather than deleted or held by a snapshot
+static bool fs_attached(const FileSystem* fs, const FileNode* node) {
+    while (node->parent) node = node->parent;
+    return node == fs->root;
+}
+
+// A mapped or empty body joins the store before its first partial change
+static bool fs_store_body(FileSystem* fs, FileNode* file) {
+    if (file->blob) return true;
+    FsBlob* blob = fs_store_put(fs->store, file->content ? file->content : "", file->size, NULL);
+    if (!blob) return false;
+    fs_set_content(fs, file, NULL, blob, file->size);
+    return true;
+}
+
+// Writes at offset (at most the size) and logs the change. Returns the bytes
+// written, fewer than length at MAX_CONTENT, or -1 if out of memory or the
+// file is a host one.
+static long fs_write_node(FileSystem* fs, FileNode* file, size_t offset, const char* data, size_t length) {
+    if (file->host) return -1;
+    // Keep room for the terminator; anything past MAX_CONTENT is dropped
+    size_t room = offset < MAX_CONTENT - 1 ? MAX_CONTENT - 1 - offset : 0;
+    if (length > room) length = room;
+    fs_snapshot_preserve(fs, file);
+    if (!fs_store_body(fs, file)) return -1;
+    FsBlob* blob = fs_store_write(fs->store, file->blob, offset, data, length);
+    if (!blob) return -1;
+    SDL_AtomicSetPtr((void**)&file->blob, blob);
+
+    size_t old_size = file->size;
+    if (offset + length > old_size) {
+        file->size = offset + length;
+        fs_propagate(file->parent, (long long)(file->size - old_size), 0);
+    }
+    if (offset == old_size) {
+        fs_text_appended(fs, file, old_size);
+    } else {
+        fs_text_changed(fs, file);
+    }
+    fs_changed(fs, file);
+    file->modified = time(NULL);
+    file->image_offset = 0;
+    fs->dirty = true;
+    if (offset == old_size) {
+        fs_log(fs, FS_JOURNAL_APPEND, file, data, length);
+    } else {
+        fs_log_at(fs, FS_JOURNAL_PATCH, file, offset, data, length);
+    }
+    return (long)length;
+}
+
+static bool fs_append_locked(FileSystem* fs, const char* path, const char* data, size_t length) {
+    FileNode* file = fs_get_file(fs, path);
+    if (!file || file->is_directory) return false;
+    return fs_write_node(fs, file, file->size, data, length) >= 0;
+}
+
+bool fs_append_file(FileSystem* fs, const char* path, const char* data, size_t length) {
+    fs_write_begin(fs);
+    bool appended = fs_append_locked(fs, path, data, length);
+    fs_write_end(fs);
+    return appended;
+}
+
+bool fs_touch(FileSystem* fs, FileNode* node) {
+    if (node->host) return false;
+    fs_write_begin(fs);
+    fs_snapshot_preserve(fs, node);
+    node->modified = time(NULL);
+    fs_changed(fs, node);
+    fs->dirty = true;
+    fs_log(fs, FS_JOURNAL_TOUCH, node, NULL, 0);
+    fs_write_end(fs);
+    return true;
+}
+
+const char* fs_file_content(FileSystem* fs, FileNode* file) {
+    if (file->unloaded) fs_mount_load(fs, file);
+    // See fs_set_content for why blob is read twice
+    FsBlob* blob = SDL_AtomicGetPtr((void**)&file->blob);
+    if (blob) return fs_store_data(fs->store, blob);
+    const char* content = SDL_AtomicGetPtr((void**)&file->content);
+    if (content) return content;
+    blob = SDL_AtomicGetPtr((void**)&file->blob);
+    return blob ? fs_store_data(fs->store, blob) : "";
+}
+
+// The body and its size, read so that a racing writer cannot pair one with
+// the other's old value. A stored body is only appended to in place; any
+// other write publishes a new copy, so bytes before size never change.
+const char* fs_file_body(FileSystem* fs, FileNode* file, size_t* size) {
+    if (file->unloaded) fs_mount_load(fs, file);
+    FsBlob* blob = SDL_AtomicGetPtr((void**)&file->blob);
+    if (!blob) {
+        const char* content = SDL_AtomicGetPtr((void**)&file->content);
+        size_t length = file->size;
+        SDL_MemoryBarrierAcquire();
+        blob = SDL_AtomicGetPtr((void**)&file->blob);
+        if (!blob) {
+            // Still the same borrowed body, so length was its size
+            *size = content ? length : 0;
+            return content ? content : "";
+        }
+    }
+    *size = blob->size;
+    SDL_MemoryBarrierAcquire();
+    return fs_store_data(fs->store, blob);
+}
+
+const char* fs_read_file(FileSystem* fs, const char* path) {
+    fs_read_begin(fs);
+    FileNode* file = fs_get_file(fs, path);
+    const char* content = file && !file->is_directory ? fs_file_content(fs, file) : NULL;
+    fs_read_end(fs);
+    return content;
+}
+
+const char* fs_read_file_n(FileSystem* fs, const char* path, size_t* size) {
+    fs_read_begin(fs);
+    FileNode* file = fs_get_file(fs, path);
+    const char* content = file && !file->is_directory ? fs_file_body(fs, file, size) : NULL;
+    fs_read_end(fs);
+    return content;
+}
+
+static bool fs_truncate_node(FileSystem* fs, FileNode* file, size_t size) {
+    if (file->host) return false;
+    if (size >= file->size) return size == file->size;
+    fs_snapshot_preserve(fs, file);
+    // The kept chunks match the old body, so their hashes are reused
+    FsBlob* blob = fs_store_put(fs->store, fs_file_content(fs, file), size, file->blob);
+    if (!blob) return false;
+    fs_set_content(fs, file, NULL, blob, size);
+    file->modified = time(NULL);
+    file->image_offset = 0;
+    fs->dirty = true;
+    fs_log_at(fs, FS_JOURNAL_TRUNCATE, file, size, NULL, 0);
+    return true;
+}
+
+static bool fs_handle_writable(const FsHandle* handle) {
+    return handle->flags & (FS_OPEN_WRITE | FS_OPEN_APPEND);
+}
+
+FsHandle* fs_open(FileSystem* fs, const char* path, int flags) {
+    FsHandle* handle = malloc(sizeof(FsHandle));
+    if (!handle) return NULL;
+    fs_write_begin(fs);
     FileNode* file = fs_get_file(fs, path);
-    if (file && !file->is_directory) {
-        return file->content;
+    if (!file && (flags & FS_OPEN_CREATE)) file = fs_create_file(fs, path, false);
+    if (!file || file->is_directory || file->opens == USHRT_MAX) {
+        fs_write_end(fs);
+        free(handle);
+        return NULL;
     }
-    return NULL;
+    *handle = (FsHandle){fs, file, 0, flags};
+    if (file->host && (fs_handle_writable(handle) || (flags & FS_OPEN_TRUNCATE))) {
+        fs_write_end(fs);
+        free(handle);
+        return NULL;  // Mounts are read-only
+    }
+    if ((flags & FS_OPEN_TRUNCATE) && fs_handle_writable(handle)) fs_truncate_node(fs, file, 0);
+    file->opens++;
+    fs_write_end(fs);
+    return handle;
+}
+
+void fs_close(FsHandle* handle) {
+    if (!handle) return;
+    FileSystem* fs = handle->fs;
+    fs_write_begin(fs);
+    FileNode* file = handle->node;
+    if (--file->opens == 0 && file->orphaned) fs_free_node(fs, file);
+    fs_write_end(fs);
+    free(handle);
+}
+
+long fs_read(FsHandle* handle, char* buffer, size_t length) {
+    if (!(handle->flags & FS_OPEN_READ)) return -1;
+    FileSystem* fs = handle->fs;
+    fs_read_begin(fs);
+    size_t size;
+    const char* body = fs_file_body(fs, handle->node, &size);
+    size_t count = 0;
+    if (body && handle->offset < size) {
+        count = size - handle->offset < length ? size - handle->offset : length;
+        memcpy(buffer, body + handle->offset, count);
+        handle->offset += count;
+    }
+    fs_read_end(fs);
+    return body ? (long)count : -1;
+}
+
+long fs_write(FsHandle* handle, const char* data, size_t length) {
+    if (!fs_handle_writable(handle)) return -1;
+    FileSystem* fs = handle->fs;
+    fs_write_begin(fs);
+    FileNode* file = handle->node;
+    long written = -1;
+    if (fs_attached(fs, file)) {
+        // Another handle may have cut the file short
+        if ((handle->flags & FS_OPEN_APPEND) || handle->offset > file->size) handle->offset = file->size;
+        written = fs_write_node(fs, file, handle->offset, data, length);
+        if (written > 0) handle->offset += (size_t)written;
+    }
+    fs_write_end(fs);
+    return written;
+}
+
+long fs_seek(FsHandle* handle, long offset, int whence) {
+    size_t size = handle->node->size;
+    long long base = whence == SEEK_CUR ? (long long)handle->offset : whence == SEEK_END ? (long long)size : 0;
+    long long position = base + offset;
+    if (position < 0 || position > (long long)size) return -1;
+    handle->offset = (size_t)position;
+    return (long)position;
+}
+
+bool fs_truncate(FsHandle* handle, size_t size) {
+    if (!fs_handle_writable(handle)) return false;
+    FileSystem* fs = handle->fs;
+    fs_write_begin(fs);
+    bool cut = fs_attached(fs, handle->node) && fs_truncate_node(fs, handle->node, size);
+    fs_write_end(fs);
+    return cut;
 }
 
-char* fs_format_size(size_t size) {
-    static char buffer[20];
+char* fs_format_size(size_t size, char* out, size_t out_size) {
     if (size < 1024) {
-        snprintf(buffer, sizeof(buffer), "%zu B", size);
+        snprintf(out, out_size, "%zu B", size);
     } else if (size < 1024 * 1024) {
-        snprintf(buffer, sizeof(buffer), "%.2f KB", size / 1024.0);
+        snprintf(out, out_size, "%.2f KB", size / 1024.0);
     } else {
-        snprintf(buffer, sizeof(buffer), "%.2f MB", size / (1024.0 * 1024.0));
+        snprintf(out, out_size, "%.2f MB", size / (1024.0 * 1024.0));
     }
-    return buffer;
+    return out;
 }
 
-char* fs_format_time(time_t time) {
-    static char buffer[20];
-    struct tm* tm_info = localtime(&time);
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", tm_info);
-    return buffer;
+char* fs_format_time(time_t time, char* out, size_t out_size) {
+    // localtime shares one result between threads
+    struct tm tm_info;
+#ifdef _WIN32
+    bool valid = localtime_s(&tm_info, &time) == 0;
+#else
+    bool valid = localtime_r(&time, &tm_info) != NULL;
+#endif
+    if (!valid || strftime(out, out_size, "%Y-%m-%d %H:%M", &tm_info) == 0) {
+        if (out_size > 0) out[0] = '\0';
+    }
+    return out;
 }
 
-char* fs_get_current_path(FileSystem* fs) {
-    static char path[MAX_PATH];
-    FileNode* current = fs->current_dir;
-    path[0] = '\0';
+bool fs_node_path(const FileNode* node, char* out, size_t size) {
+    if (size < 2) return false;
 
-    while (current != NULL) {
-        char temp[MAX_PATH];
-        // Ensure no truncation by checking snprintf's return value
-        int written = snprintf(temp, sizeof(temp), "/%s%s", current->name, path);
-        if (written >= sizeof(temp)) {
-            fprintf(stderr, "Path truncation detected in fs_get_current_path\n");
-            break;
-        }
-        strcpy(path, temp);
-        current = current->parent;
+    // Fill the buffer from the end, one name per ancestor
+    size_t pos = size - 1;
+    out[pos] = '\0';
+    for (; node && node->parent; node = node->parent) {
+        size_t length = strlen(node->name);
+        if (length + 1 > pos) return false;
+        pos -= length;
+        memcpy(out + pos, node->name, length);
+        out[--pos] = '/';
     }
+    if (pos == size - 1) out[--pos] = '/';
+    memmove(out, out + pos, size - pos);
+    return true;
+}
 
-    return path;
+// Built into the caller's buffer: the UI draws it every frame while jobs
+// may ask too, so there is no shared copy to rewrite
+bool fs_get_current_path(FileSystem* fs, char* out, size_t size) {
+    FileNode* dir = fs->current_dir;
+    return fs_node_path(dir, out, size);
 }
 
 bool fs_change_dir(FileSystem* fs, const char* path) {
+    fs_write_begin(fs);  // A delete may be moving the shell out of dir
     FileNode* dir = fs_get_file(fs, path);
-    if (dir && dir->is_directory) {
-        fs->current_dir = dir;
-        return true;
+    bool changed = dir && dir->is_directory;
+    if (changed) fs->current_dir = dir;
+    fs_write_end(fs);
+    return changed;
+}
+
+// ... Add other filesystem function implementations ...
+
+// Terminal builtins backed by the filesystem
+
+typedef struct {
+    CommandContext* ctx;
+    const char* indent;
+} FsLsState;
+
+static bool fs_print_entry(FileNode* node, void* user) {
+    FsLsState* state = user;
+    char size[FS_FORMAT_LENGTH], modified[FS_FORMAT_LENGTH];
+    return command_printf(state->ctx, "%s%s  %s  %s", state->indent, node->name,
+                          fs_format_size(node->size, size, sizeof(size)),
+                          fs_format_time(node->modified, modified, sizeof(modified)));
+}
+
+static bool fs_print_tree_entry(FileNode* node, void* user) {
+    FsLsState* state = user;
+    if (!fs_print_entry(node, state)) return false;
+    if (node->is_directory) {
+        // Show one level of each subdirectory as well
+        FsLsState nested = {state->ctx, "  "};
+        fs_each_child(node, "", 0, fs_print_entry, &nested);
     }
-    return false;
+    return !command_cancelled(state->ctx);
+}
+
+static int fs_cmd_ls(CommandContext* ctx, int argc, char** argv) {
+    FileNode* dir = fs_get_file(ctx->fs, argc > 1 ? argv[1] : ".");
+    if (!dir || !dir->is_directory) {
+        command_print(ctx, "Error: Invalid directory");
+        return 1;
+    }
+    // Children come out of the index already sorted by name
+    FsLsState state = {ctx, ""};
+    fs_each_child(dir, "", 0, fs_print_tree_entry, &state);
+    return 0;
+}
+
+static int fs_cmd_cd(CommandContext* ctx, int argc, char** argv) {
+    // The shell's directory is not a job's to move under the user
+    if (!command_require_foreground(ctx, argv[0])) return 1;
+    if (argc > 1 && fs_change_dir(ctx->fs, argv[1])) {
+        command_print(ctx, "Directory changed");
+        return 0;
+    }
+    command_print(ctx, "Error: Invalid directory");
+    return 1;
+}
+
+static int fs_cmd_pwd(CommandContext* ctx, int argc, char** argv) {
+    char path[MAX_PATH];
+    if (!fs_get_current_path(ctx->fs, path, sizeof(path))) {
+        command_print(ctx, "Error: Path too long");
+        return 1;
+    }
+    command_print(ctx, path);
+    return 0;
+}
+
+static int fs_cmd_mkdir(CommandContext* ctx, int argc, char** argv) {
+    if (argc > 1 && fs_create_file(ctx->fs, argv[1], true)) {
+        command_print(ctx, "Directory created");
+        return 0;
+    }
+    command_print(ctx, "Error: Could not create directory");
+    return 1;
+}
+
+static int fs_cmd_touch(CommandContext* ctx, int argc, char** argv) {
+    if (argc < 2) {
+        command_print(ctx, "Error: No file specified.");
+        return 1;
+    }
+    FileNode* file = fs_get_file(ctx->fs, argv[1]);
+    if (file && file->host) {
+        command_print(ctx, "Error: Mounted files are read-only");
+        return 1;
+    }
+    if (file) {
+        fs_touch(ctx->fs, file);
+        return 0;
+    }
+    if (!fs_create_file(ctx->fs, argv[1], false)) {
+        command_print(ctx, "Error: Could not create file");
+        return 1;
+    }
+    return 0;
 }
 
-// New function: detect and update external media. This is a simple simulation.
-bool fs_detect_external_media(FileSystem* fs) {
-    static bool already_detected = false;
-    // For simulation, we simply check for a file "external.txt" in the current directory.
-    // In real hardware this would probe USB ports etc.
-    if (!already_detected) {
-        // Assume fs_read_file returns non-NULL if external media is available.
-        char* externalCheck = fs_read_file(fs, "/external_flag.txt");
-        if (externalCheck != NULL) {
-            // Add external drive node if not already part of the tree.
-            // For simplicity add a "USB_Drive" node under root.
-            fs_create_file(fs, "/USB_Drive", true);
-            already_detected = true;
-            return true;
+static int fs_cmd_cat(CommandContext* ctx, int argc, char** argv) {
+    if (argc < 2) {
+        command_print(ctx, "Error: No file specified.");
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        size_t size;
+        const char* content = fs_read_file_n(ctx->fs, argv[i], &size);
+        if (!content) {
+            command_printf(ctx, "Error: %s: File not found or cannot be read.", argv[i]);
+            return 1;
         }
+        if (!command_print_text(ctx, content, size)) break;  // Reader is done
     }
-    return false;
+    return 0;
 }
 
-// ... Add other filesystem function implementations ...
+static int fs_cmd_rm(CommandContext* ctx, int argc, char** argv) {
+    bool recursive = argc > 1 && strcmp(argv[1], "-r") == 0;
+    int first = recursive ? 2 : 1;
+    if (first >= argc) {
+        command_print(ctx, "Usage: rm [-r] <path>...");
+        return 1;
+    }
+    int status = 0;
+    for (int i = first; i < argc; i++) {
+        FileNode* node = fs_get_file(ctx->fs, argv[i]);
+        if (!node) {
+            command_printf(ctx, "Error: %s: No such file or directory", argv[i]);
+            status = 1;
+        } else if (node->is_directory && node->child_count > 0 && !recursive) {
+            command_printf(ctx, "Error: %s: Directory not empty (use rm -r)", argv[i]);
+            status = 1;
+        } else if (!fs_delete_file(ctx->fs, argv[i])) {
+            command_printf(ctx, "Error: %s: Cannot remove", argv[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+static int fs_cmd_mv(CommandContext* ctx, int argc, char** argv) {
+    if (argc != 3) {
+        command_print(ctx, "Usage: mv <source> <destination>");
+        return 1;
+    }
+    // Moving onto an existing directory moves into it, keeping the name
+    char target[MAX_PATH];
+    FileNode* source = fs_get_file(ctx->fs, argv[1]);
+    FileNode* dest = fs_get_file(ctx->fs, argv[2]);
+    if (source && dest && dest->is_directory) {
+        snprintf(target, sizeof(target), "%s/%s", argv[2], source->name);
+    } else {
+        snprintf(target, sizeof(target), "%s", argv[2]);
+    }
+    if (!fs_rename(ctx->fs, argv[1], target)) {
+        command_printf(ctx, "Error: Cannot move %s to %s", argv[1], argv[2]);
+        return 1;
+    }
+    return 0;
+}
+
+static int fs_cmd_du(CommandContext* ctx, int argc, char** argv) {
+    int status = 0;
+    for (int i = 1; i < argc || i == 1; i++) {
+        const char* path = i < argc ? argv[i] : ".";
+        FileNode* node = fs_get_file(ctx->fs, path);
+        if (!node) {
+            command_printf(ctx, "Error: %s: No such file or directory", path);
+            status = 1;
+            continue;
+        }
+        // Directories keep running totals, so this never walks the subtree
+        char size[FS_FORMAT_LENGTH];
+        command_printf(ctx, "%s  %zu files  %s", fs_format_size(node->size, size, sizeof(size)),
+                       (size_t)fs_node_files(node), path);
+    }
+    return status;
+}
+
+void fs_register_commands(void) {
+    command_register("ls", "ls [dir]", "List files in current directory", fs_cmd_ls);
+    command_register("dir", "dir", "List files and directories in current directory", fs_cmd_ls);
+    command_register("cd", "cd <dir>", "Change directory", fs_cmd_cd);
+    command_register("pwd", "pwd", "Print working directory", fs_cmd_pwd);
+    command_register("cat", "cat <file>", "Display file contents", fs_cmd_cat);
+    command_register("mkdir", "mkdir <dir>", "Create directory", fs_cmd_mkdir);
+    command_register("nedir", "nedir <dir>", "Create a new directory", fs_cmd_mkdir);
+    command_register("touch", "touch <file>", "Create empty file", fs_cmd_touch);
+    command_register("rm", "rm [-r] <path>", "Remove files or directories", fs_cmd_rm);
+    command_register("mv", "mv <source> <dest>", "Move or rename a file or directory", fs_cmd_mv);
+    command_register("du", "du [path]...", "Show bytes and files under a path", fs_cmd_du);
+}
@@ -1,47 +1,215 @@
 #ifndef MICROOS_FILESYSTEM_H
 #define MICROOS_FILESYSTEM_H
 
+#include <SDL.h>
 #include <time.h>
 #include <stdbool.h>
 
 #define MAX_FILENAME 256
 #define MAX_PATH 1024
-#define MAX_CONTENT 4096
+#define MAX_CONTENT (4 * 1024 * 1024)  // Largest file body
 #define MAX_FILES 100
-#define MAX_CHILDREN 20
+#define FS_SLAB_NODES 256              // FileNodes carved out of each slab
+#define FS_DENTRY_SLOTS 1024           // Resolved-path cache slots (power of two)
+#define FS_DENTRY_PATH 96              // Longest path the cache remembers
+#define FS_FORMAT_LENGTH 24            // Buffer that fs_format_size and fs_format_time always fit
 
+// Metadata only: names are interned and file bodies live out of line, so an
+// empty directory or file costs a few dozen bytes instead of several KB.
 typedef struct FileNode {
-    char name[MAX_FILENAME];
+    const char* name;       // Interned; shared with every node of the same name
     bool is_directory;
+    bool orphaned;          // Freed while open; the last fs_close frees it for real
+    bool watched;           // Has watches to notify when it or a descendant changes
+    bool host;              // Mirrors a host file or directory; see fsmount.h
+    bool unloaded;          // Host node whose children or body have not been read yet
+    unsigned short opens;   // Handles open on this file
+    unsigned epoch;         // Snapshot epoch this node's old state was saved in
+    unsigned text_id;       // Entry in the trigram index, 0 if none
     time_t created;
     time_t modified;
-    size_t size;
-    char content[MAX_CONTENT];
+    size_t size;            // File bytes, or the total over the subtree for a directory
+    size_t file_count;      // Files in the subtree (directories only)
+    char* content;          // Body borrowed from a mapped image, NUL-terminated; NULL otherwise
+    struct FsBlob* blob;    // Body in the block store (a reference); NULL otherwise
+    unsigned long long image_offset;  // Body's place in the saved image, 0 if changed since
     struct FileNode* parent;
-    struct FileNode* children[MAX_CHILDREN];
     int child_count;
+    unsigned generation;    // FileSystem::changes as of the latest change to it or below it
+    struct Trie* index;     // Children ordered by name, NULL until the first one (directories only)
 } FileNode;
 
+// Flags for fs_open
+#define FS_OPEN_READ 1
+#define FS_OPEN_WRITE 2
+#define FS_OPEN_APPEND 4        // Writes always go to the end; implies FS_OPEN_WRITE
+#define FS_OPEN_CREATE 8        // Create the file if it does not exist
+#define FS_OPEN_TRUNCATE 16     // Empty the file when it is opened for writing
+
+// Called for each child by fs_each_child; return false to stop.
+typedef bool (*FsVisitor)(FileNode* node, void* user);
+
+// One remembered path lookup, valid while generation matches the filesystem's
+typedef struct {
+    SDL_atomic_t seq;       // Odd while the entry is being written
+    const FileNode* base;   // Where the walk started: root for absolute paths
+    FileNode* node;
+    unsigned hash;
+    unsigned generation;
+    char path[FS_DENTRY_PATH];
+} FsDentry;
+
+struct FsSlab;
+struct FsName;
+struct FsImage;
+struct FsJournal;
+struct FsSnapshots;
+struct FsStore;
+struct FsBlob;
+struct FsText;
+struct FsEpoch;
+struct FsWatches;
+struct FsMounts;
+
 typedef struct {
     FileNode* root;
     FileNode* current_dir;
+    struct FsSlab* slabs;       // Node storage, released only by fs_destroy
+    FileNode* free_nodes;       // Deleted nodes awaiting reuse, linked through parent
+    struct FsName** names;      // Interned name hash buckets
+    int name_buckets;           // Power of two
+    int name_count;
+    FsDentry* dentries;         // Direct-mapped cache of resolved paths
+    SDL_atomic_t generation;    // Bumped when a delete or rename may stale cached lookups
+    struct FsImage* images;     // Mapped images that file bodies may still point into
+    char* image_path;           // Image that FileNode::image_offset refers to
+    bool dirty;                 // Changed since the last save
+    struct FsJournal* journal;  // Where changes are logged; NULL while replaying
+    unsigned long long journal_seq;  // Last journal record the saved image includes
+    struct FsSnapshots* snapshots;   // Restore points; NULL until the first one
+    struct FsStore* store;      // Deduplicated file bodies
+    struct FsText* text;        // Trigram index over file bodies; NULL until the first search
+    SDL_mutex* write_lock;      // Serialises changes; readers take no lock
+    struct FsEpoch* epoch;      // Defers freeing what readers may still hold
+    unsigned changes;           // Numbers changes; see FileNode::generation
+    struct FsWatches* watches;  // Change subscribers; NULL until the first one
+    struct FsMounts* mounts;    // Host directories in the tree; NULL until the first one
 } FileSystem;
 
+// An open file and a position in it
+typedef struct {
+    FileSystem* fs;
+    FileNode* node;
+    size_t offset;
+    int flags;
+} FsHandle;
+
 // Filesystem operations
-FileSystem* fs_init(void);
+FileSystem* fs_init(void);     // Empty root plus the default sample tree
+FileSystem* fs_create(void);   // Just an empty root
 void fs_destroy(FileSystem* fs);
+
+// Any thread may read while one writes. Changes hold the writer lock (the
+// calls below take it themselves); reads take none, but nodes, names and
+// bodies they get stay valid only until their read section ends. Sections
+// nest, and a thread reads one filesystem at a time.
+void fs_write_begin(FileSystem* fs);
+void fs_write_end(FileSystem* fs);
+void fs_read_begin(FileSystem* fs);
+void fs_read_end(FileSystem* fs);
+// For long readers, at points where they hold nothing they read: lets
+// reclamation move past an outermost section. Returns true if nodes looked
+// up before the call may be gone.
+bool fs_read_quiesce(FileSystem* fs);
+// Frees what no reader can still hold. Called once per frame, outside any
+// read section; does nothing if a writer is busy.
+void fs_reclaim(FileSystem* fs);
+
 FileNode* fs_create_file(FileSystem* fs, const char* path, bool is_directory);
 bool fs_delete_file(FileSystem* fs, const char* path);
+// Adds an entry named name to dir. Returns NULL if the name is invalid or taken.
+FileNode* fs_add_child(FileSystem* fs, FileNode* dir, const char* name, bool is_directory);
+// Points a file at a read-only body owned elsewhere (a mapped image). The
+// body must be NUL-terminated; the first write replaces it with a stored one.
+void fs_map_content(FileSystem* fs, FileNode* file, const char* data, size_t size);
+
+// Raw tree edits for the snapshot and mount code. They keep aggregates and
+// the dentry cache right but are neither journaled nor snapshotted. Callers
+// hold the writer lock.
+// Adds an entry to dir as fs_add_child does, even to a host directory.
+FileNode* fs_make_child(FileSystem* fs, FileNode* dir, const char* name, bool is_directory);
+// Takes node and its subtree out of its directory; node->parent becomes NULL.
+void fs_unlink(FileSystem* fs, FileNode* node);
+// Puts a detached node into dir, renaming it first if name is not NULL.
+void fs_link(FileSystem* fs, FileNode* dir, FileNode* node, const char* name);
+// Replaces a file's body with a borrowed one (content) or a stored one
+// (blob, whose reference the file takes over), releasing the old body.
+void fs_set_content(FileSystem* fs, FileNode* file, char* content, struct FsBlob* blob, size_t size);
+// Returns a detached node and everything below it to the slabs.
+void fs_free_node(FileSystem* fs, FileNode* node);
 FileNode* fs_get_file(FileSystem* fs, const char* path);
 bool fs_write_file(FileSystem* fs, const char* path, const char* content);
-char* fs_read_file(FileSystem* fs, const char* path);
+// Replaces the body with length bytes of data, which may hold NUL bytes.
+bool fs_write_file_n(FileSystem* fs, const char* path, const char* data, size_t length);
+bool fs_append_file(FileSystem* fs, const char* path, const char* data, size_t length);
+// Stamps node as modified now. Returns false for a host node.
+bool fs_touch(FileSystem* fs, FileNode* node);
+// Returns the file body (never NULL for a file, "" when empty), or NULL if
+// path is not a file. Valid until the caller's read section ends.
+const char* fs_read_file(FileSystem* fs, const char* path);
+// The same, also storing the body's byte length in *size.
+const char* fs_read_file_n(FileSystem* fs, const char* path, size_t* size);
+// The same for a node in hand; decodes a compressed body.
+const char* fs_file_content(FileSystem* fs, FileNode* file);
+// The body with its byte length, which counts any NUL bytes inside it.
+const char* fs_file_body(FileSystem* fs, FileNode* file, size_t* size);
 bool fs_rename(FileSystem* fs, const char* old_path, const char* new_path);
-char* fs_get_current_path(FileSystem* fs);
+
+// Streaming access to part of a file. A handle's file stays readable after
+// it is deleted, until the handle is closed; writes to it then fail. A
+// handle may move between threads but is used by one at a time. Close every
+// handle before fs_destroy.
+// Returns NULL if path is not a file (or cannot be created) or out of memory.
+FsHandle* fs_open(FileSystem* fs, const char* path, int flags);
+void fs_close(FsHandle* handle);
+// Copies up to length bytes from the position and moves past them. Returns
+// the count, 0 at the end, or -1 if the handle is not open for reading.
+long fs_read(FsHandle* handle, char* buffer, size_t length);
+// Writes at the position (the end in append mode), overwriting and then
+// extending the body. Only the chunks written are hashed and, unless a
+// snapshot shares the body, nothing else is copied. Returns the count, less
+// than length at MAX_CONTENT, or -1 on failure.
+long fs_write(FsHandle* handle, const char* data, size_t length);
+// Moves the position as fseek does (SEEK_SET, SEEK_CUR, SEEK_END). Positions
+// past the end are refused, since bodies cannot hold holes. Returns the new
+// position, or -1.
+long fs_seek(FsHandle* handle, long offset, int whence);
+// Cuts the file to size bytes; it never grows one. Returns false if it could not.
+bool fs_truncate(FsHandle* handle, size_t size);
+// Writes the absolute path of the current directory into out. Returns false
+// if it does not fit.
+bool fs_get_current_path(FileSystem* fs, char* out, size_t size);
+// Writes the absolute path of node into out. Returns false if it does not fit.
+bool fs_node_path(const FileNode* node, char* out, size_t size);
 bool fs_change_dir(FileSystem* fs, const char* path);
+// Bytes under a node: the file size, or a directory's running total. O(1).
+size_t fs_get_size(FileNode* node);
+// Changes only when node or something below it changes, so a cache built
+// from a subtree stays good while this matches. Compared for equality only.
+unsigned fs_get_generation(const FileNode* node);
 
 // Utility functions
-void fs_list_directory(FileSystem* fs, const char* path, FileNode*** files, int* count);
-char* fs_format_size(size_t size);
-char* fs_format_time(time_t time);
+// Copies up to max children of a directory, in name order, starting at the
+// first-th. Returns the number copied (0 if path is not a directory).
+int fs_list_directory(FileSystem* fs, const char* path, int first, FileNode** files, int max);
+// Visits the children of dir whose names start with prefix, in name order,
+// starting at the skip-th match.
+void fs_each_child(const FileNode* dir, const char* prefix, int skip, FsVisitor visit, void* user);
+// Write into out (FS_FORMAT_LENGTH bytes is enough) and return it
+char* fs_format_size(size_t size, char* out, size_t out_size);
+char* fs_format_time(time_t time, char* out, size_t out_size);
+
+// Registers filesystem builtins (ls, cd, pwd, cat, mkdir, touch, rm, mv, du) with the terminal
+void fs_register_commands(void);
 
 #endif // MICROOS_FILESYSTEM_H
@@ -1,5 +1,6 @@
 #include "fileui.h"
 #include "editor.h"  // Add this include so TextEditor is known
+#include "glyph_atlas.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -17,6 +18,8 @@ FileUI* fileui_create(FileSystem* fs) {
     ui->minimize_start = (SDL_Point){20,20};
     ui->minimize_end = (SDL_Point){240,280}; // target position when minimized
     ui->fs = fs;  // Store FileSystem pointer
+    ui->row_count = 0;
+    ui->listed_dir = NULL;  // Nothing fetched yet
     return ui;
 }
 
@@ -59,10 +62,25 @@ void fileui_render(FileUI* ui, SDL_Renderer* renderer, TTF_Font* font) {
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_RenderFillRect(renderer, &content);
 
-    // Draw files and folders
-    FileNode** files;
-    int count;
-    fs_list_directory(ui->fs, fs_get_current_path(ui->fs), &files, &count);
+    // Draw files and folders. Only the rows that fit are fetched, so a huge
+    // directory costs no more per frame than a small one, and only after
+    // something under it changed. A deleted row changes the directory's
+    // generation, so kept rows are never stale.
+    int first = ui->scroll_position > 0 ? ui->scroll_position / 20 : 0;
+    int rows = content.h / 20 + 2;
+    if (rows > FILEUI_MAX_ROWS) rows = FILEUI_MAX_ROWS;
+    const FileNode* dir = ui->fs->current_dir;
+    unsigned generation = fs_get_generation(dir);
+    if (dir != ui->listed_dir || generation != ui->listed_generation || first != ui->row_first ||
+        rows != ui->row_limit) {
+        ui->row_count = fs_list_directory(ui->fs, ".", first, ui->rows, rows);
+        ui->listed_dir = dir;
+        ui->listed_generation = generation;
+        ui->row_first = first;
+        ui->row_limit = rows;
+    }
+    FileNode** files = ui->rows;
+    int count = ui->row_count;
 
     SDL_Color folderColor = {0, 0, 255, 255};
     SDL_Color fileColor = {0, 0, 0, 255};
@@ -70,14 +88,7 @@ void fileui_render(FileUI* ui, SDL_Renderer* renderer, TTF_Font* font) {
 
     for (int i = 0; i < count; i++) {
         SDL_Color color = files[i]->is_directory ? folderColor : fileColor;
-        SDL_Surface* surface = TTF_RenderText_Solid(font, files[i]->name, color);
-        if (surface) {
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_Rect pos = {content.x + 5, y_offset + i * 20, surface->w, surface->h};
-            SDL_RenderCopy(renderer, texture, NULL, &pos);
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(surface);
-        }
+        glyph_atlas_draw_text(renderer, font, files[i]->name, content.x + 5, y_offset + (first + i) * 20, color);
     }
 }
 
@@ -6,6 +6,8 @@
 #include "filesystem.h"
 #include "editor.h"  // Include editor.h to use TextEditor
 
+#define FILEUI_MAX_ROWS 64  // Directory entries fetched per frame at most
+
 typedef struct {
     bool is_open;
     bool is_minimized;
@@ -19,6 +21,14 @@ typedef struct {
     SDL_Point minimize_start;
     SDL_Point minimize_end;
     FileSystem* fs;  // FileSystem pointer
+    // Rows drawn last frame, fetched again only when the directory, its
+    // generation or the scrolled range changes
+    FileNode* rows[FILEUI_MAX_ROWS];
+    int row_count;
+    int row_first;
+    int row_limit;
+    const FileNode* listed_dir;
+    unsigned listed_generation;
 } FileUI;
 
 FileUI* fileui_create(FileSystem* fs);
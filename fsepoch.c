@@ -0,0 +1,134 @@
+#include "fsepoch.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// What a thread knows about its own read section
+typedef struct {
+    FsEpoch* epoch;
+    int depth;
+    int slot;               // Slot held while depth > 0, and the one to try first next time
+} FsEpochThread;
+
+static SDL_TLSID fs_epoch_tls;
+
+static FsEpochThread* fs_epoch_self(void) {
+    FsEpochThread* self = SDL_TLSGet(fs_epoch_tls);
+    if (self) return self;
+    self = calloc(1, sizeof(FsEpochThread));
+    if (!self) return NULL;
+    // Spread threads over the slots so they rarely try the same one
+    self->slot = (int)(((uintptr_t)SDL_ThreadID() >> 4) * 2654435761u % FS_EPOCH_READERS);
+    SDL_TLSSet(fs_epoch_tls, self, free);
+    return self;
+}
+
+static int fs_epoch_state(unsigned global) {
+    return (int)(global * 2u + 1u);
+}
+
+FsEpoch* fs_epoch_create(void) {
+    if (!fs_epoch_tls) fs_epoch_tls = SDL_TLSCreate();
+    return calloc(1, sizeof(FsEpoch));
+}
+
+static void fs_epoch_release(FsLimbo* limbo) {
+    for (size_t i = 0; i < limbo->count; i++) {
+        FsRetired* item = &limbo->items[i];
+        if (item->release) {
+            item->release(item->memory, item->user);
+        } else {
+            free(item->memory);
+        }
+    }
+    free(limbo->items);
+}
+
+void fs_epoch_destroy(FsEpoch* epoch) {
+    if (!epoch) return;
+    for (int i = 0; i < 3; i++) {
+        fs_epoch_release(&epoch->limbo[i]);
+    }
+    free(epoch);
+}
+
+void fs_epoch_enter(FsEpoch* epoch) {
+    FsEpochThread* self = fs_epoch_self();
+    if (!self || self->depth++ > 0) return;
+    self->epoch = epoch;
+    for (;;) {
+        int state = fs_epoch_state((unsigned)SDL_AtomicGet(&epoch->global));
+        for (int i = 0; i < FS_EPOCH_READERS; i++) {
+            int slot = (self->slot + i) % FS_EPOCH_READERS;
+            if (SDL_AtomicCAS(&epoch->slots[slot].state, 0, state)) {
+                self->slot = slot;
+                return;
+            }
+        }
+        SDL_Delay(1);  // More readers than slots
+    }
+}
+
+void fs_epoch_leave(FsEpoch* epoch) {
+    FsEpochThread* self = fs_epoch_self();
+    if (!self || self->depth == 0 || --self->depth > 0) return;
+    SDL_AtomicSet(&self->epoch->slots[self->slot].state, 0);
+}
+
+bool fs_epoch_quiesce(FsEpoch* epoch) {
+    FsEpochThread* self = fs_epoch_self();
+    if (!self || self->depth != 1) return false;
+    SDL_atomic_t* slot = &self->epoch->slots[self->slot].state;
+    int state = fs_epoch_state((unsigned)SDL_AtomicGet(&epoch->global));
+    int old = SDL_AtomicGet(slot);
+    if (old == state) return false;
+    // Only this thread writes its slot while it holds it; the swap is a full
+    // barrier, so reads after it see what the new epoch does
+    SDL_AtomicCAS(slot, old, state);
+    return true;
+}
+
+void fs_epoch_retire(FsEpoch* epoch, FsEpochRelease release, void* memory, void* user) {
+    if (!memory) return;
+    SDL_AtomicLock(&epoch->lock);
+    FsLimbo* limbo = &epoch->limbo[(unsigned)SDL_AtomicGet(&epoch->global) % 3];
+    if (limbo->count == limbo->capacity) {
+        size_t capacity = limbo->capacity ? limbo->capacity * 2 : 256;
+        FsRetired* items = realloc(limbo->items, capacity * sizeof(FsRetired));
+        if (!items) {
+            // Leaked rather than freed under a reader
+            SDL_AtomicUnlock(&epoch->lock);
+            return;
+        }
+        limbo->items = items;
+        limbo->capacity = capacity;
+    }
+    limbo->items[limbo->count++] = (FsRetired){release, memory, user};
+    epoch->pending++;
+    SDL_AtomicUnlock(&epoch->lock);
+}
+
+size_t fs_epoch_poll(FsEpoch* epoch) {
+    SDL_AtomicLock(&epoch->lock);
+    unsigned global = (unsigned)SDL_AtomicGet(&epoch->global);
+    int current = fs_epoch_state(global);
+    bool caught_up = epoch->pending > 0;
+    for (int i = 0; i < FS_EPOCH_READERS && caught_up; i++) {
+        int state = SDL_AtomicGet(&epoch->slots[i].state);
+        caught_up = state == 0 || state == current;
+    }
+    if (!caught_up) {
+        SDL_AtomicUnlock(&epoch->lock);
+        return 0;
+    }
+    // Readers are all in the current epoch, so nothing retired before it is
+    // reachable; those items are the ones due once the epoch moves on
+    SDL_AtomicSet(&epoch->global, (int)(global + 1));
+    FsLimbo safe = epoch->limbo[(global + 2) % 3];
+    memset(&epoch->limbo[(global + 2) % 3], 0, sizeof(FsLimbo));
+    epoch->pending -= safe.count;
+    SDL_AtomicUnlock(&epoch->lock);
+
+    fs_epoch_release(&safe);
+    return safe.count;
+}
@@ -0,0 +1,66 @@
+#ifndef MICROOS_FSEPOCH_H
+#define MICROOS_FSEPOCH_H
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FS_EPOCH_READERS 64         // Threads inside read sections at once
+#define FS_EPOCH_BATCH 256          // Retired items that make a writer try to reclaim
+
+// Called once no reader can reach memory any more
+typedef void (*FsEpochRelease)(void* memory, void* user);
+
+typedef struct {
+    FsEpochRelease release;  // NULL to just free memory
+    void* memory;
+    void* user;
+} FsRetired;
+
+typedef struct {
+    FsRetired* items;
+    size_t count;
+    size_t capacity;
+} FsLimbo;
+
+// One reader's announcement, on a cache line of its own so readers never
+// contend: 0 while free, otherwise the epoch it entered at * 2 + 1
+typedef struct {
+    SDL_atomic_t state;
+    char pad[64 - sizeof(SDL_atomic_t)];
+} FsEpochSlot;
+
+// Epoch-based reclamation. Readers announce the epoch they entered at and
+// take no lock; memory unlinked by a writer is retired into the current
+// epoch's limbo and released once the epoch has advanced twice, which only
+// happens after every reader has left or caught up.
+typedef struct FsEpoch {
+    SDL_atomic_t global;
+    FsEpochSlot slots[FS_EPOCH_READERS];
+    FsLimbo limbo[3];       // By retiring epoch mod 3
+    size_t pending;         // Items across the limbo lists
+    SDL_SpinLock lock;      // Guards limbo; readers retire too (decoded bodies)
+} FsEpoch;
+
+FsEpoch* fs_epoch_create(void);
+// Releases everything still retired. No reader may be left.
+void fs_epoch_destroy(FsEpoch* epoch);
+
+// Read sections nest. A thread reads one filesystem at a time.
+void fs_epoch_enter(FsEpoch* epoch);
+void fs_epoch_leave(FsEpoch* epoch);
+// Moves an outermost section up to the current epoch, as leaving and
+// entering again would. Returns false if it was already there or is nested,
+// true if what the caller read before may now be released.
+bool fs_epoch_quiesce(FsEpoch* epoch);
+
+// Hands memory to release (free when NULL) once current readers have left.
+// If the limbo cannot grow, the memory is leaked rather than freed early.
+void fs_epoch_retire(FsEpoch* epoch, FsEpochRelease release, void* memory, void* user);
+
+// Advances the epoch if every reader has caught up and runs the releases
+// that became safe. Callers hold the filesystem's writer lock, since
+// releases return nodes to its free list. Returns the number released.
+size_t fs_epoch_poll(FsEpoch* epoch);
+
+#endif // MICROOS_FSEPOCH_H
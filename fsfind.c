@@ -0,0 +1,576 @@
+#include "fsfind.h"
+#include "fsmount.h"
+#include "command.h"
+#include "trie.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parses the set at p ("[...]") into a 256-bit map. Returns the bytes it
+// spans, or 0 if it is unterminated and so stands for a literal '['.
+static size_t fs_glob_set(const char* p, unsigned char* map) {
+    size_t i = 1;
+    bool negate = p[i] == '!' || p[i] == '^';
+    if (negate) i++;
+    memset(map, 0, 32);
+    size_t first = i;
+    while (p[i] && (p[i] != ']' || i == first)) {  // A leading ']' is a member
+        unsigned char low = (unsigned char)p[i], high = low;
+        if (p[i + 1] == '-' && p[i + 2] && p[i + 2] != ']') {
+            high = (unsigned char)p[i + 2];
+            i += 2;
+        }
+        for (unsigned c = low; c <= high; c++) {
+            map[c >> 3] |= (unsigned char)(1u << (c & 7));
+        }
+        i++;
+    }
+    if (p[i] != ']') return 0;
+    if (negate) {
+        for (int k = 0; k < 32; k++) map[k] = (unsigned char)~map[k];
+    }
+    return i + 1;
+}
+
+FsGlob* fs_glob_compile(const char* pattern) {
+    size_t length = strlen(pattern);
+    size_t sets = 0;
+    for (const char* p = pattern; *p; p++) sets += *p == '[';
+    FsGlob* glob = calloc(1, sizeof(FsGlob));
+    if (!glob) return NULL;
+    // At most one op per pattern byte; text holds each literal byte and each set's map
+    glob->ops = malloc((length + 1) * sizeof(FsGlobOp));
+    glob->text = malloc(length + 32 * sets + 1);
+    if (!glob->ops || !glob->text) {
+        fs_glob_free(glob);
+        return NULL;
+    }
+
+    size_t used = 0;
+    const char* p = pattern;
+    while (*p) {
+        FsGlobOp* last = glob->count ? &glob->ops[glob->count - 1] : NULL;
+        if (*p == '*') {
+            if (!last || last->kind != FS_GLOB_ANY) glob->ops[glob->count++] = (FsGlobOp){FS_GLOB_ANY, 0, 0};
+            p++;
+            continue;
+        }
+        if (*p == '?') {
+            glob->ops[glob->count++] = (FsGlobOp){FS_GLOB_ONE, 0, 1};
+            p++;
+            continue;
+        }
+        size_t spanned = *p == '[' ? fs_glob_set(p, glob->text + used) : 0;
+        if (spanned) {
+            glob->ops[glob->count++] = (FsGlobOp){FS_GLOB_SET, used, 1};
+            used += 32;
+            p += spanned;
+            continue;
+        }
+        if (*p == '\\' && p[1]) p++;
+        // Consecutive literal bytes form one run, compared with memcmp
+        if (last && last->kind == FS_GLOB_TEXT && last->start + last->length == used) {
+            last->length++;
+        } else {
+            glob->ops[glob->count++] = (FsGlobOp){FS_GLOB_TEXT, used, 1};
+        }
+        glob->text[used++] = (unsigned char)*p++;
+    }
+
+    const FsGlobOp* ops = glob->ops;
+    if (glob->count == 0 || (glob->count == 1 && ops[0].kind == FS_GLOB_TEXT)) {
+        glob->shape = FS_GLOB_EXACT;
+    } else if (ops[glob->count - 1].kind == FS_GLOB_ANY &&
+               (glob->count == 1 || (glob->count == 2 && ops[0].kind == FS_GLOB_TEXT))) {
+        glob->shape = FS_GLOB_PREFIX;
+    } else if (glob->count == 2 && ops[0].kind == FS_GLOB_ANY && ops[1].kind == FS_GLOB_TEXT) {
+        glob->shape = FS_GLOB_SUFFIX;
+    }
+    glob->prefix = glob->count && ops[0].kind == FS_GLOB_TEXT ? ops[0].length : 0;
+    glob->dot = glob->prefix > 0 && glob->text[0] == '.';
+    return glob;
+}
+
+void fs_glob_free(FsGlob* glob) {
+    if (!glob) return;
+    free(glob->ops);
+    free(glob->text);
+    free(glob);
+}
+
+bool fs_glob_magic(const char* word) {
+    return strpbrk(word, "*?[") != NULL;
+}
+
+// Whether op matches at s, which has left bytes. Every op but * has a fixed width.
+static bool fs_glob_step(const FsGlob* glob, const FsGlobOp* op, const unsigned char* s, size_t left) {
+    if (left < op->length) return false;
+    switch (op->kind) {
+    case FS_GLOB_TEXT:
+        return memcmp(s, glob->text + op->start, op->length) == 0;
+    case FS_GLOB_SET:
+        return glob->text[op->start + (s[0] >> 3)] & (1u << (s[0] & 7));
+    default:
+        return true;
+    }
+}
+
+bool fs_glob_match(const FsGlob* glob, const char* name) {
+    const unsigned char* s = (const unsigned char*)name;
+    size_t length = strlen(name);
+    const FsGlobOp* ops = glob->ops;
+    switch (glob->shape) {
+    case FS_GLOB_EXACT:
+        return glob->count == 0 ? length == 0 : length == ops[0].length && fs_glob_step(glob, &ops[0], s, length);
+    case FS_GLOB_PREFIX:
+        return glob->count == 1 || fs_glob_step(glob, &ops[0], s, length);
+    case FS_GLOB_SUFFIX:
+        return length >= ops[1].length && fs_glob_step(glob, &ops[1], s + length - ops[1].length, ops[1].length);
+    default:
+        break;
+    }
+
+    // Ops between two stars have fixed widths, so on a mismatch only the last
+    // star needs to take one more byte; earlier choices never have to change
+    int op = 0, star = -1;
+    size_t pos = 0, star_pos = 0;
+    for (;;) {
+        if (op < glob->count && ops[op].kind == FS_GLOB_ANY) {
+            star = op++;
+            star_pos = pos;
+            if (op == glob->count) return true;  // A trailing star takes the rest
+            continue;
+        }
+        if (op == glob->count) {
+            if (pos == length) return true;
+        } else if (fs_glob_step(glob, &ops[op], s + pos, length - pos)) {
+            pos += ops[op].length;
+            op++;
+            continue;
+        }
+        if (star < 0 || star_pos >= length) return false;
+        pos = ++star_pos;
+        op = star + 1;
+    }
+}
+
+// Glob expansion
+
+typedef struct {
+    FileSystem* fs;
+    char** paths;
+    long count;
+    long capacity;
+    bool failed;
+    char path[MAX_PATH];    // The path matched so far, as the pattern spells it
+} FsGlobWalk;
+
+typedef struct {
+    FsGlobWalk* walk;
+    const FsGlob* glob;
+    size_t length;
+    const char* rest;
+} FsGlobVisit;
+
+static void fs_glob_walk(FsGlobWalk* walk, FileNode* dir, size_t length, const char* pattern);
+
+static void fs_glob_add(FsGlobWalk* walk) {
+    if (walk->count == walk->capacity) {
+        long capacity = walk->capacity ? walk->capacity * 2 : 16;
+        char** paths = realloc(walk->paths, capacity * sizeof(char*));
+        if (!paths) {
+            walk->failed = true;
+            return;
+        }
+        walk->paths = paths;
+        walk->capacity = capacity;
+    }
+    char* path = strdup(walk->path);
+    if (!path) {
+        walk->failed = true;
+        return;
+    }
+    walk->paths[walk->count++] = path;
+}
+
+// Appends name to the path and matches the rest of the pattern below node
+static void fs_glob_descend(FsGlobWalk* walk, FileNode* node, size_t length, const char* name, const char* rest) {
+    size_t end = length;
+    size_t name_length = strlen(name);
+    if (end > 0 && walk->path[end - 1] != '/') walk->path[end++] = '/';
+    if (end + name_length >= MAX_PATH) return;
+    memcpy(walk->path + end, name, name_length + 1);
+    end += name_length;
+
+    if (*rest == '\0') {
+        fs_glob_add(walk);
+        return;
+    }
+    if (!node->is_directory) return;
+    while (*rest == '/') rest++;
+    if (*rest == '\0') {
+        fs_glob_add(walk);  // "dir/*/" names only directories
+    } else {
+        fs_glob_walk(walk, node, end, rest);
+    }
+}
+
+static bool fs_glob_visit(FileNode* node, void* user) {
+    FsGlobVisit* visit = user;
+    // As in sh, a leading dot must be matched literally
+    if (node->name[0] == '.' && !visit->glob->dot) return true;
+    if (fs_glob_match(visit->glob, node->name)) {
+        fs_glob_descend(visit->walk, node, visit->length, node->name, visit->rest);
+    }
+    return !visit->walk->failed;
+}
+
+// Matches the pattern's next component against dir's entries
+static void fs_glob_walk(FsGlobWalk* walk, FileNode* dir, size_t length, const char* pattern) {
+    const char* slash = strchr(pattern, '/');
+    size_t component_length = slash ? (size_t)(slash - pattern) : strlen(pattern);
+    const char* rest = pattern + component_length;
+    char component[MAX_FILENAME];
+    if (!dir->is_directory || component_length >= MAX_FILENAME) return;
+    memcpy(component, pattern, component_length);
+    component[component_length] = '\0';
+    if (dir->unloaded) fs_mount_load(walk->fs, dir);
+
+    if (!fs_glob_magic(component)) {
+        FileNode* node;
+        if (strcmp(component, ".") == 0) {
+            node = dir;
+        } else if (strcmp(component, "..") == 0) {
+            node = dir->parent ? dir->parent : dir;
+        } else {
+            node = trie_find(SDL_AtomicGetPtr((void**)&dir->index), component);
+        }
+        if (node) fs_glob_descend(walk, node, length, component, rest);
+        return;
+    }
+
+    FsGlob* glob = fs_glob_compile(component);
+    if (!glob) {
+        walk->failed = true;
+        return;
+    }
+    // The index narrows the walk to the names that share the literal prefix
+    char prefix[MAX_FILENAME];
+    memcpy(prefix, glob->text, glob->prefix);
+    prefix[glob->prefix] = '\0';
+    FsGlobVisit visit = {walk, glob, length, rest};
+    fs_each_child(dir, prefix, 0, fs_glob_visit, &visit);
+    fs_glob_free(glob);
+}
+
+long fs_glob_paths(FileSystem* fs, const char* pattern, char*** out) {
+    FsGlobWalk* walk = calloc(1, sizeof(FsGlobWalk));
+    if (!walk) return -1;
+    walk->fs = fs;
+    size_t length = 0;
+    if (pattern[0] == '/') walk->path[length++] = '/';
+    while (*pattern == '/') pattern++;
+
+    fs_read_begin(fs);
+    FileNode* base = length ? fs->root : fs->current_dir;
+    if (*pattern) fs_glob_walk(walk, base, length, pattern);
+    fs_read_end(fs);
+
+    long count = walk->count;
+    *out = walk->paths;
+    if (walk->failed) {
+        for (long i = 0; i < count; i++) free(walk->paths[i]);
+        free(walk->paths);
+        *out = NULL;
+        count = -1;
+    }
+    free(walk);
+    return count;
+}
+
+// Parallel search
+
+typedef struct FsFindRun FsFindRun;
+
+// One thread's share of a search. Matches stay thread-local until the end.
+typedef struct {
+    FsFindRun* run;
+    FileNode** found;
+    long count;
+    long capacity;
+} FsFindWorker;
+
+struct FsFindRun {
+    FileSystem* fs;
+    const FsFindQuery* query;
+    int threads;
+    FileNode** stack;       // Directories waiting for a thread
+    int stack_count;
+    int stack_capacity;
+    SDL_SpinLock lock;      // Guards the stack
+    SDL_atomic_t queued;    // stack_count, for threads deciding whether to share
+    SDL_atomic_t busy;      // Directories queued or being walked; 0 once the search is done
+    SDL_atomic_t failed;
+    FsFindWorker workers[FS_FIND_THREADS];
+};
+
+static bool fs_find_test(const FsFindQuery* query, const FileNode* node) {
+    if (query->type == 'f' && node->is_directory) return false;
+    if (query->type == 'd' && !node->is_directory) return false;
+    if (query->has_size) {
+        int order = node->size < query->size ? -1 : node->size > query->size;
+        if (order != query->size_compare) return false;
+    }
+    return !query->name || fs_glob_match(query->name, node->name);
+}
+
+static bool fs_find_stopped(FsFindRun* run) {
+    return SDL_AtomicGet(&run->failed) || (run->query->cancel && SDL_AtomicGet(run->query->cancel));
+}
+
+static bool fs_find_keep(FsFindWorker* worker, FileNode* node) {
+    if (worker->count == worker->capacity) {
+        long capacity = worker->capacity ? worker->capacity * 2 : 256;
+        FileNode** found = realloc(worker->found, capacity * sizeof(FileNode*));
+        if (!found) return false;
+        worker->found = found;
+        worker->capacity = capacity;
+    }
+    worker->found[worker->count++] = node;
+    return true;
+}
+
+static bool fs_find_share(FsFindRun* run, FileNode* dir) {
+    SDL_AtomicLock(&run->lock);
+    if (run->stack_count == run->stack_capacity) {
+        int capacity = run->stack_capacity ? run->stack_capacity * 2 : 64;
+        FileNode** stack = realloc(run->stack, capacity * sizeof(FileNode*));
+        if (!stack) {
+            SDL_AtomicUnlock(&run->lock);
+            return false;  // The caller walks it instead
+        }
+        run->stack = stack;
+        run->stack_capacity = capacity;
+    }
+    SDL_AtomicAdd(&run->busy, 1);
+    run->stack[run->stack_count++] = dir;
+    SDL_AtomicSet(&run->queued, run->stack_count);
+    SDL_AtomicUnlock(&run->lock);
+    return true;
+}
+
+static FileNode* fs_find_take(FsFindRun* run) {
+    if (SDL_AtomicGet(&run->queued) == 0) return NULL;
+    SDL_AtomicLock(&run->lock);
+    FileNode* dir = run->stack_count > 0 ? run->stack[--run->stack_count] : NULL;
+    SDL_AtomicSet(&run->queued, run->stack_count);
+    SDL_AtomicUnlock(&run->lock);
+    return dir;
+}
+
+static void fs_find_walk(FsFindWorker* worker, FileNode* dir);
+
+static bool fs_find_visit(FileNode* node, void* user) {
+    FsFindWorker* worker = user;
+    FsFindRun* run = worker->run;
+    if (fs_find_stopped(run)) return false;
+    if (fs_find_test(run->query, node) && !fs_find_keep(worker, node)) {
+        SDL_AtomicSet(&run->failed, 1);
+        return false;
+    }
+    if (node->is_directory && node->child_count > 0) {
+        // Subtrees go to the shared stack only while it runs short, so
+        // threads mostly walk depth-first on their own
+        bool shared = run->threads > 1 && SDL_AtomicGet(&run->queued) < run->threads && fs_find_share(run, node);
+        if (!shared) fs_find_walk(worker, node);
+    }
+    return true;
+}
+
+static void fs_find_walk(FsFindWorker* worker, FileNode* dir) {
+    fs_each_child(dir, "", 0, fs_find_visit, worker);
+}
+
+static void fs_find_work(FsFindWorker* worker) {
+    FsFindRun* run = worker->run;
+    fs_read_begin(run->fs);
+    int idle = 0;
+    while (!fs_find_stopped(run)) {
+        FileNode* dir = fs_find_take(run);
+        if (!dir) {
+            if (SDL_AtomicGet(&run->busy) == 0) break;
+            SDL_Delay(idle++ < 16 ? 0 : 1);  // Another thread may still hand some out
+            continue;
+        }
+        idle = 0;
+        fs_find_walk(worker, dir);
+        SDL_AtomicAdd(&run->busy, -1);
+    }
+    fs_read_end(run->fs);
+}
+
+static int fs_find_thread(void* data) {
+    fs_find_work(data);
+    return 0;
+}
+
+long fs_find(FileSystem* fs, FileNode* root, const FsFindQuery* query, FileNode*** out) {
+    FsFindRun* run = calloc(1, sizeof(FsFindRun));
+    if (!run) return -1;
+    run->fs = fs;
+    run->query = query;
+    int threads = query->threads;
+    if (threads <= 0) threads = root->file_count < FS_FIND_PARALLEL_MIN ? 1 : SDL_GetCPUCount();
+    run->threads = threads < 1 ? 1 : threads > FS_FIND_THREADS ? FS_FIND_THREADS : threads;
+    for (int i = 0; i < run->threads; i++) {
+        run->workers[i].run = run;
+    }
+
+    // The root is tested here; the threads test what lies below it
+    FsFindWorker* first = &run->workers[0];
+    if (fs_find_test(query, root) && !fs_find_keep(first, root)) SDL_AtomicSet(&run->failed, 1);
+    if (root->is_directory && !fs_find_share(run, root)) SDL_AtomicSet(&run->failed, 1);
+
+    // The calling thread is one of the workers
+    SDL_Thread* spawned[FS_FIND_THREADS] = {NULL};
+    for (int i = 1; i < run->threads; i++) {
+        spawned[i] = SDL_CreateThread(fs_find_thread, "find", &run->workers[i]);
+    }
+    fs_find_work(first);
+    for (int i = 1; i < run->threads; i++) {
+        if (spawned[i]) SDL_WaitThread(spawned[i], NULL);
+    }
+
+    long total = 0;
+    for (int i = 0; i < run->threads; i++) {
+        total += run->workers[i].count;
+    }
+    FileNode** found = NULL;
+    if (!SDL_AtomicGet(&run->failed)) {
+        found = total > first->capacity ? realloc(first->found, total * sizeof(FileNode*)) : first->found;
+        if (found) {
+            first->found = NULL;
+            long used = first->count;
+            for (int i = 1; i < run->threads; i++) {
+                if (run->workers[i].count == 0) continue;
+                memcpy(found + used, run->workers[i].found, run->workers[i].count * sizeof(FileNode*));
+                used += run->workers[i].count;
+            }
+        }
+    }
+    for (int i = 0; i < run->threads; i++) {
+        free(run->workers[i].found);
+    }
+    free(run->stack);
+    free(run);
+    *out = found;
+    return found || total == 0 ? total : -1;
+}
+
+// Terminal builtins
+
+// Parses [+|-]N[k|M] as find -size does, in bytes
+static bool fs_find_parse_size(const char* text, FsFindQuery* query) {
+    query->size_compare = *text == '+' ? 1 : *text == '-' ? -1 : 0;
+    if (*text == '+' || *text == '-') text++;
+    char* end;
+    unsigned long long size = strtoull(text, &end, 10);
+    if (end == text) return false;
+    if (*end == 'k') {
+        size *= 1024;
+        end++;
+    } else if (*end == 'M') {
+        size *= 1024 * 1024;
+        end++;
+    }
+    if (*end) return false;
+    query->size = (size_t)size;
+    query->has_size = true;
+    return true;
+}
+
+static int fs_find_compare(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Writes the path of node as seen from start, which names root: "./a/b" for "."
+static bool fs_find_path(const FileNode* node, const FileNode* root, const char* start, char* out, size_t size) {
+    char full[MAX_PATH], base[MAX_PATH];
+    if (!fs_node_path(node, full, sizeof(full)) || !fs_node_path(root, base, sizeof(base))) return false;
+    size_t skip = strlen(base);
+    const char* rest = full + skip;
+    if (*rest == '/') rest++;
+    if (!*rest) return snprintf(out, size, "%s", start) < (int)size;
+    size_t start_length = strlen(start);
+    const char* separator = start_length > 0 && start[start_length - 1] == '/' ? "" : "/";
+    return snprintf(out, size, "%s%s%s", start, separator, rest) < (int)size;
+}
+
+static int fs_find_cmd_find(CommandContext* ctx, int argc, char** argv) {
+    const char* usage = "Usage: find [path] [-name <glob>] [-type f|d] [-size [+|-]N[k|M]]";
+    const char* start = ".";
+    int i = 1;
+    if (i < argc && argv[i][0] != '-') start = argv[i++];
+    FsFindQuery query = {0};
+    query.cancel = ctx->cancel;
+    bool valid = true;
+    for (; i < argc && valid; i += 2) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            valid = false;
+        } else if (strcmp(argv[i], "-name") == 0) {
+            fs_glob_free(query.name);
+            query.name = fs_glob_compile(value);
+            valid = query.name != NULL;
+        } else if (strcmp(argv[i], "-type") == 0) {
+            query.type = value[0];
+            valid = (value[0] == 'f' || value[0] == 'd') && value[1] == '\0';
+        } else if (strcmp(argv[i], "-size") == 0) {
+            valid = fs_find_parse_size(value, &query);
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        fs_glob_free(query.name);
+        command_print(ctx, usage);
+        return 1;
+    }
+
+    FileNode* root = fs_get_file(ctx->fs, start);
+    if (!root) {
+        fs_glob_free(query.name);
+        command_printf(ctx, "Error: %s: No such file or directory", start);
+        return 1;
+    }
+    FileNode** nodes;
+    long count = fs_find(ctx->fs, root, &query, &nodes);
+    fs_glob_free(query.name);
+    char** paths = count > 0 ? malloc(count * sizeof(char*)) : NULL;
+    if (count < 0 || (count > 0 && !paths)) {
+        free(nodes);
+        command_print(ctx, "Error: Out of memory");
+        return 1;
+    }
+
+    // Printed in path order, whichever thread found them
+    long found = 0;
+    char buffer[MAX_PATH];
+    for (long k = 0; k < count; k++) {
+        if (fs_find_path(nodes[k], root, start, buffer, sizeof(buffer)) && (paths[found] = strdup(buffer))) found++;
+    }
+    free(nodes);
+    if (found > 1) qsort(paths, found, sizeof(char*), fs_find_compare);
+    bool more = true;
+    for (long k = 0; k < found; k++) {
+        if (more) more = command_print(ctx, paths[k]);
+        free(paths[k]);
+    }
+    free(paths);
+    return 0;
+}
+
+void fs_find_register_commands(void) {
+    command_register("find", "find [path] [-name <glob>] [-type f|d] [-size [+|-]N[k|M]]",
+                     "Search a directory tree, using every core for large ones", fs_find_cmd_find);
+}
@@ -0,0 +1,79 @@
+#ifndef MICROOS_FSFIND_H
+#define MICROOS_FSFIND_H
+
+#include "filesystem.h"
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FS_FIND_THREADS 16              // Most threads one search walks with
+#define FS_FIND_PARALLEL_MIN 4096       // Files below a root before a search spreads over threads
+
+typedef enum {
+    FS_GLOB_TEXT,           // A run of literal bytes
+    FS_GLOB_ONE,            // ?
+    FS_GLOB_ANY,            // *
+    FS_GLOB_SET             // [abc], [a-z], [!x]
+} FsGlobOpKind;
+
+typedef struct {
+    FsGlobOpKind kind;
+    size_t start;           // TEXT: bytes in FsGlob::text; SET: byte offset of its 32-byte bitmap
+    size_t length;
+} FsGlobOp;
+
+typedef enum {
+    FS_GLOB_GENERAL,
+    FS_GLOB_EXACT,          // No wildcards
+    FS_GLOB_PREFIX,         // text*
+    FS_GLOB_SUFFIX          // *text
+} FsGlobShape;
+
+// A pattern compiled once into ops, so matching never re-parses it. Common
+// shapes skip the op loop altogether.
+typedef struct FsGlob {
+    FsGlobShape shape;
+    FsGlobOp* ops;
+    int count;
+    unsigned char* text;    // Literal runs and set bitmaps
+    size_t prefix;          // Literal bytes every match starts with (text[0..prefix))
+    bool dot;               // Matches names starting with '.'; only if the pattern does too
+} FsGlob;
+
+// Compiles a shell pattern: * ? [set] [!set] and \ to quote the next byte.
+// Returns NULL if out of memory.
+FsGlob* fs_glob_compile(const char* pattern);
+bool fs_glob_match(const FsGlob* glob, const char* name);
+void fs_glob_free(FsGlob* glob);
+// Whether a word has wildcards worth expanding
+bool fs_glob_magic(const char* word);
+
+// Expands a path pattern (each component may have wildcards) into the
+// matching paths, in name order; a relative pattern gives relative paths.
+// Host directories on the way are loaded. Stores a malloc'd array of
+// malloc'd strings in *out. Returns the count, or -1 if out of memory.
+long fs_glob_paths(FileSystem* fs, const char* pattern, char*** out);
+
+// What fs_find looks for. Unset fields match everything.
+typedef struct {
+    FsGlob* name;           // Matched against the node's own name
+    char type;              // 'f', 'd' or 0
+    int size_compare;       // -1: under size, 0: exactly, 1: over; ignored without has_size
+    size_t size;
+    bool has_size;
+    int threads;            // 0: one per CPU, up to FS_FIND_THREADS
+    SDL_atomic_t* cancel;   // Stops the walk when set
+} FsFindQuery;
+
+// Collects into *out (malloc'd, caller frees) root and the nodes below it
+// that match, in no particular order. A large tree is walked by several
+// threads, each taking a subtree and handing parts of it to any that run
+// out of work. Like every fs_each_child walk it sees only loaded host
+// directories. The caller is in a read section, which keeps the nodes valid.
+// Returns the count, or -1 if out of memory.
+long fs_find(FileSystem* fs, FileNode* root, const FsFindQuery* query, FileNode*** out);
+
+// Registers the find builtin.
+void fs_find_register_commands(void);
+
+#endif // MICROOS_FSFIND_H
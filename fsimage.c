@@ -0,0 +1,436 @@
+#include "fsimage.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Maps a whole file read-only. Without mmap the file is read into memory.
+static void* fs_image_map(const char* path, size_t* size) {
+#ifdef _WIN32
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    void* map = length > 0 ? malloc(length) : NULL;
+    if (map && fread(map, 1, length, file) != (size_t)length) {
+        free(map);
+        map = NULL;
+    }
+    fclose(file);
+    *size = map ? (size_t)length : 0;
+    return map;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    void* map = NULL;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) map = NULL;
+    }
+    close(fd);  // The mapping keeps the file alive
+    *size = map ? (size_t)info.st_size : 0;
+    return map;
+#endif
+}
+
+static void fs_image_unmap(void* map, size_t size) {
+#ifdef _WIN32
+    free(map);
+#else
+    munmap(map, size);
+#endif
+}
+
+// Seeks with 64-bit offsets, since images can outgrow a long
+static bool fs_image_seek(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Pushes written data to the disk so the header never lands before it
+static bool fs_image_sync(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Version 1 headers stop before journal_seq
+#define FS_IMAGE_V1_HEADER_SIZE offsetof(FsImageHeader, journal_seq)
+
+// Reads the header at the start of an image, upgrading a version 1 header
+static bool fs_image_read_header(FsImageHeader* header, const char* data, size_t size) {
+    memset(header, 0, sizeof(FsImageHeader));
+    memcpy(header, data, size < sizeof(FsImageHeader) ? size : sizeof(FsImageHeader));
+    if (header->version == 1 && header->header_size == FS_IMAGE_V1_HEADER_SIZE) {
+        header->journal_seq = 0;
+        return size >= FS_IMAGE_V1_HEADER_SIZE;
+    }
+    return header->version == FS_IMAGE_VERSION && header->header_size == sizeof(FsImageHeader) &&
+           size >= sizeof(FsImageHeader);
+}
+
+static bool fs_image_header_valid(const FsImageHeader* header, uint64_t size) {
+    return memcmp(header->magic, FS_IMAGE_MAGIC, sizeof(FS_IMAGE_MAGIC)) == 0 &&
+           header->end <= size &&
+           header->node_count > 0 && header->node_count < FS_IMAGE_NO_PARENT &&
+           header->table_offset <= header->end &&
+           header->node_count <= (header->end - header->table_offset) / sizeof(FsImageNode) &&
+           header->names_offset <= header->end &&
+           header->names_size <= header->end - header->names_offset;
+}
+
+// Builds one node from its record. Returns NULL if the record is malformed.
+static FileNode* fs_image_load_node(FileSystem* fs, const char* map, const FsImageHeader* header,
+                                    const FsImageNode* record, FileNode* parent) {
+    char name[MAX_FILENAME];
+    if (record->name_length >= MAX_FILENAME || record->name_offset > header->names_size ||
+        record->name_length > header->names_size - record->name_offset) {
+        return NULL;
+    }
+    memcpy(name, map + header->names_offset + record->name_offset, record->name_length);
+    name[record->name_length] = '\0';
+
+    FileNode* node = fs_add_child(fs, parent, name, record->is_directory != 0);
+    if (!node) return NULL;
+    node->created = (time_t)record->created;
+    node->modified = (time_t)record->modified;
+
+    if (!record->is_directory && record->size > 0) {
+        // The body is used in place: no copy until the file is next written
+        if (record->size >= MAX_CONTENT || record->data_offset < header->header_size ||
+            record->data_offset > header->end || record->size >= header->end - record->data_offset ||
+            map[record->data_offset + record->size] != '\0') {
+            return NULL;
+        }
+        fs_map_content(fs, node, map + record->data_offset, record->size);
+        node->image_offset = record->data_offset;
+    }
+    return node;
+}
+
+FileSystem* fs_image_open(const char* path) {
+    size_t size;
+    char* map = fs_image_map(path, &size);
+    if (!map) return NULL;
+
+    FsImageHeader header;
+    if (!fs_image_read_header(&header, map, size) || !fs_image_header_valid(&header, size)) {
+        fs_image_unmap(map, size);
+        return NULL;
+    }
+
+    FileSystem* fs = fs_create();
+    FsImage* image = malloc(sizeof(FsImage));
+    image->map = map;
+    image->size = size;
+    image->next = NULL;
+    fs->images = image;
+
+    // Records list parents before children, so one pass rebuilds the tree
+    FileNode** nodes = malloc(sizeof(FileNode*) * header.node_count);
+    bool ok = nodes != NULL;
+    for (uint64_t i = 0; ok && i < header.node_count; i++) {
+        FsImageNode record;
+        memcpy(&record, map + header.table_offset + i * sizeof(FsImageNode), sizeof(record));
+        if (i == 0) {
+            ok = record.parent == FS_IMAGE_NO_PARENT && record.is_directory;
+            fs->root->created = (time_t)record.created;
+            fs->root->modified = (time_t)record.modified;
+            nodes[0] = fs->root;
+        } else {
+            ok = record.parent < i && nodes[record.parent]->is_directory;
+            nodes[i] = ok ? fs_image_load_node(fs, map, &header, &record, nodes[record.parent]) : NULL;
+            ok = ok && nodes[i];
+        }
+    }
+    free(nodes);
+    if (!ok) {
+        fs_destroy(fs);
+        return NULL;
+    }
+
+    fs->image_path = strdup(path);
+    fs->journal_seq = header.journal_seq;
+    fs->dirty = false;
+    return fs;
+}
+
+void fs_image_release(FileSystem* fs) {
+    while (fs->images) {
+        FsImage* next = fs->images->next;
+        fs_image_unmap(fs->images->map, fs->images->size);
+        free(fs->images);
+        fs->images = next;
+    }
+    free(fs->image_path);
+    fs->image_path = NULL;
+}
+
+// Save state: the records and names being built, plus where the next
+// appended byte goes
+typedef struct {
+    FileSystem* fs;
+    FILE* file;
+    bool append;                // Reusing bodies already in this image
+    bool ok;
+    uint64_t end;
+    uint64_t live;
+    FsImageNode* records;
+    FileNode** nodes;
+    uint64_t count;
+    uint64_t capacity;
+    char* names;
+    size_t names_size;
+    size_t names_capacity;
+    const void** bodies;        // Open-addressed: bodies placed so far (blob or borrowed pointer) and their offsets
+    uint64_t* body_offsets;
+    size_t body_slots;          // Power of two
+    size_t body_count;
+} FsImageWriter;
+
+static bool fs_image_write(FsImageWriter* writer, const void* data, size_t size) {
+    if (size > 0 && fwrite(data, 1, size, writer->file) != size) writer->ok = false;
+    writer->end += size;
+    return writer->ok;
+}
+
+// Pads to 8 bytes so the tables that follow are aligned within a mapping
+static void fs_image_align(FsImageWriter* writer) {
+    static const char zeros[8];
+    fs_image_write(writer, zeros, (8 - writer->end % 8) % 8);
+}
+
+// Finds the slot for a body pointer. Files sharing a body (deduplicated in
+// the block store, or mapped from one place in the image) share its offset.
+static size_t fs_image_body_slot(const FsImageWriter* writer, const void* body) {
+    uintptr_t bits = (uintptr_t)body;
+    size_t slot = (size_t)((bits >> 3) * 11400714819323198485ull) & (writer->body_slots - 1);
+    while (writer->bodies[slot] && writer->bodies[slot] != body) {
+        slot = (slot + 1) & (writer->body_slots - 1);
+    }
+    return slot;
+}
+
+static void fs_image_grow_bodies(FsImageWriter* writer) {
+    FsImageWriter old = *writer;
+    writer->body_slots = old.body_slots ? old.body_slots * 2 : 256;
+    writer->bodies = calloc(writer->body_slots, sizeof(const void*));
+    writer->body_offsets = malloc(writer->body_slots * sizeof(uint64_t));
+    if (!writer->bodies || !writer->body_offsets) {
+        writer->ok = false;
+        free(writer->bodies);
+        free(writer->body_offsets);
+        *writer = old;
+        return;
+    }
+    for (size_t i = 0; i < old.body_slots; i++) {
+        if (!old.bodies[i]) continue;
+        size_t slot = fs_image_body_slot(writer, old.bodies[i]);
+        writer->bodies[slot] = old.bodies[i];
+        writer->body_offsets[slot] = old.body_offsets[i];
+    }
+    free(old.bodies);
+    free(old.body_offsets);
+}
+
+static void fs_image_add_node(FsImageWriter* writer, FileNode* node, uint32_t parent) {
+    if (writer->count == writer->capacity) {
+        writer->capacity = writer->capacity ? writer->capacity * 2 : 256;
+        writer->records = realloc(writer->records, sizeof(FsImageNode) * writer->capacity);
+        writer->nodes = realloc(writer->nodes, sizeof(FileNode*) * writer->capacity);
+    }
+    size_t name_length = strlen(node->name);
+    if (writer->names_size + name_length > writer->names_capacity) {
+        writer->names_capacity = writer->names_capacity ? writer->names_capacity * 2 : 4096;
+        if (writer->names_capacity < writer->names_size + name_length) {
+            writer->names_capacity = writer->names_size + name_length;
+        }
+        writer->names = realloc(writer->names, writer->names_capacity);
+    }
+    memcpy(writer->names + writer->names_size, node->name, name_length);
+
+    FsImageNode* record = &writer->records[writer->count];
+    memset(record, 0, sizeof(FsImageNode));
+    record->parent = parent;
+    record->name_length = (uint32_t)name_length;
+    record->name_offset = writer->names_size;
+    record->created = (int64_t)node->created;
+    record->modified = (int64_t)node->modified;
+    record->is_directory = node->is_directory;
+    record->size = node->is_directory ? 0 : node->size;
+    writer->names_size += name_length;
+
+    if (!node->is_directory && node->size > 0) {
+        if (writer->body_count * 2 >= writer->body_slots) fs_image_grow_bodies(writer);
+        const void* body = node->blob ? (const void*)node->blob : node->content;
+        size_t slot = writer->body_slots ? fs_image_body_slot(writer, body) : 0;
+        if (writer->body_slots && writer->bodies[slot]) {
+            record->data_offset = writer->body_offsets[slot];  // Already placed for another file
+        } else {
+            // Unchanged bodies stay where the last save put them
+            if (writer->append && node->image_offset) {
+                record->data_offset = node->image_offset;
+            } else {
+                const char* content = fs_file_content(writer->fs, node);
+                if (!content) writer->ok = false;
+                record->data_offset = writer->end;
+                if (content) fs_image_write(writer, content, node->size);
+                fs_image_write(writer, "", 1);
+            }
+            writer->live += node->size + 1;
+            if (writer->body_slots) {
+                writer->bodies[slot] = body;
+                writer->body_offsets[slot] = record->data_offset;
+                writer->body_count++;
+            }
+        }
+    }
+    writer->nodes[writer->count++] = node;
+}
+
+typedef struct {
+    FsImageWriter* writer;
+    uint32_t parent;
+} FsImageVisit;
+
+static void fs_image_collect(FsImageWriter* writer, FileNode* node, uint32_t parent);
+
+static bool fs_image_collect_child(FileNode* node, void* user) {
+    FsImageVisit* visit = user;
+    if (node->host) return true;  // Mounts are not saved; the host keeps them
+    fs_image_collect(visit->writer, node, visit->parent);
+    return visit->writer->ok;
+}
+
+// Preorder walk, so every parent gets its index before its children
+static void fs_image_collect(FsImageWriter* writer, FileNode* node, uint32_t parent) {
+    uint32_t index = (uint32_t)writer->count;
+    fs_image_add_node(writer, node, parent);
+    FsImageVisit visit = {writer, index};
+    fs_each_child(node, "", 0, fs_image_collect_child, &visit);
+}
+
+// Appends the current tree after writer->end and commits it with a new header
+static bool fs_image_write_tree(FsImageWriter* writer, FileSystem* fs) {
+    fs_image_collect(writer, fs->root, FS_IMAGE_NO_PARENT);
+
+    FsImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FS_IMAGE_MAGIC, sizeof(FS_IMAGE_MAGIC));
+    header.version = FS_IMAGE_VERSION;
+    header.header_size = sizeof(FsImageHeader);
+
+    fs_image_align(writer);
+    header.names_offset = writer->end;
+    header.names_size = writer->names_size;
+    fs_image_write(writer, writer->names, writer->names_size);
+    fs_image_align(writer);
+    header.table_offset = writer->end;
+    header.node_count = writer->count;
+    fs_image_write(writer, writer->records, sizeof(FsImageNode) * writer->count);
+    header.end = writer->end;
+    header.live_bytes = writer->live + writer->names_size + sizeof(FsImageNode) * writer->count;
+    header.journal_seq = fs->journal_seq;
+
+    // Data first, header last: a crash before the header leaves the old state
+    if (!writer->ok || !fs_image_sync(writer->file) || !fs_image_seek(writer->file, 0) ||
+        fwrite(&header, sizeof(header), 1, writer->file) != 1 || !fs_image_sync(writer->file)) {
+        return false;
+    }
+    return true;
+}
+
+static bool fs_image_save_locked(FileSystem* fs, const char* path) {
+    FsImageWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.fs = fs;
+    writer.ok = true;
+
+    // Append to the image the bodies came from unless it is mostly garbage
+    bool same_image = fs->image_path && strcmp(fs->image_path, path) == 0;
+    if (same_image) {
+        FsImageHeader header;
+        writer.file = fopen(path, "r+b");
+        // Older versions are rewritten, since their header is a different size
+        if (writer.file && fread(&header, sizeof(header), 1, writer.file) == 1 &&
+            memcmp(header.magic, FS_IMAGE_MAGIC, sizeof(FS_IMAGE_MAGIC)) == 0 &&
+            header.version == FS_IMAGE_VERSION && header.header_size == sizeof(FsImageHeader)) {
+            if (!fs->dirty) {
+                fclose(writer.file);
+                return true;
+            }
+            writer.append = header.end < FS_IMAGE_COMPACT_MIN || header.end <= 2 * header.live_bytes;
+        }
+        if (writer.append) {
+            writer.end = header.end;
+            writer.append = fs_image_seek(writer.file, writer.end);  // Overwrites any torn save
+        }
+        if (!writer.append && writer.file) {
+            fclose(writer.file);
+            writer.file = NULL;
+        }
+    }
+
+    // Otherwise write a fresh image next to the target and swap it in
+    char temp_path[MAX_PATH];
+    if (!writer.append) {
+        snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+        writer.file = fopen(temp_path, "wb");
+        if (!writer.file) return false;
+        FsImageHeader blank;
+        memset(&blank, 0, sizeof(blank));
+        fs_image_write(&writer, &blank, sizeof(blank));
+    }
+
+    bool ok = fs_image_write_tree(&writer, fs);
+    ok = fclose(writer.file) == 0 && ok;
+    if (!writer.append) {
+#ifdef _WIN32
+        if (ok) remove(path);
+#endif
+        ok = ok && rename(temp_path, path) == 0;
+        if (!ok) remove(temp_path);
+    }
+
+    if (ok) {
+        // Bodies now have a home in this image; later saves can skip them
+        for (uint64_t i = 0; i < writer.count; i++) {
+            writer.nodes[i]->image_offset = writer.records[i].data_offset;
+        }
+        if (!same_image) {
+            free(fs->image_path);
+            fs->image_path = strdup(path);
+        }
+        fs->dirty = false;
+    }
+    free(writer.records);
+    free(writer.nodes);
+    free(writer.names);
+    free(writer.bodies);
+    free(writer.body_offsets);
+    return ok;
+}
+
+bool fs_image_save(FileSystem* fs, const char* path) {
+    // Readers carry on; only changes wait for the image
+    fs_write_begin(fs);
+    bool saved = fs_image_save_locked(fs, path);
+    fs_write_end(fs);
+    return saved;
+}
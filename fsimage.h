@@ -0,0 +1,65 @@
+#ifndef MICROOS_FSIMAGE_H
+#define MICROOS_FSIMAGE_H
+
+#include "filesystem.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FS_IMAGE_FILE "microos.img"     // Host file the filesystem is kept in
+#define FS_IMAGE_MAGIC "MICROFS"        // First bytes of an image, terminator included
+#define FS_IMAGE_VERSION 2              // Version 1 lacked journal_seq and is still read
+#define FS_IMAGE_NO_PARENT 0xFFFFFFFFu  // Parent index of the root record
+#define FS_IMAGE_COMPACT_MIN (1 << 20)  // Never compact images smaller than this
+
+// Layout: the header sits at offset 0 and everything else is appended after
+// it. File bodies are stored NUL-terminated so they can be used in place. Each
+// save adds the bodies that changed, then a name block and a node table, and
+// finally rewrites the header. Until that last write the previous state is
+// still intact.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;       // sizeof(FsImageHeader)
+    uint64_t table_offset;      // FsImageNode[node_count], parents before children
+    uint64_t node_count;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t end;               // Bytes in use; anything past this is a torn save
+    uint64_t live_bytes;        // Bytes the current state references, for compaction
+    uint64_t journal_seq;       // Last journal record this state includes
+} FsImageHeader;
+
+// One node. References are table indices and file offsets, never pointers.
+typedef struct {
+    uint32_t parent;            // Table index, FS_IMAGE_NO_PARENT for the root
+    uint32_t name_length;
+    uint64_t name_offset;       // Into the name block
+    int64_t created;
+    int64_t modified;
+    uint64_t data_offset;       // Absolute; 0 for directories and empty files
+    uint64_t size;
+    uint32_t is_directory;
+    uint32_t reserved;
+} FsImageNode;
+
+// A mapped image that file bodies may point into, kept until fs_destroy
+typedef struct FsImage {
+    struct FsImage* next;
+    void* map;
+    size_t size;
+} FsImage;
+
+// Opens a saved image. Only the node table is walked; bodies are used straight
+// from the mapping and paged in on first access, so opening costs O(nodes)
+// whatever the data size. Returns NULL if the file is missing or invalid.
+FileSystem* fs_image_open(const char* path);
+
+// Saves fs to path. Saving to the image fs came from (or was last saved to)
+// appends only the bodies changed since; once most of the file is garbage it
+// is rewritten from scratch instead.
+bool fs_image_save(FileSystem* fs, const char* path);
+
+// Unmaps the images behind fs. Called by fs_destroy.
+void fs_image_release(FileSystem* fs);
+
+#endif // MICROOS_FSIMAGE_H
@@ -0,0 +1,365 @@
+#include "fsjournal.h"
+#include "fsimage.h"
+#include "command.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+static uint32_t crc_table[256];
+
+static void fs_journal_init_crc(void) {
+    if (crc_table[1]) return;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0);
+        }
+        crc_table[i] = crc;
+    }
+}
+
+// Standard CRC-32 (as in zip and PNG), continued from crc
+static uint32_t fs_journal_crc(uint32_t crc, const void* data, size_t length) {
+    const unsigned char* p = data;
+    crc = ~crc;
+    while (length--) {
+        crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t fs_journal_record_crc(const FsJournalRecord* record, const char* payload) {
+    uint32_t crc = fs_journal_crc(0, (const char*)record + sizeof(record->crc),
+                                  sizeof(FsJournalRecord) - sizeof(record->crc));
+    return fs_journal_crc(crc, payload, record->path_length + record->data_length);
+}
+
+static bool fs_journal_seek(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static bool fs_journal_truncate(FILE* file, uint64_t size) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), (__int64)size) == 0;
+#else
+    return ftruncate(fileno(file), (off_t)size) == 0;
+#endif
+}
+
+static bool fs_journal_sync(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Applies one logged change. Failures are ignored: the record may describe a
+// change that a partly saved state already contains.
+static void fs_journal_apply(FileSystem* fs, const FsJournalRecord* record, const char* path,
+                             const char* data) {
+    FileNode* node = NULL;
+    switch (record->op) {
+    case FS_JOURNAL_CREATE:
+        node = fs_create_file(fs, path, record->is_directory);
+        if (node) node->created = (time_t)record->time;
+        break;
+    case FS_JOURNAL_WRITE:
+        // The whole record, NUL bytes included, as a rolled back or patched body may hold them
+        if (fs_write_file_n(fs, path, data, record->data_length)) node = fs_get_file(fs, path);
+        break;
+    case FS_JOURNAL_APPEND:
+        if (fs_append_file(fs, path, data, record->data_length)) node = fs_get_file(fs, path);
+        break;
+    case FS_JOURNAL_DELETE:
+        fs_delete_file(fs, path);
+        break;
+    case FS_JOURNAL_TOUCH:
+        node = fs_get_file(fs, path);
+        break;
+    case FS_JOURNAL_PATCH:
+    case FS_JOURNAL_TRUNCATE: {
+        FsHandle* handle = fs_open(fs, path, FS_OPEN_WRITE);
+        if (!handle) break;
+        bool ok = record->op == FS_JOURNAL_PATCH
+                      ? fs_seek(handle, (long)record->offset, SEEK_SET) >= 0 &&
+                            fs_write(handle, data, record->data_length) == (long)record->data_length
+                      : fs_truncate(handle, record->offset);
+        fs_close(handle);
+        if (ok) node = fs_get_file(fs, path);
+        break;
+    }
+    case FS_JOURNAL_RENAME: {
+        char new_path[MAX_PATH];
+        if (record->data_length >= sizeof(new_path)) break;
+        memcpy(new_path, data, record->data_length);
+        new_path[record->data_length] = '\0';
+        if (fs_rename(fs, path, new_path)) node = fs_get_file(fs, new_path);
+        break;
+    }
+    }
+    if (node) node->modified = (time_t)record->time;
+}
+
+// Replays records newer than the image. Returns the offset just past the last
+// good record; anything after it is a torn write or corruption.
+static uint64_t fs_journal_replay(FileSystem* fs, FILE* file, uint64_t* last_seq) {
+    uint64_t offset = 0;
+    char path[MAX_PATH];
+    char* data = NULL;
+    size_t data_capacity = 0;
+    FsJournalRecord record;
+
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.path_length == 0 || record.path_length >= MAX_PATH || record.data_length >= MAX_CONTENT ||
+            record.op < FS_JOURNAL_CREATE || record.op > FS_JOURNAL_TOUCH) {
+            break;
+        }
+        size_t payload = record.path_length + record.data_length;
+        if (payload > data_capacity) {
+            char* grown = realloc(data, payload);
+            if (!grown) break;
+            data = grown;
+            data_capacity = payload;
+        }
+        if (fread(data, 1, payload, file) != payload || fs_journal_record_crc(&record, data) != record.crc) {
+            break;
+        }
+        memcpy(path, data, record.path_length);
+        path[record.path_length] = '\0';
+        if (record.seq > fs->journal_seq) {
+            fs_journal_apply(fs, &record, path, data + record.path_length);
+        }
+        if (record.seq > *last_seq) *last_seq = record.seq;
+        offset += sizeof(record) + payload;
+    }
+    free(data);
+    return offset;
+}
+
+// Writes out everything pending with one fsync
+static bool fs_journal_commit(FsJournal* journal) {
+    SDL_LockMutex(journal->io_lock);
+    SDL_LockMutex(journal->lock);
+    // Swap buffers so new changes can be recorded while this batch is written
+    char* batch = journal->pending;
+    size_t batch_size = journal->pending_size;
+    size_t batch_capacity = journal->pending_capacity;
+    journal->pending = journal->writing;
+    journal->pending_capacity = journal->writing_capacity;
+    journal->pending_size = 0;
+    journal->writing = batch;
+    journal->writing_capacity = batch_capacity;
+    SDL_UnlockMutex(journal->lock);
+
+    bool ok = true;
+    if (batch_size > 0) {
+        ok = fwrite(batch, 1, batch_size, journal->file) == batch_size && fs_journal_sync(journal->file);
+        if (ok) {
+            journal->size += batch_size;
+        } else {
+            journal->failed = true;
+        }
+    }
+    SDL_UnlockMutex(journal->io_lock);
+    return ok;
+}
+
+// Commit thread: wakes when a batch fills up or the oldest change has waited
+// FS_JOURNAL_COMMIT_MS, so a burst of small edits shares one fsync
+static int fs_journal_thread(void* data) {
+    FsJournal* journal = data;
+    SDL_LockMutex(journal->lock);
+    while (!journal->stopping) {
+        if (journal->pending_size == 0) {
+            SDL_CondWait(journal->wake, journal->lock);
+            continue;
+        }
+        if (journal->pending_size < FS_JOURNAL_GROUP_BYTES) {
+            SDL_CondWaitTimeout(journal->wake, journal->lock, FS_JOURNAL_COMMIT_MS);
+        }
+        SDL_UnlockMutex(journal->lock);
+        fs_journal_commit(journal);
+        SDL_LockMutex(journal->lock);
+    }
+    SDL_UnlockMutex(journal->lock);
+    return 0;
+}
+
+bool fs_journal_open(FileSystem* fs, const char* path) {
+    fs_journal_init_crc();
+    FILE* file = fopen(path, "r+b");
+    if (!file) file = fopen(path, "w+b");
+    if (!file) return false;
+
+    // Replay with logging off, so the replayed changes are not logged again
+    uint64_t last_seq = fs->journal_seq;
+    uint64_t end = fs_journal_replay(fs, file, &last_seq);
+    if (!fs_journal_truncate(file, end) || !fs_journal_seek(file, end)) {
+        fclose(file);
+        return false;
+    }
+
+    FsJournal* journal = calloc(1, sizeof(FsJournal));
+    journal->file = file;
+    journal->size = end;
+    journal->next_seq = last_seq + 1;
+    journal->lock = SDL_CreateMutex();
+    journal->io_lock = SDL_CreateMutex();
+    journal->wake = SDL_CreateCond();
+    journal->thread = SDL_CreateThread(fs_journal_thread, "fsjournal", journal);
+    fs->journal = journal;
+    return true;
+}
+
+static void fs_journal_add(FileSystem* fs, FsJournalOp op, const char* path, bool is_directory, size_t offset,
+                           const char* data, size_t data_length) {
+    FsJournal* journal = fs->journal;
+    if (!journal) return;
+    size_t path_length = strlen(path);
+    if (path_length == 0 || path_length >= MAX_PATH) return;
+
+    FsJournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.op = (uint8_t)op;
+    record.is_directory = is_directory;
+    record.path_length = (uint16_t)path_length;
+    record.offset = (uint32_t)offset;  // Bodies stay under MAX_CONTENT
+    record.time = (int64_t)time(NULL);
+    record.data_length = (uint32_t)data_length;
+    size_t size = sizeof(record) + path_length + data_length;
+
+    SDL_LockMutex(journal->lock);
+    if (journal->pending_size + size > journal->pending_capacity) {
+        size_t capacity = journal->pending_capacity ? journal->pending_capacity * 2 : FS_JOURNAL_GROUP_BYTES;
+        while (capacity < journal->pending_size + size) capacity *= 2;
+        char* grown = realloc(journal->pending, capacity);
+        if (!grown) {
+            journal->failed = true;
+            SDL_UnlockMutex(journal->lock);
+            return;
+        }
+        journal->pending = grown;
+        journal->pending_capacity = capacity;
+    }
+    // Sequence numbers are handed out under the lock, so they match file order
+    record.seq = journal->next_seq++;
+    char* out = journal->pending + journal->pending_size;
+    memcpy(out + sizeof(record), path, path_length);
+    if (data_length) memcpy(out + sizeof(record) + path_length, data, data_length);
+    record.crc = fs_journal_record_crc(&record, out + sizeof(record));
+    memcpy(out, &record, sizeof(record));
+    journal->pending_size += size;
+    if (journal->pending_size == size || journal->pending_size >= FS_JOURNAL_GROUP_BYTES) {
+        SDL_CondSignal(journal->wake);
+    }
+    SDL_UnlockMutex(journal->lock);
+}
+
+void fs_journal_record(FileSystem* fs, FsJournalOp op, const char* path, bool is_directory,
+                       const char* data, size_t data_length) {
+    fs_journal_add(fs, op, path, is_directory, 0, data, data_length);
+}
+
+void fs_journal_record_at(FileSystem* fs, FsJournalOp op, const char* path, size_t offset,
+                          const char* data, size_t data_length) {
+    fs_journal_add(fs, op, path, false, offset, data, data_length);
+}
+
+bool fs_journal_flush(FileSystem* fs) {
+    if (!fs->journal) return true;
+    return fs_journal_commit(fs->journal) && !fs->journal->failed;
+}
+
+static bool fs_journal_checkpoint_locked(FileSystem* fs, const char* image_path) {
+    FsJournal* journal = fs->journal;
+    if (!journal) return fs_image_save(fs, image_path);
+
+    // The image covers every change recorded so far
+    SDL_LockMutex(journal->lock);
+    uint64_t seq = journal->next_seq - 1;
+    SDL_UnlockMutex(journal->lock);
+    if (!fs_journal_flush(fs)) return false;
+    unsigned long long saved_seq = fs->journal_seq;
+    fs->journal_seq = seq;
+    if (!fs_image_save(fs, image_path)) {
+        fs->journal_seq = saved_seq;
+        return false;
+    }
+
+    // Empty the journal unless a job logged more while the image was written;
+    // replay skips what the image already has either way
+    SDL_LockMutex(journal->io_lock);
+    SDL_LockMutex(journal->lock);
+    bool idle = journal->next_seq - 1 == seq && journal->pending_size == 0;
+    SDL_UnlockMutex(journal->lock);
+    if (idle && fs_journal_truncate(journal->file, 0) && fs_journal_seek(journal->file, 0)) {
+        journal->size = 0;
+    }
+    SDL_UnlockMutex(journal->io_lock);
+    return true;
+}
+
+bool fs_journal_checkpoint(FileSystem* fs, const char* image_path) {
+    fs_write_begin(fs);
+    bool saved = fs_journal_checkpoint_locked(fs, image_path);
+    fs_write_end(fs);
+    return saved;
+}
+
+void fs_journal_poll(FileSystem* fs, const char* image_path) {
+    if (fs->journal && fs->journal->size >= FS_JOURNAL_CHECKPOINT_BYTES) {
+        fs_journal_checkpoint(fs, image_path);
+    }
+}
+
+void fs_journal_close(FileSystem* fs) {
+    FsJournal* journal = fs->journal;
+    if (!journal) return;
+    SDL_LockMutex(journal->lock);
+    journal->stopping = true;
+    SDL_CondSignal(journal->wake);
+    SDL_UnlockMutex(journal->lock);
+    SDL_WaitThread(journal->thread, NULL);
+
+    fs_journal_commit(journal);
+    fclose(journal->file);
+    SDL_DestroyCond(journal->wake);
+    SDL_DestroyMutex(journal->lock);
+    SDL_DestroyMutex(journal->io_lock);
+    free(journal->pending);
+    free(journal->writing);
+    free(journal);
+    fs->journal = NULL;
+}
+
+static int fs_journal_cmd_sync(CommandContext* ctx, int argc, char** argv) {
+    if (!command_require_foreground(ctx, argv[0])) return 1;
+    // Another path is an export: the journal still belongs to the main image
+    const char* path = argc > 1 ? argv[1] : FS_IMAGE_FILE;
+    bool ok = argc > 1 ? fs_journal_flush(ctx->fs) && fs_image_save(ctx->fs, path)
+                       : fs_journal_checkpoint(ctx->fs, path);
+    if (!ok) {
+        command_printf(ctx, "Error: Could not save filesystem to %s", path);
+        return 1;
+    }
+    command_printf(ctx, "Filesystem saved to %s", path);
+    return 0;
+}
+
+void fs_journal_register_commands(void) {
+    command_register("sync", "sync [image]", "Save the filesystem to disk", fs_journal_cmd_sync);
+}
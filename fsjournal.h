@@ -0,0 +1,85 @@
+#ifndef MICROOS_FSJOURNAL_H
+#define MICROOS_FSJOURNAL_H
+
+#include "filesystem.h"
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FS_JOURNAL_FILE "microos.journal"          // Host file next to the image
+#define FS_JOURNAL_COMMIT_MS 20                    // Longest a change waits for its fsync
+#define FS_JOURNAL_GROUP_BYTES (64 * 1024)         // Pending bytes that force an early commit
+#define FS_JOURNAL_CHECKPOINT_BYTES (8 * 1024 * 1024)  // Journal size that triggers an image save
+
+typedef enum {
+    FS_JOURNAL_CREATE = 1,
+    FS_JOURNAL_WRITE,
+    FS_JOURNAL_APPEND,
+    FS_JOURNAL_DELETE,
+    FS_JOURNAL_RENAME,      // data holds the new path
+    FS_JOURNAL_PATCH,       // data goes at offset
+    FS_JOURNAL_TRUNCATE,    // offset is the size left
+    FS_JOURNAL_TOUCH        // Only the modified time changes
+} FsJournalOp;
+
+// On-disk record header, followed by path_length bytes of absolute path and
+// data_length bytes of data
+typedef struct {
+    uint32_t crc;           // CRC-32 of the rest of the record, payload included
+    uint8_t op;
+    uint8_t is_directory;
+    uint16_t path_length;
+    uint64_t seq;           // Increases by one per record
+    int64_t time;           // When the change was made
+    uint32_t data_length;
+    uint32_t offset;        // For PATCH and TRUNCATE; 0 otherwise
+} FsJournalRecord;
+
+// Write-ahead log of filesystem changes. Changes are appended to a memory
+// buffer by whichever thread makes them; a commit thread writes the buffer
+// out with a single fsync per batch (group commit).
+typedef struct FsJournal {
+    FILE* file;
+    char* pending;          // Records not yet handed to the commit thread
+    size_t pending_size;
+    size_t pending_capacity;
+    char* writing;          // Batch being written; swapped with pending
+    size_t writing_capacity;
+    uint64_t size;          // Bytes in the journal file
+    uint64_t next_seq;
+    SDL_mutex* lock;        // Guards pending and next_seq
+    SDL_mutex* io_lock;     // One commit at a time
+    SDL_cond* wake;
+    SDL_Thread* thread;
+    bool stopping;
+    bool failed;            // A write or fsync failed; changes are no longer durable
+} FsJournal;
+
+// Replays the changes logged after fs's image was saved, then starts logging
+// new ones to path. A torn or corrupt tail (from a crash) is dropped.
+bool fs_journal_open(FileSystem* fs, const char* path);
+
+// Called by the filesystem after each change, with the absolute path and
+// data needed to replay it. Does nothing while no journal is open.
+void fs_journal_record(FileSystem* fs, FsJournalOp op, const char* path, bool is_directory,
+                       const char* data, size_t data_length);
+// The same for a change to part of a file.
+void fs_journal_record_at(FileSystem* fs, FsJournalOp op, const char* path, size_t offset,
+                          const char* data, size_t data_length);
+
+// Blocks until everything recorded so far is on disk.
+bool fs_journal_flush(FileSystem* fs);
+
+// Saves the image and empties the journal, whose changes it now contains.
+bool fs_journal_checkpoint(FileSystem* fs, const char* image_path);
+
+// Checkpoints once the journal has grown large. Call from the main loop.
+void fs_journal_poll(FileSystem* fs, const char* image_path);
+
+// Commits what is pending and stops logging. Called by fs_destroy.
+void fs_journal_close(FileSystem* fs);
+
+// Registers the sync builtin.
+void fs_journal_register_commands(void);
+
+#endif // MICROOS_FSJOURNAL_H
@@ -0,0 +1,120 @@
+#include "fslz.h"
+#include <stdint.h>
+#include <string.h>
+
+#define FS_LZ_HASH_BITS 12
+#define FS_LZ_MIN_MATCH 4
+#define FS_LZ_MAX_OFFSET 65535
+
+static uint32_t fs_lz_read32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static unsigned fs_lz_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - FS_LZ_HASH_BITS);
+}
+
+// Writes the part of a length that does not fit its 4-bit nibble
+static char* fs_lz_write_length(char* out, size_t length) {
+    while (length >= 255) {
+        *out++ = (char)255;
+        length -= 255;
+    }
+    *out++ = (char)length;
+    return out;
+}
+
+static char* fs_lz_write_sequence(char* out, const char* literals, size_t literal_count,
+                                  size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - FS_LZ_MIN_MATCH : 0;
+    *out++ = (char)(((literal_count < 15 ? literal_count : 15) << 4) | (match_code < 15 ? match_code : 15));
+    if (literal_count >= 15) out = fs_lz_write_length(out, literal_count - 15);
+    memcpy(out, literals, literal_count);
+    out += literal_count;
+    if (match_length) {
+        *out++ = (char)(offset & 0xFF);
+        *out++ = (char)(offset >> 8);
+        if (match_code >= 15) out = fs_lz_write_length(out, match_code - 15);
+    }
+    return out;
+}
+
+size_t fs_lz_bound(size_t length) {
+    return length + length / 255 + 16;
+}
+
+size_t fs_lz_compress(const char* src, size_t length, char* dst) {
+    uint32_t table[1 << FS_LZ_HASH_BITS];  // Last position + 1 seen per hash, 0 if none
+    memset(table, 0, sizeof(table));
+    char* out = dst;
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + FS_LZ_MIN_MATCH <= length) {
+        uint32_t sequence = fs_lz_read32(src + pos);
+        unsigned hash = fs_lz_hash(sequence);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t)(pos + 1);
+        if (candidate == 0 || pos - (candidate - 1) > FS_LZ_MAX_OFFSET ||
+            fs_lz_read32(src + candidate - 1) != sequence) {
+            pos += 1 + ((pos - anchor) >> 6);  // Skip faster through data that does not match
+            continue;
+        }
+        candidate--;
+        size_t match_length = FS_LZ_MIN_MATCH;
+        while (pos + match_length < length && src[candidate + match_length] == src[pos + match_length]) {
+            match_length++;
+        }
+        out = fs_lz_write_sequence(out, src + anchor, pos - anchor, pos - candidate, match_length);
+        pos += match_length;
+        anchor = pos;
+    }
+    out = fs_lz_write_sequence(out, src + anchor, length - anchor, 0, 0);
+    return (size_t)(out - dst);
+}
+
+// Reads the extra bytes of a length whose nibble was 15
+static bool fs_lz_read_length(const unsigned char** in, const unsigned char* end, size_t* length) {
+    unsigned byte;
+    do {
+        if (*in >= end) return false;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool fs_lz_decompress(const char* src, size_t packed_size, char* dst, size_t length) {
+    const unsigned char* in = (const unsigned char*)src;
+    const unsigned char* end = in + packed_size;
+    size_t pos = 0;
+    while (in < end) {
+        unsigned token = *in++;
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !fs_lz_read_length(&in, end, &literal_count)) return false;
+        if (literal_count > (size_t)(end - in) || literal_count > length - pos) return false;
+        memcpy(dst + pos, in, literal_count);
+        in += literal_count;
+        pos += literal_count;
+        if (in == end) break;  // The last sequence has no match
+
+        if (end - in < 2) return false;
+        size_t offset = in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15 && !fs_lz_read_length(&in, end, &match_length)) return false;
+        match_length += FS_LZ_MIN_MATCH;
+        if (offset == 0 || offset > pos || match_length > length - pos) return false;
+        if (offset >= match_length) {
+            memcpy(dst + pos, dst + pos - offset, match_length);
+        } else {
+            // Byte by byte: the match overlaps the bytes it produces
+            for (size_t i = 0; i < match_length; i++) {
+                dst[pos + i] = dst[pos + i - offset];
+            }
+        }
+        pos += match_length;
+    }
+    return pos == length;
+}
@@ -0,0 +1,22 @@
+#ifndef MICROOS_FSLZ_H
+#define MICROOS_FSLZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A small LZ77 codec in the style of LZ4 blocks: greedy hash-table matching
+// for speed over ratio. Each sequence is a token (literal count and match
+// length nibbles), extra length bytes, the literals, a 2-byte little-endian
+// offset and extra match length bytes. The last sequence has literals only.
+
+// Largest output fs_lz_compress can produce for length bytes
+size_t fs_lz_bound(size_t length);
+
+// Compresses length bytes of src into dst, which must hold fs_lz_bound(length)
+// bytes. Returns the compressed size.
+size_t fs_lz_compress(const char* src, size_t length, char* dst);
+
+// Decodes exactly length bytes into dst. Returns false if src is malformed.
+bool fs_lz_decompress(const char* src, size_t packed_size, char* dst, size_t length);
+
+#endif // MICROOS_FSLZ_H
@@ -0,0 +1,543 @@
+#include "fsmount.h"
+#include "fsstore.h"
+#include "command.h"
+#include "trie.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+// What a directory changing under it looks like to inotify
+#define FS_MOUNT_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE | \
+                         IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+// One host directory entry, as a FileNode will show it
+typedef struct {
+    char* name;
+    bool is_directory;
+    size_t size;            // Capped as file bodies are
+    time_t modified;
+} FsHostEntry;
+
+// Only files and directories are shown; devices and pipes could block a read
+static bool fs_mount_stat(const char* path, FsHostEntry* entry) {
+    struct stat info;
+    if (stat(path, &info) != 0) return false;
+    int type = info.st_mode & S_IFMT;
+    if (type != S_IFDIR && type != S_IFREG) return false;
+    entry->is_directory = type == S_IFDIR;
+    entry->size = entry->is_directory ? 0 : (size_t)info.st_size;
+    if (entry->size >= MAX_CONTENT) entry->size = MAX_CONTENT - 1;
+    entry->modified = info.st_mtime;
+    return true;
+}
+
+static int fs_mount_compare(const void* a, const void* b) {
+    return strcmp(((const FsHostEntry*)a)->name, ((const FsHostEntry*)b)->name);
+}
+
+static bool fs_mount_add_entry(FsHostEntry** entries, int* count, int* capacity, const FsHostEntry* entry) {
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 64;
+        FsHostEntry* list = realloc(*entries, grown * sizeof(FsHostEntry));
+        if (!list) return false;
+        *entries = list;
+        *capacity = grown;
+    }
+    (*entries)[(*count)++] = *entry;
+    return true;
+}
+
+// Reads a host directory into *entries, sorted by name as directory indexes
+// are. A directory that cannot be read comes back empty. Returns the count.
+static int fs_mount_scan(const char* path, FsHostEntry** entries) {
+    int count = 0, capacity = 0;
+    char child[MAX_PATH];
+    *entries = NULL;
+#ifdef _WIN32
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s/*", path);
+    struct _finddata_t data;
+    intptr_t find = _findfirst(pattern, &data);
+    if (find == -1) return 0;
+    do {
+        const char* name = data.name;
+#else
+    DIR* dir = opendir(path);
+    if (!dir) return 0;
+    struct dirent* item;
+    while ((item = readdir(dir))) {
+        const char* name = item->d_name;
+#endif
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        FsHostEntry entry;
+        if (snprintf(child, sizeof(child), "%s/%s", path, name) >= (int)sizeof(child) ||
+            !fs_mount_stat(child, &entry)) {
+            continue;
+        }
+        entry.name = strdup(name);
+        if (!entry.name) break;
+        if (!fs_mount_add_entry(entries, &count, &capacity, &entry)) {
+            free(entry.name);
+            break;
+        }
+#ifdef _WIN32
+    } while (_findnext(find, &data) == 0);
+    _findclose(find);
+#else
+    }
+    closedir(dir);
+#endif
+    if (count > 1) qsort(*entries, count, sizeof(FsHostEntry), fs_mount_compare);
+    return count;
+}
+
+static FsMount* fs_mount_find(FsMounts* mounts, const FileNode* root) {
+    for (int i = 0; i < mounts->count; i++) {
+        if (mounts->list[i].root == root) return &mounts->list[i];
+    }
+    return NULL;
+}
+
+// Writes the host path of a host node into out, climbing to its mount's root.
+// Returns false if it does not fit or the node belongs to no mount.
+static bool fs_mount_host_path(FsMounts* mounts, const FileNode* node, char* out, size_t size) {
+    // Fill the buffer from the end, as fs_node_path does
+    size_t pos = size - 1;
+    out[pos] = '\0';
+    for (; node; node = node->parent) {
+        FsMount* mount = fs_mount_find(mounts, node);
+        const char* name = mount ? mount->host : node->name;
+        size_t length = strlen(name);
+        if (length + 1 > pos) return false;
+        pos -= length;
+        memcpy(out + pos, name, length);
+        if (mount) {
+            memmove(out, out + pos, size - pos);
+            return true;
+        }
+        out[--pos] = '/';
+    }
+    return false;
+}
+
+// Shows a host entry in dir. The node is a host one, not yet loaded, from
+// the moment readers can find it (see fs_make_child).
+static void fs_mount_add(FileSystem* fs, FileNode* dir, const FsHostEntry* entry) {
+    FileNode* node = fs_make_child(fs, dir, entry->name, entry->is_directory);
+    if (!node) return;  // A name the tree cannot hold
+    node->created = entry->modified;
+    node->modified = entry->modified;
+    // The size shows before the body is read
+    if (!entry->is_directory) fs_set_content(fs, node, NULL, NULL, entry->size);
+}
+
+// Forgets a file's body so the next read fetches it again
+static void fs_mount_refresh(FileSystem* fs, FileNode* file, const FsHostEntry* entry) {
+    // A reader seeing the flag waits for the writer lock, then reads the new body
+    file->unloaded = true;
+    SDL_MemoryBarrierRelease();
+    fs_set_content(fs, file, NULL, NULL, entry->size);
+    file->modified = entry->modified;
+}
+
+static void fs_mount_remove(FileSystem* fs, FileNode* node) {
+    // Never leave the shell inside a directory that no longer exists
+    for (FileNode* dir = fs->current_dir; dir; dir = dir->parent) {
+        if (dir == node) {
+            fs->current_dir = node->parent;
+            break;
+        }
+    }
+    fs_unlink(fs, node);
+    fs_free_node(fs, node);
+}
+
+typedef struct {
+    FileNode** nodes;
+    int count;
+} FsMountChildren;
+
+static bool fs_mount_collect(FileNode* node, void* user) {
+    FsMountChildren* children = user;
+    children->nodes[children->count++] = node;
+    return true;
+}
+
+// Brings dir's children in line with the host directory at path: both sides
+// are in name order, so one merge finds what was added, removed or changed.
+static void fs_mount_sync(FileSystem* fs, FileNode* dir, const char* path) {
+    FsHostEntry* entries;
+    int count = fs_mount_scan(path, &entries);
+    FsMountChildren children = {NULL, 0};
+    if (dir->child_count > 0) {
+        children.nodes = malloc(dir->child_count * sizeof(FileNode*));
+        if (!children.nodes) goto done;
+        fs_each_child(dir, "", 0, fs_mount_collect, &children);
+    }
+
+    int i = 0, j = 0;
+    while (i < children.count || j < count) {
+        int order = i == children.count ? 1 : j == count ? -1 : strcmp(children.nodes[i]->name, entries[j].name);
+        if (order < 0) {
+            fs_mount_remove(fs, children.nodes[i++]);
+        } else if (order > 0) {
+            fs_mount_add(fs, dir, &entries[j++]);
+        } else {
+            FileNode* child = children.nodes[i++];
+            const FsHostEntry* entry = &entries[j++];
+            if (child->is_directory != entry->is_directory) {
+                fs_mount_remove(fs, child);
+                fs_mount_add(fs, dir, entry);
+            } else if (!child->is_directory && (child->modified != entry->modified || child->size != entry->size)) {
+                fs_mount_refresh(fs, child, entry);
+            }
+        }
+    }
+
+done:
+    free(children.nodes);
+    for (int k = 0; k < count; k++) {
+        free(entries[k].name);
+    }
+    free(entries);
+}
+
+static void fs_mount_read(FileSystem* fs, FileNode* file, const char* path) {
+    FILE* host = fopen(path, "rb");
+    char* data = NULL;
+    size_t length = 0;
+    if (host) {
+        fseek(host, 0, SEEK_END);
+        long end = ftell(host);
+        fseek(host, 0, SEEK_SET);
+        size_t size = end > 0 ? (size_t)end : 0;
+        if (size >= MAX_CONTENT) size = MAX_CONTENT - 1;
+        data = malloc(size + 1);
+        if (data) length = fread(data, 1, size, host);
+        fclose(host);
+    }
+    // An unreadable file shows as empty rather than failing every read
+    FsBlob* blob = fs_store_put(fs->store, data ? data : "", length, NULL);
+    free(data);
+    if (blob) fs_set_content(fs, file, NULL, blob, length);
+}
+
+static void fs_mount_watch(FsMounts* mounts, FileNode* dir, const char* path) {
+#ifdef __linux__
+    if (mounts->inotify < 0) return;
+    if (mounts->watch_count == mounts->watch_capacity) {
+        int capacity = mounts->watch_capacity ? mounts->watch_capacity * 2 : 16;
+        FsMountWatch* watches = realloc(mounts->watches, capacity * sizeof(FsMountWatch));
+        if (!watches) return;
+        mounts->watches = watches;
+        mounts->watch_capacity = capacity;
+    }
+    // Past the user's inotify limit the directory stays as it was loaded
+    int wd = inotify_add_watch(mounts->inotify, path, FS_MOUNT_EVENTS);
+    if (wd < 0) return;
+    mounts->watches[mounts->watch_count++] = (FsMountWatch){wd, dir};
+#endif
+}
+
+void fs_mount_load(FileSystem* fs, FileNode* node) {
+    fs_write_begin(fs);
+    FsMounts* mounts = fs->mounts;
+    char path[MAX_PATH];
+    if (node->unloaded && mounts && fs_mount_host_path(mounts, node, path, sizeof(path))) {
+        if (node->is_directory) {
+            fs_mount_sync(fs, node, path);
+            fs_mount_watch(mounts, node, path);
+        } else {
+            fs_mount_read(fs, node, path);
+        }
+    }
+    // Cleared after the children or body are in, so a reader that sees it clear finds them
+    SDL_MemoryBarrierRelease();
+    node->unloaded = false;
+    fs_write_end(fs);
+}
+
+#ifdef __linux__
+// Queues a directory to be listed again once the poll has read every event
+static void fs_mount_stale(FsMounts* mounts, FileNode* dir) {
+    for (int i = 0; i < mounts->stale_count; i++) {
+        if (mounts->stale[i] == dir) return;
+    }
+    if (mounts->stale_count == mounts->stale_capacity) {
+        int capacity = mounts->stale_capacity ? mounts->stale_capacity * 2 : 16;
+        FileNode** stale = realloc(mounts->stale, capacity * sizeof(FileNode*));
+        if (!stale) return;  // The change shows the next time the directory changes
+        mounts->stale = stale;
+        mounts->stale_capacity = capacity;
+    }
+    mounts->stale[mounts->stale_count++] = dir;
+}
+
+// A write to a file forgets its body at once: its size and time may not
+// have changed enough for a listing to tell
+static void fs_mount_file_changed(FileSystem* fs, FsMounts* mounts, FileNode* dir, FileNode* file) {
+    char path[MAX_PATH];
+    FsHostEntry entry;
+    if (fs_mount_host_path(mounts, file, path, sizeof(path)) && fs_mount_stat(path, &entry) &&
+        !entry.is_directory) {
+        fs_mount_refresh(fs, file, &entry);
+    } else {
+        fs_mount_stale(mounts, dir);
+    }
+}
+
+static void fs_mount_event(FileSystem* fs, FsMounts* mounts, const struct inotify_event* event) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        // Events were lost, so every watched directory is listed again
+        for (int i = 0; i < mounts->watch_count; i++) {
+            fs_mount_stale(mounts, mounts->watches[i].dir);
+        }
+        return;
+    }
+    if (event->mask & IN_IGNORED) {
+        // The kernel dropped the watch, so the host directory is gone. One
+        // made again under the same name gets loaded and watched afresh;
+        // otherwise its parent's listing removes the node.
+        int kept = 0;
+        for (int i = 0; i < mounts->watch_count; i++) {
+            FsMountWatch watch = mounts->watches[i];
+            if (watch.wd != event->wd) {
+                mounts->watches[kept++] = watch;
+                continue;
+            }
+            watch.dir->unloaded = true;
+            fs_mount_stale(mounts, watch.dir);
+        }
+        mounts->watch_count = kept;
+        return;
+    }
+    for (int i = 0; i < mounts->watch_count; i++) {
+        if (mounts->watches[i].wd != event->wd) continue;
+        FileNode* dir = mounts->watches[i].dir;
+        FileNode* child = event->len ? trie_find(dir->index, event->name) : NULL;
+        if ((event->mask & (IN_MODIFY | IN_CLOSE_WRITE)) && child && !child->is_directory) {
+            fs_mount_file_changed(fs, mounts, dir, child);
+        } else {
+            fs_mount_stale(mounts, dir);
+        }
+    }
+}
+#endif
+
+void fs_mount_poll(FileSystem* fs) {
+#ifdef __linux__
+    FsMounts* mounts = fs->mounts;
+    if (!mounts || mounts->inotify < 0) return;
+    union {
+        struct inotify_event event;
+        char bytes[4096];
+    } buffer;
+    // Nonblocking: a frame with no host changes costs one failed read
+    ssize_t length = read(mounts->inotify, buffer.bytes, sizeof(buffer.bytes));
+    if (length <= 0) return;
+
+    fs_write_begin(fs);
+    while (length > 0) {
+        for (ssize_t offset = 0; offset < length;) {
+            const struct inotify_event* event = (const struct inotify_event*)(buffer.bytes + offset);
+            fs_mount_event(fs, mounts, event);
+            offset += sizeof(struct inotify_event) + event->len;
+        }
+        length = read(mounts->inotify, buffer.bytes, sizeof(buffer.bytes));
+    }
+    // Each changed directory is listed once however many events it had.
+    // Removing a directory drops it from the queue (fs_mount_forget).
+    while (mounts->stale_count > 0) {
+        FileNode* dir = mounts->stale[--mounts->stale_count];
+        char path[MAX_PATH];
+        if (dir->unloaded) {
+            fs_mount_load(fs, dir);
+        } else if (fs_mount_host_path(mounts, dir, path, sizeof(path))) {
+            fs_mount_sync(fs, dir, path);
+        }
+    }
+    fs_write_end(fs);
+#endif
+}
+
+// Splits path into its directory and last name, as fs_create_file does
+static FileNode* fs_mount_parent(FileSystem* fs, const char* path, char* name) {
+    size_t length = strlen(path);
+    while (length > 1 && path[length - 1] == '/') length--;
+    size_t start = length;
+    while (start > 0 && path[start - 1] != '/') start--;
+    if (length - start == 0 || length - start >= MAX_FILENAME || start >= MAX_PATH) return NULL;
+    memcpy(name, path + start, length - start);
+    name[length - start] = '\0';
+
+    char parent[MAX_PATH];
+    if (start == 0) {
+        strcpy(parent, ".");
+    } else {
+        memcpy(parent, path, start);
+        parent[start] = '\0';
+    }
+    return fs_get_file(fs, parent);
+}
+
+bool fs_mount(FileSystem* fs, const char* host, const char* path) {
+    FsHostEntry entry;
+    if (!fs_mount_stat(host, &entry) || !entry.is_directory) return false;
+    size_t host_length = strlen(host);
+    while (host_length > 1 && host[host_length - 1] == '/') host_length--;
+    if (host_length >= MAX_PATH) return false;
+
+    fs_write_begin(fs);
+    char name[MAX_FILENAME];
+    FileNode* parent = fs_mount_parent(fs, path, name);
+    FsMounts* mounts = fs->mounts;
+    if (!mounts) {
+        mounts = calloc(1, sizeof(FsMounts));
+        if (mounts) {
+            mounts->inotify = -1;
+#ifdef __linux__
+            mounts->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+            fs->mounts = mounts;
+        }
+    }
+    if (mounts && mounts->count == mounts->capacity) {
+        int capacity = mounts->capacity ? mounts->capacity * 2 : 4;
+        FsMount* list = realloc(mounts->list, capacity * sizeof(FsMount));
+        if (list) {
+            mounts->list = list;
+            mounts->capacity = capacity;
+        }
+    }
+    char* copy = malloc(host_length + 1);
+    FileNode* root = NULL;
+    if (parent && parent->is_directory && !parent->host && mounts && mounts->count < mounts->capacity && copy) {
+        root = fs_make_child(fs, parent, name, true);
+    }
+    if (!root) {
+        fs_write_end(fs);
+        free(copy);
+        return false;
+    }
+    memcpy(copy, host, host_length);
+    copy[host_length] = '\0';
+    mounts->list[mounts->count++] = (FsMount){root, copy};
+    root->modified = entry.modified;
+    root->unloaded = true;
+    SDL_MemoryBarrierRelease();
+    root->host = true;
+    fs_write_end(fs);
+    return true;
+}
+
+bool fs_unmount(FileSystem* fs, const char* path) {
+    fs_write_begin(fs);
+    FileNode* node = fs_get_file(fs, path);
+    bool found = node && fs->mounts && fs_mount_find(fs->mounts, node);
+    if (found) fs_mount_remove(fs, node);
+    fs_write_end(fs);
+    return found;
+}
+
+void fs_mount_forget(FileSystem* fs, FileNode* node) {
+    FsMounts* mounts = fs->mounts;
+    if (!mounts || !node->is_directory) return;
+    for (int i = 0; i < mounts->watch_count; i++) {
+        if (mounts->watches[i].dir != node) continue;
+        int wd = mounts->watches[i].wd;
+        mounts->watches[i--] = mounts->watches[--mounts->watch_count];
+        bool shared = false;
+        for (int k = 0; k < mounts->watch_count; k++) {
+            shared = shared || mounts->watches[k].wd == wd;
+        }
+#ifdef __linux__
+        if (!shared) inotify_rm_watch(mounts->inotify, wd);
+#endif
+    }
+    for (int i = 0; i < mounts->stale_count; i++) {
+        if (mounts->stale[i] == node) mounts->stale[i--] = mounts->stale[--mounts->stale_count];
+    }
+    FsMount* mount = fs_mount_find(mounts, node);
+    if (mount) {
+        free(mount->host);
+        *mount = mounts->list[--mounts->count];
+    }
+}
+
+void fs_mount_release(FileSystem* fs) {
+    FsMounts* mounts = fs->mounts;
+    if (!mounts) return;
+#ifndef _WIN32
+    if (mounts->inotify >= 0) close(mounts->inotify);
+#endif
+    for (int i = 0; i < mounts->count; i++) {
+        free(mounts->list[i].host);
+    }
+    free(mounts->list);
+    free(mounts->watches);
+    free(mounts->stale);
+    free(mounts);
+    fs->mounts = NULL;
+}
+
+// Terminal builtins
+
+static int fs_mount_cmd_mount(CommandContext* ctx, int argc, char** argv) {
+    if (argc == 1) {
+        // The table only changes under the writer lock, which printing must
+        // not hold: a job's output may wait for the main loop
+        fs_write_begin(ctx->fs);
+        FsMounts* mounts = ctx->fs->mounts;
+        int count = mounts ? mounts->count : 0;
+        char (*lines)[2 * MAX_PATH] = count ? malloc(count * sizeof(*lines)) : NULL;
+        for (int i = 0; lines && i < count; i++) {
+            char path[MAX_PATH];
+            if (!fs_node_path(mounts->list[i].root, path, sizeof(path))) path[0] = '\0';
+            snprintf(lines[i], sizeof(*lines), "%s on %s", mounts->list[i].host, path);
+        }
+        fs_write_end(ctx->fs);
+        if (count == 0) command_print(ctx, "No mounts");
+        for (int i = 0; lines && i < count; i++) {
+            if (!command_print(ctx, lines[i])) break;
+        }
+        free(lines);
+        return 0;
+    }
+    if (argc != 3) {
+        command_print(ctx, "Usage: mount <hostdir> <path>");
+        return 1;
+    }
+    if (!fs_mount(ctx->fs, argv[1], argv[2])) {
+        command_printf(ctx, "Error: Cannot mount %s on %s", argv[1], argv[2]);
+        return 1;
+    }
+    return 0;
+}
+
+static int fs_mount_cmd_umount(CommandContext* ctx, int argc, char** argv) {
+    if (argc != 2) {
+        command_print(ctx, "Usage: umount <path>");
+        return 1;
+    }
+    if (!fs_unmount(ctx->fs, argv[1])) {
+        command_printf(ctx, "Error: %s: Not a mount", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+void fs_mount_register_commands(void) {
+    command_register("mount", "mount [<hostdir> <path>]", "Show a host directory in the filesystem, or list mounts",
+                     fs_mount_cmd_mount);
+    command_register("umount", "umount <path>", "Remove a mounted host directory", fs_mount_cmd_umount);
+}
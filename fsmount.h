@@ -0,0 +1,67 @@
+#ifndef MICROOS_FSMOUNT_H
+#define MICROOS_FSMOUNT_H
+
+#include "filesystem.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FS_MEDIA_DIR "external"         // Host directory shown as /USB_Drive when present at boot
+#define FS_MEDIA_PATH "/USB_Drive"
+
+// A host directory shown in the tree
+typedef struct {
+    FileNode* root;
+    char* host;             // Host path of root, without a trailing slash
+} FsMount;
+
+// One inotify watch on a loaded host directory. The kernel hands out one
+// descriptor per host directory, so a directory seen through two mounts has
+// two entries with the same wd.
+typedef struct {
+    int wd;
+    FileNode* dir;
+} FsMountWatch;
+
+// Host nodes are read-only and never journaled, snapshotted or saved in the
+// image. A directory lists its host entries the first time a path lookup
+// reaches it, and a file reads its body the first time it is read; until
+// then they are marked FileNode::unloaded. Walks over fs_each_child see only
+// what has been loaded. On Linux, each loaded directory is watched through
+// inotify and fs_mount_poll brings it up to date; elsewhere a mount shows
+// the host as it was when each part was loaded.
+typedef struct FsMounts {
+    FsMount* list;
+    int count;
+    int capacity;
+    int inotify;            // -1 without change notifications
+    FsMountWatch* watches;
+    int watch_count;
+    int watch_capacity;
+    FileNode** stale;       // Directories to list again at the end of a poll
+    int stale_count;
+    int stale_capacity;
+} FsMounts;
+
+// Shows the host directory host at path, which must not exist yet and must
+// not lie inside another mount. Returns false if it cannot.
+bool fs_mount(FileSystem* fs, const char* host, const char* path);
+// Removes the mount whose root is at path and everything loaded below it.
+bool fs_unmount(FileSystem* fs, const char* path);
+
+// Lists an unloaded directory or reads an unloaded file from the host. Called
+// by the filesystem, with or without the writer lock, on the first lookup or
+// read that needs it.
+void fs_mount_load(FileSystem* fs, FileNode* node);
+
+// Applies the host changes inotify reported since the last poll. Call from
+// the main loop.
+void fs_mount_poll(FileSystem* fs);
+
+// Called by fs_free_node for a host node, and by fs_destroy.
+void fs_mount_forget(FileSystem* fs, FileNode* node);
+void fs_mount_release(FileSystem* fs);
+
+// Registers the mount and umount builtins.
+void fs_mount_register_commands(void);
+
+#endif // MICROOS_FSMOUNT_H
@@ -0,0 +1,294 @@
+#include "fssnapshot.h"
+#include "fsjournal.h"
+#include "fstext.h"
+#include "command.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool fs_snapshot_active(const FileSystem* fs) {
+    return fs->snapshots && fs->snapshots->count > 0;
+}
+
+static FsUndo* fs_snapshot_push(FsSnapshots* snaps, FsUndoOp op, FileNode* node) {
+    if (snaps->undo_count == snaps->undo_capacity) {
+        size_t capacity = snaps->undo_capacity ? snaps->undo_capacity * 2 : 256;
+        FsUndo* undo = realloc(snaps->undo, capacity * sizeof(FsUndo));
+        if (!undo) return NULL;
+        snaps->undo = undo;
+        snaps->undo_capacity = capacity;
+    }
+    FsUndo* undo = &snaps->undo[snaps->undo_count++];
+    memset(undo, 0, sizeof(FsUndo));
+    undo->op = op;
+    undo->node = node;
+    return undo;
+}
+
+static int fs_snapshot_find(const FsSnapshots* snaps, const char* name) {
+    if (!snaps) return -1;
+    for (int i = 0; i < snaps->count; i++) {
+        if (strcmp(snaps->list[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+void fs_snapshot_created(FileSystem* fs, FileNode* node) {
+    if (!fs_snapshot_active(fs)) return;
+    node->epoch = fs->snapshots->epoch;  // Nothing to preserve: rollback removes it
+    fs_snapshot_push(fs->snapshots, FS_UNDO_CREATE, node);
+}
+
+void fs_snapshot_preserve(FileSystem* fs, FileNode* node) {
+    if (!fs_snapshot_active(fs) || node->epoch == fs->snapshots->epoch) return;
+    FsUndo* undo = fs_snapshot_push(fs->snapshots, FS_UNDO_CONTENT, node);
+    if (!undo) return;
+    undo->content = node->content;
+    undo->blob = node->blob;
+    undo->size = node->size;
+    undo->modified = node->modified;
+    // The record shares the body; it is never changed while shared
+    if (node->blob) fs_store_retain(fs->store, node->blob);
+    node->epoch = fs->snapshots->epoch;
+}
+
+void fs_snapshot_renamed(FileSystem* fs, FileNode* node) {
+    if (!fs_snapshot_active(fs)) return;
+    FsUndo* undo = fs_snapshot_push(fs->snapshots, FS_UNDO_RENAME, node);
+    if (!undo) return;
+    undo->parent = node->parent;
+    undo->name = strdup(node->name);
+}
+
+bool fs_snapshot_deleted(FileSystem* fs, FileNode* node, FileNode* parent) {
+    if (!fs_snapshot_active(fs)) return false;
+    FsUndo* undo = fs_snapshot_push(fs->snapshots, FS_UNDO_DELETE, node);
+    if (!undo) return false;
+    undo->parent = parent;
+    return true;
+}
+
+// Journals a rollback step as the forward change it amounts to
+static void fs_snapshot_log(FileSystem* fs, FsJournalOp op, const FileNode* node, const char* data, size_t length) {
+    char path[MAX_PATH];
+    if (length && !data) return;  // A compressed body that could not be decoded
+    if (fs->journal && fs_node_path(node, path, sizeof(path))) {
+        fs_journal_record(fs, op, path, node->is_directory, data, length);
+    }
+}
+
+// Visits each node of a subtree put back by a rollback
+static bool fs_snapshot_restored(FileNode* node, void* user) {
+    FileSystem* fs = user;
+    node->image_offset = 0;  // The image may have been rewritten since the delete
+    fs_text_track(fs, node);  // The index may have been built since
+    fs_snapshot_log(fs, FS_JOURNAL_CREATE, node, NULL, 0);
+    if (!node->is_directory && node->size) {
+        fs_snapshot_log(fs, FS_JOURNAL_WRITE, node, fs_file_content(fs, node), node->size);
+    }
+    fs_each_child(node, "", 0, fs_snapshot_restored, fs);
+    return true;
+}
+
+static void fs_snapshot_undo(FileSystem* fs, FsUndo* undo) {
+    FileNode* node = undo->node;
+    switch (undo->op) {
+    case FS_UNDO_CREATE:
+        // Anything created inside it was undone first, so it is empty
+        fs_snapshot_log(fs, FS_JOURNAL_DELETE, node, NULL, 0);
+        if (fs->current_dir == node) fs->current_dir = node->parent;
+        fs_unlink(fs, node);
+        fs_free_node(fs, node);
+        break;
+    case FS_UNDO_CONTENT:
+        node->modified = undo->modified;
+        if (node->is_directory) break;  // Its size is the subtree's, restored by the other records
+        fs_set_content(fs, node, undo->content, undo->blob, undo->size);
+        node->image_offset = 0;
+        fs_snapshot_log(fs, FS_JOURNAL_WRITE, node, fs_file_content(fs, node), node->size);
+        break;
+    case FS_UNDO_DELETE:
+        fs_link(fs, undo->parent, node, NULL);
+        fs_snapshot_restored(node, fs);
+        break;
+    case FS_UNDO_RENAME: {
+        char from[MAX_PATH];
+        bool logged = fs->journal && fs_node_path(node, from, sizeof(from));
+        fs_unlink(fs, node);
+        fs_link(fs, undo->parent, node, undo->name);
+        free(undo->name);
+        char to[MAX_PATH];
+        if (logged && fs_node_path(node, to, sizeof(to))) {
+            fs_journal_record(fs, FS_JOURNAL_RENAME, from, node->is_directory, to, strlen(to));
+        }
+        break;
+    }
+    }
+}
+
+// Frees records no snapshot can roll back to any more
+static void fs_snapshot_forget(FileSystem* fs, FsSnapshots* snaps) {
+    for (size_t i = 0; i < snaps->undo_count; i++) {
+        FsUndo* undo = &snaps->undo[i];
+        switch (undo->op) {
+        case FS_UNDO_CREATE:
+            break;
+        case FS_UNDO_CONTENT:
+            if (undo->blob) fs_store_release(fs->store, undo->blob);
+            break;
+        case FS_UNDO_DELETE:
+            fs_free_node(fs, undo->node);
+            break;
+        case FS_UNDO_RENAME:
+            free(undo->name);
+            break;
+        }
+    }
+    snaps->undo_count = 0;
+}
+
+static bool fs_snapshot_take_locked(FileSystem* fs, const char* name) {
+    if (!fs->snapshots) {
+        fs->snapshots = calloc(1, sizeof(FsSnapshots));
+        if (!fs->snapshots) return false;
+    }
+    FsSnapshots* snaps = fs->snapshots;
+    if (snaps->count == FS_SNAPSHOT_MAX) return false;
+    if (name && (!*name || strlen(name) >= FS_SNAPSHOT_NAME || fs_snapshot_find(snaps, name) >= 0)) {
+        return false;
+    }
+
+    FsSnapshot* snap = &snaps->list[snaps->count];
+    if (name) {
+        snprintf(snap->name, sizeof(snap->name), "%s", name);
+    } else {
+        do {
+            snprintf(snap->name, sizeof(snap->name), "snap%d", ++snaps->next_id);
+        } while (fs_snapshot_find(snaps, snap->name) >= 0);
+    }
+    snap->created = time(NULL);
+    snap->mark = snaps->undo_count;
+    snaps->count++;
+    snaps->epoch++;  // Every node's current state now belongs to the snapshot
+    return true;
+}
+
+bool fs_snapshot_take(FileSystem* fs, const char* name) {
+    fs_write_begin(fs);
+    bool taken = fs_snapshot_take_locked(fs, name);
+    fs_write_end(fs);
+    return taken;
+}
+
+static long fs_snapshot_rollback_locked(FileSystem* fs, const char* name) {
+    FsSnapshots* snaps = fs->snapshots;
+    int index = name ? fs_snapshot_find(snaps, name) : (snaps ? snaps->count - 1 : -1);
+    if (index < 0) return -1;
+
+    size_t mark = snaps->list[index].mark;
+    long undone = (long)(snaps->undo_count - mark);
+    while (snaps->undo_count > mark) {
+        fs_snapshot_undo(fs, &snaps->undo[--snaps->undo_count]);
+    }
+    snaps->count = index + 1;  // Later snapshots describe states that are gone
+    snaps->epoch++;            // Changes from here on are preserved afresh
+    if (undone) fs->dirty = true;
+    return undone;
+}
+
+long fs_snapshot_rollback(FileSystem* fs, const char* name) {
+    fs_write_begin(fs);
+    long undone = fs_snapshot_rollback_locked(fs, name);
+    fs_write_end(fs);
+    return undone;
+}
+
+static bool fs_snapshot_drop_locked(FileSystem* fs, const char* name) {
+    FsSnapshots* snaps = fs->snapshots;
+    int index = fs_snapshot_find(snaps, name);
+    if (index < 0) return false;
+
+    // Its records now belong to the snapshot before it, which still needs them
+    memmove(&snaps->list[index], &snaps->list[index + 1], (snaps->count - index - 1) * sizeof(FsSnapshot));
+    snaps->count--;
+    if (snaps->count == 0) fs_snapshot_forget(fs, snaps);
+    return true;
+}
+
+bool fs_snapshot_drop(FileSystem* fs, const char* name) {
+    fs_write_begin(fs);
+    bool dropped = fs_snapshot_drop_locked(fs, name);
+    fs_write_end(fs);
+    return dropped;
+}
+
+void fs_snapshot_release(FileSystem* fs) {
+    FsSnapshots* snaps = fs->snapshots;
+    if (!snaps) return;
+    fs_snapshot_forget(fs, snaps);
+    free(snaps->undo);
+    free(snaps);
+    fs->snapshots = NULL;
+}
+
+// Terminal builtins
+
+static int fs_snapshot_cmd_snapshot(CommandContext* ctx, int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+        if (argc != 3) {
+            command_print(ctx, "Usage: snapshot -d <name>");
+            return 1;
+        }
+        if (!fs_snapshot_drop(ctx->fs, argv[2])) {
+            command_printf(ctx, "Error: %s: No such snapshot", argv[2]);
+            return 1;
+        }
+        command_printf(ctx, "Snapshot %s dropped", argv[2]);
+        return 0;
+    }
+    if (!fs_snapshot_take(ctx->fs, argc > 1 ? argv[1] : NULL)) {
+        command_print(ctx, "Error: Could not take snapshot");
+        return 1;
+    }
+    FsSnapshots* snaps = ctx->fs->snapshots;
+    command_printf(ctx, "Snapshot %s taken", snaps->list[snaps->count - 1].name);
+    return 0;
+}
+
+static int fs_snapshot_cmd_snapshots(CommandContext* ctx, int argc, char** argv) {
+    FsSnapshots* snaps = ctx->fs->snapshots;
+    if (!snaps || snaps->count == 0) {
+        command_print(ctx, "No snapshots");
+        return 0;
+    }
+    for (int i = 0; i < snaps->count; i++) {
+        size_t end = i + 1 < snaps->count ? snaps->list[i + 1].mark : snaps->undo_count;
+        char created[FS_FORMAT_LENGTH];
+        if (!command_printf(ctx, "%-16s  %s  %zu changes since", snaps->list[i].name,
+                            fs_format_time(snaps->list[i].created, created, sizeof(created)),
+                            end - snaps->list[i].mark)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static int fs_snapshot_cmd_rollback(CommandContext* ctx, int argc, char** argv) {
+    if (!command_require_foreground(ctx, argv[0])) return 1;
+    long undone = fs_snapshot_rollback(ctx->fs, argc > 1 ? argv[1] : NULL);
+    if (undone < 0) {
+        command_print(ctx, argc > 1 ? "Error: No such snapshot" : "Error: No snapshots");
+        return 1;
+    }
+    FsSnapshots* snaps = ctx->fs->snapshots;
+    command_printf(ctx, "Rolled back to %s (%ld changes undone)", snaps->list[snaps->count - 1].name, undone);
+    return 0;
+}
+
+void fs_snapshot_register_commands(void) {
+    command_register("snapshot", "snapshot [name] | -d <name>", "Take or drop a filesystem snapshot",
+                     fs_snapshot_cmd_snapshot);
+    command_register("snapshots", "snapshots", "List filesystem snapshots", fs_snapshot_cmd_snapshots);
+    command_register("rollback", "rollback [name]", "Undo filesystem changes since a snapshot",
+                     fs_snapshot_cmd_rollback);
+}
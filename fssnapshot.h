@@ -0,0 +1,81 @@
+#ifndef MICROOS_FSSNAPSHOT_H
+#define MICROOS_FSSNAPSHOT_H
+
+#include "filesystem.h"
+#include "fsstore.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define FS_SNAPSHOT_MAX 32      // Snapshots kept at once
+#define FS_SNAPSHOT_NAME 32     // Longest snapshot name, terminator included
+#define FS_SNAPSHOT_BOOT "boot" // Snapshot a simulated reboot rolls back to
+
+typedef enum {
+    FS_UNDO_CREATE,         // Node was added
+    FS_UNDO_CONTENT,        // Node's body or times were about to change
+    FS_UNDO_DELETE,         // Node was removed; the record keeps its subtree
+    FS_UNDO_RENAME          // Node was about to move or be renamed
+} FsUndoOp;
+
+// What rolling back one change needs
+typedef struct {
+    FsUndoOp op;
+    FileNode* node;
+    FileNode* parent;       // DELETE and RENAME: the directory node was in
+    char* name;             // RENAME: the old name
+    char* content;          // CONTENT: the old body, if borrowed
+    FsBlob* blob;           // CONTENT: the old body, if stored; the record holds a reference
+    size_t size;
+    time_t modified;
+} FsUndo;
+
+typedef struct {
+    char name[FS_SNAPSHOT_NAME];
+    time_t created;
+    size_t mark;            // Undo records from here on postdate the snapshot
+} FsSnapshot;
+
+// Snapshots share every node and body with the live tree. The first change to
+// a node after a snapshot saves its old state in an undo record (the body by
+// reference: stored bodies are never changed while shared), so taking a
+// snapshot is O(1) and rolling back costs O(changes since).
+typedef struct FsSnapshots {
+    FsSnapshot list[FS_SNAPSHOT_MAX];   // Oldest first
+    int count;
+    FsUndo* undo;
+    size_t undo_count;
+    size_t undo_capacity;
+    unsigned epoch;         // Bumped per snapshot; see FileNode::epoch
+    int next_id;            // For default names
+} FsSnapshots;
+
+// Takes a snapshot named name, or "snapN" if name is NULL. Returns false if
+// the name is taken or too long, or FS_SNAPSHOT_MAX snapshots exist.
+bool fs_snapshot_take(FileSystem* fs, const char* name);
+
+// Undoes every change made since the named snapshot (the latest if name is
+// NULL) and drops the snapshots taken after it. The snapshot itself stays, so
+// the same state can be restored again and again. Returns the number of
+// changes undone, or -1 if there is no such snapshot.
+long fs_snapshot_rollback(FileSystem* fs, const char* name);
+
+// Forgets a snapshot. Undo records are freed once no snapshot is left.
+bool fs_snapshot_drop(FileSystem* fs, const char* name);
+
+// Called by the filesystem around each change. They do nothing while no
+// snapshot exists.
+void fs_snapshot_created(FileSystem* fs, FileNode* node);
+void fs_snapshot_preserve(FileSystem* fs, FileNode* node);  // Before a body or time change
+void fs_snapshot_renamed(FileSystem* fs, FileNode* node);   // Before a rename
+// After node has been unlinked from parent. Returns true if a snapshot took
+// the subtree, which the caller must then not free.
+bool fs_snapshot_deleted(FileSystem* fs, FileNode* node, FileNode* parent);
+
+// Drops every snapshot and undo record. Called by fs_destroy.
+void fs_snapshot_release(FileSystem* fs);
+
+// Registers the snapshot, snapshots and rollback builtins.
+void fs_snapshot_register_commands(void);
+
+#endif // MICROOS_FSSNAPSHOT_H
@@ -0,0 +1,752 @@
+#include "fsstore.h"
+#include "filesystem.h"
+#include "fsepoch.h"
+#include "command.h"
+#include "fslz.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FS_STORE_FNV_BASIS 14695981039346656037ull
+#define FS_STORE_FNV_PRIME 1099511628211ull
+
+// FNV-1a, resumable: pass the previous result to hash more bytes of the same chunk
+static uint64_t fs_store_hash_bytes(uint64_t hash, const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * FS_STORE_FNV_PRIME;
+    }
+    return hash;
+}
+
+// Scrambles a chunk hash with its position, so a body's hash can be kept as
+// a plain sum and updated per chunk
+static uint64_t fs_store_mix(uint64_t hash, size_t index) {
+    uint64_t x = hash + (index + 1) * 0x9E3779B97F4A7C15ull;  // splitmix64 finalizer
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+FsStore* fs_store_create(FsEpoch* epoch) {
+    FsStore* store = calloc(1, sizeof(FsStore));
+    if (!store) return NULL;
+    store->epoch = epoch;
+    store->bucket_count = 256;
+    store->buckets = calloc(store->bucket_count, sizeof(FsBlob*));
+    store->chunk_bucket_count = 256;
+    store->chunk_buckets = calloc(store->chunk_bucket_count, sizeof(FsChunk*));
+    if (!store->buckets || !store->chunk_buckets) {
+        free(store->buckets);
+        free(store->chunk_buckets);
+        free(store);
+        return NULL;
+    }
+    store->cold_seconds = FS_STORE_COLD_SECONDS;
+    store->packer_lock = SDL_CreateMutex();
+    store->packer_wake = SDL_CreateCond();
+    return store;
+}
+
+// The view of an empty body
+static char fs_store_empty[1];
+
+static void fs_store_free_chunk(FsChunk* chunk) {
+    free(chunk->data);
+    free(chunk->packed);
+    free(chunk);
+}
+
+static void fs_store_free_blob(FsBlob* blob) {
+    if (blob->capacity) free(blob->data);
+    free(blob->chunks);
+    free(blob);
+}
+
+static void fs_store_release_chunk(void* memory, void* user) {
+    fs_store_free_chunk(memory);
+}
+
+static void fs_store_release_blob(void* memory, void* user) {
+    fs_store_free_blob(memory);
+}
+
+void fs_store_destroy(FsStore* store) {
+    if (!store) return;
+    if (store->packer) {
+        SDL_LockMutex(store->packer_lock);
+        store->packer_stopping = true;
+        SDL_CondSignal(store->packer_wake);
+        SDL_UnlockMutex(store->packer_lock);
+        SDL_WaitThread(store->packer, NULL);
+    }
+    SDL_DestroyCond(store->packer_wake);
+    SDL_DestroyMutex(store->packer_lock);
+    for (size_t i = 0; i < store->bucket_count; i++) {
+        FsBlob* blob = store->buckets[i];
+        while (blob) {
+            FsBlob* next = blob->next;
+            fs_store_free_blob(blob);
+            blob = next;
+        }
+    }
+    for (size_t i = 0; i < store->chunk_bucket_count; i++) {
+        FsChunk* chunk = store->chunk_buckets[i];
+        while (chunk) {
+            FsChunk* next = chunk->next;
+            fs_store_free_chunk(chunk);
+            chunk = next;
+        }
+    }
+    free(store->buckets);
+    free(store->chunk_buckets);
+    free(store);
+}
+
+static void fs_store_grow(FsStore* store) {
+    size_t count = store->bucket_count * 2;
+    FsBlob** buckets = calloc(count, sizeof(FsBlob*));
+    if (!buckets) return;  // Longer chains, still correct
+    for (size_t i = 0; i < store->bucket_count; i++) {
+        FsBlob* blob = store->buckets[i];
+        while (blob) {
+            FsBlob* next = blob->next;
+            blob->next = buckets[blob->hash & (count - 1)];
+            buckets[blob->hash & (count - 1)] = blob;
+            blob = next;
+        }
+    }
+    free(store->buckets);
+    store->buckets = buckets;
+    store->bucket_count = count;
+}
+
+static void fs_store_grow_chunks(FsStore* store) {
+    size_t count = store->chunk_bucket_count * 2;
+    FsChunk** buckets = calloc(count, sizeof(FsChunk*));
+    if (!buckets) return;
+    for (size_t i = 0; i < store->chunk_bucket_count; i++) {
+        FsChunk* chunk = store->chunk_buckets[i];
+        while (chunk) {
+            FsChunk* next = chunk->next;
+            chunk->next = buckets[chunk->hash & (count - 1)];
+            buckets[chunk->hash & (count - 1)] = chunk;
+            chunk = next;
+        }
+    }
+    free(store->chunk_buckets);
+    store->chunk_buckets = buckets;
+    store->chunk_bucket_count = count;
+}
+
+static void fs_store_link(FsStore* store, FsBlob* blob) {
+    if (store->blob_count >= store->bucket_count) fs_store_grow(store);
+    FsBlob** bucket = &store->buckets[blob->hash & (store->bucket_count - 1)];
+    blob->next = *bucket;
+    *bucket = blob;
+    store->blob_count++;
+}
+
+static void fs_store_unlink(FsStore* store, FsBlob* blob) {
+    FsBlob** link = &store->buckets[blob->hash & (store->bucket_count - 1)];
+    while (*link != blob) link = &(*link)->next;
+    *link = blob->next;
+    store->blob_count--;
+}
+
+static void fs_store_link_chunk(FsStore* store, FsChunk* chunk) {
+    if (store->chunk_count >= store->chunk_bucket_count) fs_store_grow_chunks(store);
+    FsChunk** bucket = &store->chunk_buckets[chunk->hash & (store->chunk_bucket_count - 1)];
+    chunk->next = *bucket;
+    *bucket = chunk;
+    store->chunk_count++;
+    store->stored_bytes += chunk->size;
+}
+
+static void fs_store_unlink_chunk(FsStore* store, FsChunk* chunk) {
+    FsChunk** link = &store->chunk_buckets[chunk->hash & (store->chunk_bucket_count - 1)];
+    while (*link != chunk) link = &(*link)->next;
+    *link = chunk->next;
+    store->chunk_count--;
+    store->stored_bytes -= chunk->size;
+}
+
+// The chunk's bytes: its own if kept plain, else decoded into buffer, which
+// must hold chunk->size bytes
+static const char* fs_store_chunk_bytes(const FsChunk* chunk, char* buffer) {
+    if (chunk->data) return chunk->data;
+    if (!fs_lz_decompress(chunk->packed, chunk->packed_size, buffer, chunk->size)) {
+        fprintf(stderr, "Corrupt compressed chunk (%zu bytes)\n", chunk->size);
+        memset(buffer, 0, chunk->size);
+    }
+    return buffer;
+}
+
+// Hashes only pick candidates; equal bytes decide
+static FsChunk* fs_store_find_chunk(FsStore* store, uint64_t hash, const char* data, size_t size) {
+    char buffer[FS_STORE_CHUNK];
+    for (FsChunk* chunk = store->chunk_buckets[hash & (store->chunk_bucket_count - 1)]; chunk; chunk = chunk->next) {
+        if (chunk->hash == hash && chunk->size == size &&
+            memcmp(fs_store_chunk_bytes(chunk, buffer), data, size) == 0) {
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+// Returns the stored chunk equal to data, with a reference added, storing it
+// first if needed. Returns NULL if out of memory.
+static FsChunk* fs_store_intern(FsStore* store, const char* data, size_t size, uint64_t hash) {
+    FsChunk* chunk = fs_store_find_chunk(store, hash, data, size);
+    if (!chunk) {
+        chunk = calloc(1, sizeof(FsChunk));
+        char* copy = malloc(size + 1);
+        if (!chunk || !copy) {
+            free(chunk);
+            free(copy);
+            return NULL;
+        }
+        memcpy(copy, data, size);
+        copy[size] = '\0';
+        chunk->hash = hash;
+        chunk->size = size;
+        chunk->data = copy;
+        chunk->capacity = size + 1;
+        fs_store_link_chunk(store, chunk);
+    }
+    chunk->refs++;
+    chunk->last_used = time(NULL);
+    return chunk;
+}
+
+static void fs_store_unref_chunk(FsStore* store, FsChunk* chunk) {
+    if (--chunk->refs > 0) return;
+    fs_store_unlink_chunk(store, chunk);
+    if (chunk->packed) {
+        store->packed_count--;
+        store->packed_bytes -= chunk->packed_size;
+        store->packed_plain_bytes -= chunk->size;
+    }
+    fs_epoch_retire(store->epoch, fs_store_release_chunk, chunk, NULL);  // Readers may be in its bytes
+}
+
+// Takes a body's view away; readers that loaded it keep it till they leave
+static void fs_store_drop_view(FsStore* store, FsBlob* blob) {
+    if (!blob->data) return;
+    if (blob->capacity) {
+        for (int i = 0; i < FS_STORE_CACHE_SLOTS; i++) {
+            if (store->cache[i] == blob) store->cache[i] = NULL;
+        }
+        store->cache_bytes -= blob->capacity;
+        fs_epoch_retire(store->epoch, NULL, blob->data, NULL);
+    } else if (blob->chunk_count > 0) {
+        blob->chunks[0]->views--;
+    }
+    SDL_AtomicSetPtr((void**)&blob->data, NULL);
+    blob->capacity = 0;
+}
+
+// Makes room for a copied view by dropping the least recently read ones
+static void fs_store_cache_add(FsStore* store, FsBlob* blob) {
+    for (;;) {
+        int empty = -1;
+        int oldest = -1;
+        for (int i = 0; i < FS_STORE_CACHE_SLOTS; i++) {
+            if (!store->cache[i]) {
+                if (empty < 0) empty = i;
+            } else if (oldest < 0 || store->cache[i]->last_used < store->cache[oldest]->last_used) {
+                oldest = i;
+            }
+        }
+        if (empty >= 0 && (oldest < 0 || store->cache_bytes + blob->capacity <= FS_STORE_CACHE_BYTES)) {
+            store->cache[empty] = blob;
+            store->cache_bytes += blob->capacity;
+            return;
+        }
+        fs_store_drop_view(store, store->cache[oldest]);
+    }
+}
+
+// Makes sure blob->data holds the body: the only chunk's own bytes if it
+// keeps them plain, else a copy assembled from the chunks
+static bool fs_store_view(FsStore* store, FsBlob* blob) {
+    time_t now = time(NULL);
+    blob->last_used = now;
+    if (blob->data) return true;
+    if (blob->chunk_count == 0) {
+        SDL_AtomicSetPtr((void**)&blob->data, fs_store_empty);
+        return true;
+    }
+    // A freed body is only read by stragglers, and lends them no chunk
+    FsChunk* first = blob->chunks[0];
+    if (blob->chunk_count == 1 && first->data && blob->refs > 0) {
+        first->views++;
+        first->last_used = now;
+        SDL_AtomicSetPtr((void**)&blob->data, first->data);
+        return true;
+    }
+
+    char* data = malloc(blob->size + 1);
+    if (!data) return false;
+    for (size_t i = 0; i < blob->chunk_count; i++) {
+        FsChunk* chunk = blob->chunks[i];
+        char* at = data + i * FS_STORE_CHUNK;
+        if (chunk->data) {
+            memcpy(at, chunk->data, chunk->size);
+        } else {
+            fs_store_chunk_bytes(chunk, at);
+        }
+    }
+    data[blob->size] = '\0';
+    blob->capacity = blob->size + 1;
+    // A freed body's copy goes with the body
+    if (blob->refs > 0) fs_store_cache_add(store, blob);
+    SDL_AtomicSetPtr((void**)&blob->data, data);
+    return true;
+}
+
+// Bodies with the same bytes hold the same chunks
+static FsBlob* fs_store_find(FsStore* store, uint64_t hash, FsChunk** chunks, size_t count, size_t size) {
+    for (FsBlob* blob = store->buckets[hash & (store->bucket_count - 1)]; blob; blob = blob->next) {
+        if (blob->hash == hash && blob->size == size && blob->chunk_count == count &&
+            (count == 0 || memcmp(blob->chunks, chunks, count * sizeof(FsChunk*)) == 0)) {
+            return blob;
+        }
+    }
+    return NULL;
+}
+
+FsBlob* fs_store_put(FsStore* store, const char* data, size_t size, FsBlob* previous) {
+    size_t count = (size + FS_STORE_CHUNK - 1) / FS_STORE_CHUNK;
+    FsChunk** chunks = NULL;
+    if (count) {
+        chunks = malloc(count * sizeof(FsChunk*));
+        if (!chunks) return NULL;
+    }
+
+    SDL_AtomicLock(&store->lock);
+    uint64_t hash = 0;
+    size_t made = 0;
+    for (; made < count; made++) {
+        size_t offset = made * FS_STORE_CHUNK;
+        size_t length = size - offset < FS_STORE_CHUNK ? size - offset : FS_STORE_CHUNK;
+        FsChunk* chunk = previous && made < previous->chunk_count ? previous->chunks[made] : NULL;
+        // Comparing is much cheaper than hashing, so unchanged chunks are kept as they are
+        if (chunk && chunk->data && chunk->size == length && memcmp(chunk->data, data + offset, length) == 0) {
+            chunk->refs++;
+        } else {
+            chunk = fs_store_intern(store, data + offset, length,
+                                    fs_store_hash_bytes(FS_STORE_FNV_BASIS, data + offset, length));
+            if (!chunk) break;
+        }
+        chunks[made] = chunk;
+        hash += fs_store_mix(chunk->hash, made);
+    }
+
+    FsBlob* blob = made == count ? fs_store_find(store, hash, chunks, count, size) : NULL;
+    if (!blob && made == count) {
+        blob = calloc(1, sizeof(FsBlob));
+        if (blob) {
+            blob->hash = hash;
+            blob->size = size;
+            blob->chunks = chunks;
+            blob->chunk_count = blob->chunk_capacity = count;
+            blob->last_used = time(NULL);
+            fs_store_link(store, blob);
+            chunks = NULL;  // Now the body's
+        }
+    }
+    for (size_t i = 0; chunks && i < made; i++) {
+        fs_store_unref_chunk(store, chunks[i]);
+    }
+    if (blob) {
+        blob->refs++;
+        store->referenced_bytes += size;
+    }
+    SDL_AtomicUnlock(&store->lock);
+    free(chunks);
+    return blob;
+}
+
+FsBlob* fs_store_write(FsStore* store, FsBlob* blob, size_t offset, const char* data, size_t length) {
+    if (length == 0 || offset > blob->size) return length == 0 ? blob : NULL;
+    size_t size = blob->size;
+    size_t end = offset + length;
+    size_t new_size = end > size ? end : size;
+    size_t old_count = blob->chunk_count;
+    size_t count = (new_size + FS_STORE_CHUNK - 1) / FS_STORE_CHUNK;
+    size_t first = offset / FS_STORE_CHUNK;
+    size_t last = (end - 1) / FS_STORE_CHUNK;
+    FsChunk** made = malloc((last - first + 1) * sizeof(FsChunk*));
+    if (!made) return NULL;
+
+    SDL_AtomicLock(&store->lock);
+    bool shared = blob->refs > 1;
+    FsBlob* target = blob;
+    FsChunk** chunks = blob->chunks;
+    if (shared) {
+        target = calloc(1, sizeof(FsBlob));
+        chunks = malloc(count * sizeof(FsChunk*));
+    } else if (count > blob->chunk_capacity) {
+        // Readers never walk the list, so it can move
+        chunks = realloc(blob->chunks, count * sizeof(FsChunk*));
+        if (chunks) {
+            blob->chunks = chunks;
+            blob->chunk_capacity = count;
+        }
+    }
+
+    // Whatever can fail comes first, so blob is left as it was. An append
+    // extends the chunk it starts in, if this body alone holds it, in place:
+    // readers only look up to the size they saw. Every other chunk the write
+    // touches is rebuilt and stored, and the one it replaces is kept intact.
+    FsChunk* tail = first < old_count ? blob->chunks[first] : NULL;
+    bool extend = !shared && offset == size && tail && tail->refs == 1 && tail->data;
+    char* extended = NULL;
+    size_t extend_capacity = 0;
+    size_t extend_size = 0;
+    size_t k = 0;
+    for (size_t i = first; target && chunks && i <= last; i++, k++) {
+        size_t start = i * FS_STORE_CHUNK;
+        size_t chunk_size = new_size - start < FS_STORE_CHUNK ? new_size - start : FS_STORE_CHUNK;
+        if (i == first && extend) {
+            extend_size = chunk_size;
+            if (chunk_size >= tail->capacity) {
+                extend_capacity = tail->capacity * 2 > chunk_size + 1 ? tail->capacity * 2 : chunk_size + 1;
+                if (extend_capacity > FS_STORE_CHUNK + 1) extend_capacity = FS_STORE_CHUNK + 1;
+                extended = malloc(extend_capacity);
+                if (!extended) break;
+            }
+            made[k] = tail;
+            continue;
+        }
+        char bytes[FS_STORE_CHUNK];
+        FsChunk* old = i < old_count ? blob->chunks[i] : NULL;
+        if (old) memmove(bytes, fs_store_chunk_bytes(old, bytes), old->size);
+        size_t from = offset > start ? offset : start;
+        size_t to = end < start + chunk_size ? end : start + chunk_size;
+        memcpy(bytes + (from - start), data + (from - offset), to - from);
+        made[k] = fs_store_intern(store, bytes, chunk_size,
+                                  fs_store_hash_bytes(FS_STORE_FNV_BASIS, bytes, chunk_size));
+        if (!made[k]) break;
+    }
+    if (!target || !chunks || k <= last - first) {
+        for (size_t j = extend ? 1 : 0; j < k; j++) fs_store_unref_chunk(store, made[j]);
+        free(extended);
+        if (shared) {
+            free(target);
+            free(chunks);
+        }
+        SDL_AtomicUnlock(&store->lock);
+        free(made);
+        return NULL;
+    }
+
+    // The chunk a borrowed view points into, followed below if it changes
+    FsChunk* viewed = !shared && blob->data && !blob->capacity && old_count == 1 ? blob->chunks[0] : NULL;
+    if (shared) {
+        for (size_t i = 0; i < old_count; i++) {
+            chunks[i] = blob->chunks[i];
+            if (i < first || i > last) chunks[i]->refs++;
+        }
+        target->refs = 1;
+        target->chunks = chunks;
+        target->chunk_capacity = count;
+        blob->refs--;  // The caller's reference moves to the copy
+    } else {
+        fs_store_unlink(store, blob);  // Its hash is about to change
+    }
+
+    uint64_t hash = blob->hash;
+    time_t now = time(NULL);
+    k = 0;
+    for (size_t i = first; i <= last; i++, k++) {
+        FsChunk* old = i < old_count ? blob->chunks[i] : NULL;
+        if (old) hash -= fs_store_mix(old->hash, i);
+        if (i == first && extend) {
+            fs_store_unlink_chunk(store, tail);  // So is this one's
+            size_t grow = extend_size - tail->size;
+            if (extended) {
+                memcpy(extended, tail->data, tail->size);
+                memcpy(extended + tail->size, data, grow);
+                extended[tail->size + grow] = '\0';
+                fs_epoch_retire(store->epoch, NULL, tail->data, NULL);
+                tail->data = extended;
+                tail->capacity = extend_capacity;
+            } else {
+                // Behind the terminator, which is overwritten last
+                memcpy(tail->data + tail->size + 1, data + 1, grow - 1);
+                tail->data[tail->size + grow] = '\0';
+                SDL_MemoryBarrierRelease();
+                tail->data[tail->size] = data[0];
+            }
+            tail->hash = fs_store_hash_bytes(tail->hash, data, grow);
+            tail->size += grow;
+            tail->last_used = now;
+            FsChunk* same = fs_store_find_chunk(store, tail->hash, tail->data, tail->size);
+            if (same) {
+                same->refs++;
+                made[k] = same;
+                tail->refs = 0;  // The packer reads it as a freed chunk
+                fs_epoch_retire(store->epoch, fs_store_release_chunk, tail, NULL);
+            } else {
+                fs_store_link_chunk(store, tail);
+            }
+        } else if (old && !shared) {
+            fs_store_unref_chunk(store, old);
+        }
+        chunks[i] = made[k];
+        hash += fs_store_mix(made[k]->hash, i);
+    }
+    target->chunk_count = count;
+
+    if (!shared && blob->data) {
+        if (blob->capacity) {
+            // A copy takes an append in place if it has room
+            if (offset == size && new_size < blob->capacity) {
+                memcpy(blob->data + size + 1, data + 1, length - 1);
+                blob->data[new_size] = '\0';
+                SDL_MemoryBarrierRelease();
+                blob->data[size] = data[0];
+            } else {
+                fs_store_drop_view(store, blob);
+            }
+        } else {
+            // A borrowed view follows the body's only chunk, or goes
+            FsChunk* only = count == 1 && chunks[0]->data ? chunks[0] : NULL;
+            char* view = only ? only->data : NULL;
+            if (only != viewed || view != blob->data) {
+                if (viewed) viewed->views--;
+                if (only) only->views++;
+                SDL_AtomicSetPtr((void**)&blob->data, view);
+            }
+        }
+    }
+    store->referenced_bytes += new_size - size;
+    SDL_MemoryBarrierRelease();  // A reader that sees the new size sees the bytes it covers
+    target->size = new_size;
+    target->hash = hash;
+    target->last_used = now;
+
+    FsBlob* same = fs_store_find(store, hash, chunks, count, new_size);
+    if (same) {
+        same->refs++;
+        fs_store_drop_view(store, target);
+        for (size_t i = 0; i < count; i++) fs_store_unref_chunk(store, chunks[i]);
+        if (shared) {
+            fs_store_free_blob(target);
+        } else {
+            target->refs = 0;  // Stragglers read it as a freed body
+            fs_epoch_retire(store->epoch, fs_store_release_blob, target, NULL);  // The file still points at it
+        }
+        target = same;
+    } else {
+        fs_store_link(store, target);
+    }
+    SDL_AtomicUnlock(&store->lock);
+    free(made);
+    return target;
+}
+
+FsBlob* fs_store_append(FsStore* store, FsBlob* blob, const char* data, size_t length) {
+    return fs_store_write(store, blob, blob->size, data, length);
+}
+
+void fs_store_retain(FsStore* store, FsBlob* blob) {
+    SDL_AtomicLock(&store->lock);
+    blob->refs++;
+    store->referenced_bytes += blob->size;
+    SDL_AtomicUnlock(&store->lock);
+}
+
+void fs_store_release(FsStore* store, FsBlob* blob) {
+    SDL_AtomicLock(&store->lock);
+    store->referenced_bytes -= blob->size;
+    if (--blob->refs == 0) {
+        fs_store_unlink(store, blob);
+        fs_store_drop_view(store, blob);
+        for (size_t i = 0; i < blob->chunk_count; i++) fs_store_unref_chunk(store, blob->chunks[i]);
+        fs_epoch_retire(store->epoch, fs_store_release_blob, blob, NULL);
+    }
+    SDL_AtomicUnlock(&store->lock);
+}
+
+const char* fs_store_data(FsStore* store, FsBlob* blob) {
+    // Views are read without the lock
+    const char* data = SDL_AtomicGetPtr((void**)&blob->data);
+    if (data) {
+        time_t now = time(NULL);
+        if (blob->last_used != now) blob->last_used = now;
+        return data;
+    }
+    SDL_AtomicLock(&store->lock);
+    data = fs_store_view(store, blob) ? blob->data : NULL;
+    SDL_AtomicUnlock(&store->lock);
+    return data;
+}
+
+// A cold chunk picked for compression, and what it compressed to
+typedef struct {
+    FsChunk* chunk;
+    const char* data;       // Its bytes when picked; retired, never freed, while the packer reads them
+    size_t size;
+    char* packed;           // NULL if it does not compress well enough
+    size_t packed_size;
+} FsStorePack;
+
+// Compresses a bounded batch of cold chunks. The lock is held only to pick
+// them and to swap each one's bytes for its compressed form; the packing
+// runs outside it, inside a read section that keeps the picked chunks and
+// their bytes alive however the bodies change meanwhile.
+static void fs_store_pack_batch(FsStore* store) {
+    FsStorePack batch[FS_STORE_PACK_BUDGET / FS_STORE_PACK_MIN];
+    size_t count = 0;
+    size_t budget = FS_STORE_PACK_BUDGET;
+    time_t now = time(NULL);
+    fs_epoch_enter(store->epoch);
+    SDL_AtomicLock(&store->lock);
+    for (int i = 0; i < FS_STORE_POLL_BUCKETS && budget >= FS_STORE_PACK_MIN; i++) {
+        store->poll_chunk_bucket = (store->poll_chunk_bucket + 1) & (store->chunk_bucket_count - 1);
+        for (FsChunk* chunk = store->chunk_buckets[store->poll_chunk_bucket]; chunk; chunk = chunk->next) {
+            // A chunk too big for what is left of the budget waits for a later batch
+            if (!chunk->data || chunk->views > 0 || chunk->size < FS_STORE_PACK_MIN || chunk->size > budget ||
+                now - chunk->last_used < store->cold_seconds) {
+                continue;
+            }
+            batch[count].chunk = chunk;
+            batch[count].data = chunk->data;
+            batch[count].size = chunk->size;
+            count++;
+            budget -= chunk->size;
+        }
+    }
+    SDL_AtomicUnlock(&store->lock);
+
+    // Appends only write past the size picked, so these bytes hold still
+    for (size_t i = 0; i < count; i++) {
+        FsStorePack* item = &batch[i];
+        item->packed = malloc(fs_lz_bound(item->size));
+        if (!item->packed) continue;
+        item->packed_size = fs_lz_compress(item->data, item->size, item->packed);
+        if (item->packed_size > item->size - item->size / 8) {
+            free(item->packed);
+            item->packed = NULL;
+            continue;
+        }
+        char* fitted = realloc(item->packed, item->packed_size);
+        if (fitted) item->packed = fitted;
+    }
+
+    SDL_AtomicLock(&store->lock);
+    for (size_t i = 0; i < count; i++) {
+        FsStorePack* item = &batch[i];
+        FsChunk* chunk = item->chunk;
+        // Skipped if it was freed, read, grown or packed meanwhile
+        bool same = chunk->refs > 0 && chunk->data == item->data && chunk->size == item->size &&
+                    chunk->views == 0 && !chunk->packed;
+        if (!same || !item->packed) {
+            // Incompressible: look again after another idle period
+            if (same) chunk->last_used = now;
+            free(item->packed);
+            continue;
+        }
+        chunk->packed = item->packed;
+        chunk->packed_size = item->packed_size;
+        // A reader may still be in a view dropped a moment ago
+        fs_epoch_retire(store->epoch, NULL, chunk->data, NULL);
+        chunk->data = NULL;
+        chunk->capacity = 0;
+        store->packed_count++;
+        store->packed_bytes += item->packed_size;
+        store->packed_plain_bytes += chunk->size;
+    }
+    SDL_AtomicUnlock(&store->lock);
+    fs_epoch_leave(store->epoch);
+}
+
+// Packer thread: sleeps until fs_store_poll asks for a batch. Requests made
+// while a batch runs fold into the next one.
+static int fs_store_packer(void* data) {
+    FsStore* store = data;
+    SDL_LockMutex(store->packer_lock);
+    while (!store->packer_stopping) {
+        if (!store->pack_wanted) {
+            SDL_CondWait(store->packer_wake, store->packer_lock);
+            continue;
+        }
+        store->pack_wanted = false;
+        SDL_UnlockMutex(store->packer_lock);
+        fs_store_pack_batch(store);
+        SDL_LockMutex(store->packer_lock);
+    }
+    SDL_UnlockMutex(store->packer_lock);
+    return 0;
+}
+
+void fs_store_poll(FsStore* store) {
+    if (store->cold_seconds <= 0) return;
+    time_t now = time(NULL);
+    SDL_AtomicLock(&store->lock);
+    // Views nobody reads any more go first, so their chunks can be packed
+    for (int i = 0; i < FS_STORE_POLL_BUCKETS; i++) {
+        store->poll_bucket = (store->poll_bucket + 1) & (store->bucket_count - 1);
+        for (FsBlob* blob = store->buckets[store->poll_bucket]; blob; blob = blob->next) {
+            if (blob->data && now - blob->last_used >= store->cold_seconds) fs_store_drop_view(store, blob);
+        }
+    }
+    SDL_AtomicUnlock(&store->lock);
+
+    if (!store->packer && store->packer_lock && store->packer_wake) {
+        store->packer = SDL_CreateThread(fs_store_packer, "fspacker", store);
+    }
+    if (!store->packer) return;  // Cold chunks stay plain rather than stall the frame
+    SDL_LockMutex(store->packer_lock);
+    store->pack_wanted = true;
+    SDL_CondSignal(store->packer_wake);
+    SDL_UnlockMutex(store->packer_lock);
+}
+
+static int fs_store_cmd_stats(CommandContext* ctx, int argc, char** argv) {
+    const FileSystem* fs = ctx->fs;
+    const FsStore* store = fs->store;
+    char size[FS_FORMAT_LENGTH], cached[FS_FORMAT_LENGTH];
+    command_printf(ctx, "Files: %zu, %s", fs->root->file_count, fs_format_size(fs->root->size, size, sizeof(size)));
+    command_printf(ctx, "Stored: %zu chunks for %zu bodies, %s", store->chunk_count, store->blob_count,
+                   fs_format_size(store->stored_bytes, size, sizeof(size)));
+    command_printf(ctx, "Referenced: %s", fs_format_size(store->referenced_bytes, size, sizeof(size)));
+    double ratio = store->stored_bytes ? (double)store->referenced_bytes / store->stored_bytes : 1.0;
+    command_printf(ctx, "Dedup ratio: %.2fx, %s saved", ratio,
+                   fs_format_size(store->referenced_bytes - store->stored_bytes, size, sizeof(size)));
+    command_printf(ctx, "Compressed: %zu chunks, %s", store->packed_count,
+                   fs_format_size(store->packed_plain_bytes, size, sizeof(size)));
+    command_printf(ctx, "  packed into %s, %s decoded in cache",
+                   fs_format_size(store->packed_bytes, size, sizeof(size)),
+                   fs_format_size(store->cache_bytes, cached, sizeof(cached)));
+    return 0;
+}
+
+static int fs_store_cmd_compress(CommandContext* ctx, int argc, char** argv) {
+    FsStore* store = ctx->fs->store;
+    if (argc > 1) {
+        // The frame loop reads the setting without a lock
+        if (!command_require_foreground(ctx, argv[0])) return 1;
+        char* end;
+        long seconds = strcmp(argv[1], "off") == 0 ? 0 : strtol(argv[1], &end, 10);
+        if (strcmp(argv[1], "off") != 0 && (*end || seconds <= 0)) {
+            command_print(ctx, "Usage: compress [seconds|off]");
+            return 1;
+        }
+        store->cold_seconds = (int)seconds;
+    }
+    if (store->cold_seconds > 0) {
+        command_printf(ctx, "Files unread for %d seconds are compressed", store->cold_seconds);
+    } else {
+        command_print(ctx, "Compression is off");
+    }
+    return 0;
+}
+
+void fs_store_register_commands(void) {
+    command_register("stats", "stats", "Show file count, deduplication and compression savings", fs_store_cmd_stats);
+    command_register("compress", "compress [seconds|off]", "Set how long files sit unread before compression",
+                     fs_store_cmd_compress);
+}
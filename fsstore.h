@@ -0,0 +1,114 @@
+#ifndef MICROOS_FSSTORE_H
+#define MICROOS_FSSTORE_H
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define FS_STORE_CHUNK 4096                 // Bytes per chunk, the unit stored once
+#define FS_STORE_COLD_SECONDS 60            // Default idle time before a chunk is compressed
+#define FS_STORE_PACK_MIN 512               // Smaller chunks are never compressed
+#define FS_STORE_PACK_BUDGET (256 * 1024)   // Bytes the packer compresses per wakeup
+#define FS_STORE_POLL_BUCKETS 1024          // Buckets of each table scanned per fs_store_poll
+#define FS_STORE_CACHE_SLOTS 32             // Assembled bodies kept for rereads
+#define FS_STORE_CACHE_BYTES (8 * 1024 * 1024)
+
+// FS_STORE_CHUNK bytes (fewer at the end of a body) at a chunk boundary of
+// one or more bodies. Any two bodies with the same bytes there share it. Its
+// bytes only change while a single body holds it, and only by appending.
+// A chunk nobody has read for a while is kept only compressed.
+typedef struct FsChunk {
+    struct FsChunk* next;   // Bucket chain
+    uint64_t hash;          // FNV-1a of the bytes
+    int refs;               // Places in bodies that hold it
+    int views;              // Bodies whose view is its bytes
+    size_t size;
+    char* data;             // NUL-terminated bytes, NULL once packed; readers load it unlocked
+    size_t capacity;        // Bytes allocated for data
+    char* packed;           // Compressed bytes, NULL until the chunk goes cold
+    size_t packed_size;
+    time_t last_used;
+} FsChunk;
+
+// One distinct file body, shared by every file (and snapshot) holding the
+// same bytes, as the list of its chunks. Its hash is a sum over the chunks,
+// so a write only hashes the chunks it changed. Readers see the body through
+// a contiguous view: its only chunk's bytes when they are kept plain, or else
+// a copy assembled, and decoded, into the cache when first read.
+typedef struct FsBlob {
+    struct FsBlob* next;    // Bucket chain
+    uint64_t hash;          // Sum of the chunk hashes mixed with their positions
+    int refs;
+    size_t size;
+    FsChunk** chunks;       // One per FS_STORE_CHUNK bytes; the last may be short
+    size_t chunk_count;
+    size_t chunk_capacity;
+    char* data;             // The view, NULL until read; readers load it unlocked
+    size_t capacity;        // Bytes allocated for a copied view, 0 if it is borrowed
+    time_t last_used;
+} FsBlob;
+
+struct FsEpoch;
+
+// Content-addressed store of file bodies, deduplicated by chunk
+typedef struct FsStore {
+    FsBlob** buckets;       // Bodies by hash, power of two
+    size_t bucket_count;
+    size_t blob_count;
+    FsChunk** chunk_buckets;  // Chunks by hash, power of two
+    size_t chunk_bucket_count;
+    size_t chunk_count;
+    size_t stored_bytes;    // Bytes the distinct chunks hold
+    size_t referenced_bytes;  // Bytes the bodies would take if every reference had its own copy
+    size_t packed_count;    // Chunks kept compressed
+    size_t packed_bytes;    // Their compressed size
+    size_t packed_plain_bytes;  // Their size decoded
+    int cold_seconds;       // Idle time before compression, 0 to never compress
+    size_t poll_bucket;     // Where the next fs_store_poll resumes
+    size_t poll_chunk_bucket;  // Where the packer's next batch resumes
+    FsBlob* cache[FS_STORE_CACHE_SLOTS];  // Bodies with a copied view
+    size_t cache_bytes;
+    SDL_SpinLock lock;      // Held only to look chunks up and swap them; nobody compresses under it
+    struct FsEpoch* epoch;  // Bytes readers may hold are retired here, not freed
+    SDL_Thread* packer;     // Compresses cold chunks off the main loop
+    SDL_mutex* packer_lock;
+    SDL_cond* packer_wake;
+    bool pack_wanted;       // Set by fs_store_poll, under packer_lock
+    bool packer_stopping;
+} FsStore;
+
+FsStore* fs_store_create(struct FsEpoch* epoch);
+void fs_store_destroy(FsStore* store);
+
+// Returns the stored body equal to data, with a reference added, storing it
+// first if needed. previous, if not NULL, is a stored body whose chunks are
+// kept without hashing wherever its bytes match. Returns NULL if out of memory.
+FsBlob* fs_store_put(FsStore* store, const char* data, size_t size, FsBlob* previous);
+
+// Writes length bytes at offset (at most blob->size) into a stored body the
+// caller holds a reference to, extending it if they run past the end, and
+// moves that reference to the result. A body nobody else holds is changed in
+// place and only the chunks written are hashed again. Returns NULL if out of
+// memory, leaving blob untouched.
+FsBlob* fs_store_write(FsStore* store, FsBlob* blob, size_t offset, const char* data, size_t length);
+// fs_store_write at the end of the body.
+FsBlob* fs_store_append(FsStore* store, FsBlob* blob, const char* data, size_t length);
+
+void fs_store_retain(FsStore* store, FsBlob* blob);
+void fs_store_release(FsStore* store, FsBlob* blob);
+
+// Returns the body's bytes, contiguous and NUL-terminated, assembling them in
+// the cache if needed. The pointer stays valid until the caller's filesystem
+// read section ends. Returns NULL if out of memory.
+const char* fs_store_data(FsStore* store, FsBlob* blob);
+
+// Drops the views of bodies that have gone cold and wakes the packer thread
+// to compress a bounded batch of cold chunks. Call from the main loop.
+void fs_store_poll(FsStore* store);
+
+// Registers the stats and compress builtins.
+void fs_store_register_commands(void);
+
+#endif // MICROOS_FSSTORE_H
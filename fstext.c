@@ -0,0 +1,547 @@
+#include "fstext.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FS_TEXT_COMPACT_MIN 1024    // Dead entries tolerated before renumbering
+
+static uint32_t fs_text_fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static uint32_t fs_text_gram(const char* p) {
+    return fs_text_fold(p[0]) << 16 | fs_text_fold(p[1]) << 8 | fs_text_fold(p[2]);
+}
+
+static size_t fs_text_slot(const FsText* text, uint32_t gram) {
+    return (gram * 2654435761u) & (text->list_capacity - 1);
+}
+
+static FsTextList* fs_text_find(const FsText* text, uint32_t gram) {
+    for (size_t i = fs_text_slot(text, gram);; i = (i + 1) & (text->list_capacity - 1)) {
+        FsTextList* list = &text->lists[i];
+        if (!list->ids) return NULL;
+        if (list->gram == gram) return list;
+    }
+}
+
+static bool fs_text_grow_lists(FsText* text) {
+    size_t capacity = text->list_capacity * 2;
+    FsTextList* lists = calloc(capacity, sizeof(FsTextList));
+    if (!lists) return false;
+    FsTextList* old = text->lists;
+    size_t old_capacity = text->list_capacity;
+    text->lists = lists;
+    text->list_capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (!old[i].ids) continue;
+        size_t slot = fs_text_slot(text, old[i].gram);
+        while (lists[slot].ids) slot = (slot + 1) & (capacity - 1);
+        lists[slot] = old[i];
+    }
+    free(old);
+    return true;
+}
+
+// Returns the list for gram, adding an empty one if needed
+static FsTextList* fs_text_list(FsText* text, uint32_t gram) {
+    FsTextList* list = fs_text_find(text, gram);
+    if (list) return list;
+    if ((text->list_count + 1) * 2 > text->list_capacity && !fs_text_grow_lists(text)) return NULL;
+    size_t slot = fs_text_slot(text, gram);
+    while (text->lists[slot].ids) slot = (slot + 1) & (text->list_capacity - 1);
+    list = &text->lists[slot];
+    list->ids = malloc(4 * sizeof(uint32_t));
+    if (!list->ids) return NULL;
+    list->gram = gram;
+    list->count = 0;
+    list->sorted = 0;
+    list->capacity = 4;
+    text->list_count++;
+    return list;
+}
+
+static bool fs_text_push(FsText* text, FsTextList* list, uint32_t id) {
+    if (list->count && list->ids[list->count - 1] == id) return true;  // Repeated appends
+    if (list->count == list->capacity) {
+        uint32_t* ids = realloc(list->ids, list->capacity * 2 * sizeof(uint32_t));
+        if (!ids) return false;
+        list->ids = ids;
+        list->capacity *= 2;
+    }
+    if (list->sorted == list->count && (list->count == 0 || list->ids[list->count - 1] < id)) list->sorted++;
+    list->ids[list->count++] = id;
+    text->postings++;
+    return true;
+}
+
+static int fs_text_compare_ids(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Brings back the order an append to an older file broke
+static void fs_text_sort(FsText* text, FsTextList* list) {
+    if (list->sorted == list->count) return;
+    qsort(list->ids, list->count, sizeof(uint32_t), fs_text_compare_ids);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < list->count; i++) {
+        if (kept == 0 || list->ids[kept - 1] != list->ids[i]) list->ids[kept++] = list->ids[i];
+    }
+    text->postings -= list->count - kept;
+    list->count = list->sorted = kept;
+}
+
+// Appends the distinct trigrams of data to *grams. seen must be clear and is
+// left clear. Returns false if out of memory, with only some appended.
+static bool fs_text_distinct(uint8_t* seen, const char* data, size_t length,
+                             uint32_t** grams, size_t* count, size_t* capacity) {
+    size_t first = *count;
+    bool ok = true;
+    for (size_t i = 0; i + 3 <= length; i++) {
+        uint32_t gram = fs_text_gram(data + i);
+        if (seen[gram >> 3] & (1 << (gram & 7))) continue;
+        if (*count == *capacity) {
+            size_t grown = *capacity ? *capacity * 2 : 1024;
+            uint32_t* resized = realloc(*grams, grown * sizeof(uint32_t));
+            if (!resized) {
+                ok = false;
+                break;
+            }
+            *grams = resized;
+            *capacity = grown;
+        }
+        seen[gram >> 3] |= 1 << (gram & 7);
+        (*grams)[(*count)++] = gram;
+    }
+    for (size_t i = first; i < *count; i++) {
+        uint32_t gram = (*grams)[i];
+        seen[gram >> 3] &= ~(1 << (gram & 7));
+    }
+    return ok;
+}
+
+// Adds id to the list of each trigram. Returns false if out of memory, with
+// id left in some lists only.
+static bool fs_text_post(FsText* text, uint32_t id, const uint32_t* grams, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        FsTextList* list = fs_text_list(text, grams[i]);
+        if (!list || !fs_text_push(text, list, id)) return false;
+    }
+    return true;
+}
+
+// Adds id to the list of every distinct trigram in data
+static bool fs_text_add(FsText* text, uint32_t id, const char* data, size_t length) {
+    size_t count = 0;
+    return fs_text_distinct(text->seen, data, length, &text->grams, &count, &text->gram_capacity) &&
+           fs_text_post(text, id, text->grams, count);
+}
+
+// Gives node, which has no id, a new one queued for indexing. If there is no
+// memory for it, the index is marked stale until the next search repairs it.
+static bool fs_text_queue(FsText* text, FileNode* node) {
+    if (text->entry_count == text->entry_capacity) {
+        uint32_t capacity = text->entry_capacity * 2;
+        FsTextEntry* entries = realloc(text->entries, capacity * sizeof(FsTextEntry));
+        if (!entries) {
+            SDL_AtomicSet(&text->stale, 1);
+            return false;
+        }
+        text->entries = entries;
+        text->entry_capacity = capacity;
+    }
+    if (text->pending_count == text->pending_capacity) {
+        size_t capacity = text->pending_capacity ? text->pending_capacity * 2 : 256;
+        uint32_t* pending = realloc(text->pending, capacity * sizeof(uint32_t));
+        if (!pending) {
+            SDL_AtomicSet(&text->stale, 1);
+            return false;
+        }
+        text->pending = pending;
+        text->pending_capacity = capacity;
+    }
+    uint32_t id = text->entry_count++;
+    text->entries[id] = (FsTextEntry){node, true, 0};
+    text->pending[text->pending_count++] = id;
+    node->text_id = id;
+    return true;
+}
+
+static void fs_text_drop(FsText* text, FileNode* node) {
+    text->entries[node->text_id].node = NULL;
+    text->dead++;
+    node->text_id = 0;
+}
+
+void fs_text_changed(FileSystem* fs, FileNode* file) {
+    FsText* text = fs->text;
+    if (!text || file->is_directory) return;
+    SDL_LockMutex(text->lock);
+    if (!file->text_id || !text->entries[file->text_id].pending) {
+        if (file->text_id) fs_text_drop(text, file);
+        fs_text_queue(text, file);
+    } else {
+        text->entries[file->text_id].changes++;
+    }
+    SDL_UnlockMutex(text->lock);
+}
+
+void fs_text_appended(FileSystem* fs, FileNode* file, size_t old_size) {
+    FsText* text = fs->text;
+    if (!text) return;
+    SDL_LockMutex(text->lock);
+    if (!file->text_id) {
+        fs_text_queue(text, file);
+    } else if (text->entries[file->text_id].pending) {
+        text->entries[file->text_id].changes++;
+    } else {
+        // Only trigrams that end in the new bytes can be new
+        size_t start = old_size >= 2 ? old_size - 2 : 0;
+        const char* body = fs_file_content(fs, file);
+        if (!body || !fs_text_add(text, file->text_id, body + start, file->size - start)) {
+            fs_text_drop(text, file);
+            fs_text_queue(text, file);
+        }
+    }
+    SDL_UnlockMutex(text->lock);
+}
+
+void fs_text_forget(FileSystem* fs, FileNode* node) {
+    FsText* text = fs->text;
+    if (!text || !node->text_id) return;
+    SDL_LockMutex(text->lock);
+    fs_text_drop(text, node);
+    SDL_UnlockMutex(text->lock);
+}
+
+void fs_text_track(FileSystem* fs, FileNode* node) {
+    FsText* text = fs->text;
+    if (!text || node->is_directory || node->text_id) return;
+    SDL_LockMutex(text->lock);
+    fs_text_queue(text, node);
+    SDL_UnlockMutex(text->lock);
+}
+
+// Queues every file without an id
+static bool fs_text_track_tree(FileNode* node, void* user) {
+    FileSystem* fs = user;
+    if (node->is_directory) {
+        fs_each_child(node, "", 0, fs_text_track_tree, fs);
+    } else if (!node->text_id) {
+        fs_text_queue(fs->text, node);
+    }
+    return true;
+}
+
+// Queues the files a failed fs_text_queue left out. Called with writers held off.
+static void fs_text_repair(FileSystem* fs, FsText* text) {
+    SDL_LockMutex(text->lock);
+    SDL_AtomicSet(&text->stale, 0);
+    fs_each_child(fs->root, "", 0, fs_text_track_tree, fs);
+    SDL_UnlockMutex(text->lock);
+}
+
+static FsText* fs_text_create(FileSystem* fs) {
+    FsText* text = calloc(1, sizeof(FsText));
+    if (!text) return NULL;
+    text->list_capacity = 1024;
+    text->lists = calloc(text->list_capacity, sizeof(FsTextList));
+    text->entry_capacity = 1024;
+    text->entries = calloc(text->entry_capacity, sizeof(FsTextEntry));
+    text->entry_count = 1;
+    text->seen = calloc(FS_TEXT_GRAMS / 8, 1);
+    text->lock = SDL_CreateMutex();
+    if (!text->lists || !text->entries || !text->seen || !text->lock) {
+        free(text->lists);
+        free(text->entries);
+        free(text->seen);
+        if (text->lock) SDL_DestroyMutex(text->lock);
+        free(text);
+        return NULL;
+    }
+    SDL_LockMutex(text->lock);
+    fs->text = text;
+    fs_each_child(fs->root, "", 0, fs_text_track_tree, fs);
+    SDL_UnlockMutex(text->lock);
+    return text;
+}
+
+// A queued body as a search reads it
+typedef struct {
+    uint32_t id;
+    uint32_t changes;       // The entry's count when the body was read
+    FileNode* node;
+    size_t first;           // Its trigrams in the batch's array
+    size_t count;
+    bool read;
+} FsTextItem;
+
+// Indexes the queued bodies. Called with the lock held and returns with it
+// held, but reads the bodies and collects their trigrams without it. Bodies
+// changed meanwhile, or that cannot be read, stay queued and so are always
+// candidates, as are those another search is still reading.
+static void fs_text_index_pending(FileSystem* fs, FsText* text) {
+    if (text->indexing || text->pending_count == 0) return;
+    if (!text->scan_seen && !(text->scan_seen = calloc(FS_TEXT_GRAMS / 8, 1))) return;
+    FsTextItem* items = malloc(text->pending_count * sizeof(FsTextItem));
+    if (!items) return;
+    size_t count = 0;
+    for (size_t i = 0; i < text->pending_count; i++) {
+        uint32_t id = text->pending[i];
+        FsTextEntry* entry = &text->entries[id];
+        // A host file not read yet stays a candidate rather than a search
+        // loading it, which is a change
+        if (!entry->node || entry->node->unloaded) continue;
+        items[count++] = (FsTextItem){id, entry->changes, entry->node, 0, 0, false};
+    }
+    text->indexing = true;
+    SDL_UnlockMutex(text->lock);
+
+    // The caller's read section keeps the nodes readable even if freed meanwhile
+    uint32_t* grams = NULL;
+    size_t gram_count = 0, gram_capacity = 0;
+    for (size_t i = 0; i < count; i++) {
+        FsTextItem* item = &items[i];
+        size_t size;
+        const char* body = fs_file_body(fs, item->node, &size);
+        item->first = gram_count;
+        item->read = body && fs_text_distinct(text->scan_seen, body, size, &grams, &gram_count, &gram_capacity);
+        if (!item->read) gram_count = item->first;
+        item->count = gram_count - item->first;
+    }
+
+    SDL_LockMutex(text->lock);
+    text->indexing = false;
+    for (size_t i = 0; i < count; i++) {
+        FsTextItem* item = &items[i];
+        FsTextEntry* entry = &text->entries[item->id];
+        if (!item->read || !entry->node || entry->changes != item->changes) continue;
+        if (fs_text_post(text, item->id, grams + item->first, item->count)) entry->pending = false;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < text->pending_count; i++) {
+        FsTextEntry* entry = &text->entries[text->pending[i]];
+        if (entry->node && entry->pending) text->pending[kept++] = text->pending[i];
+    }
+    text->pending_count = kept;
+    free(grams);
+    free(items);
+}
+
+// Renumbers the live entries once most ids are dead. The mapping keeps the
+// order, so sorted lists stay sorted.
+static void fs_text_compact(FsText* text) {
+    uint32_t* map = malloc(text->entry_count * sizeof(uint32_t));
+    if (!map) return;
+    uint32_t count = 1;
+    map[0] = 0;
+    for (uint32_t id = 1; id < text->entry_count; id++) {
+        FsTextEntry entry = text->entries[id];
+        map[id] = entry.node ? count : 0;
+        if (!entry.node) continue;
+        entry.node->text_id = count;
+        text->entries[count++] = entry;
+    }
+    text->entry_count = count;
+    text->dead = 0;
+
+    for (size_t i = 0; i < text->list_capacity; i++) {
+        FsTextList* list = &text->lists[i];
+        if (!list->ids) continue;
+        uint32_t kept = 0, sorted = 0;
+        for (uint32_t j = 0; j < list->count; j++) {
+            uint32_t id = map[list->ids[j]];
+            if (!id) continue;
+            list->ids[kept++] = id;
+            if (j < list->sorted) sorted = kept;
+        }
+        text->postings -= list->count - kept;
+        list->count = kept;
+        list->sorted = sorted;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < text->pending_count; i++) {
+        uint32_t id = map[text->pending[i]];
+        if (id) text->pending[kept++] = id;
+    }
+    text->pending_count = kept;
+    free(map);
+}
+
+static bool fs_text_under(const FileNode* node, const FileNode* root) {
+    for (; node; node = node->parent) {
+        if (node == root) return true;
+    }
+    return false;
+}
+
+typedef struct {
+    FileNode** nodes;
+    long count;
+    long capacity;
+    bool failed;
+} FsTextResult;
+
+static void fs_text_result_add(FsTextResult* result, FileNode* node) {
+    if (result->count == result->capacity) {
+        long capacity = result->capacity ? result->capacity * 2 : 64;
+        FileNode** nodes = realloc(result->nodes, capacity * sizeof(FileNode*));
+        if (!nodes) {
+            result->failed = true;
+            return;
+        }
+        result->nodes = nodes;
+        result->capacity = capacity;
+    }
+    result->nodes[result->count++] = node;
+}
+
+static long fs_text_finish(FsTextResult* result, FileNode*** out) {
+    if (result->failed) {
+        free(result->nodes);
+        *out = NULL;
+        return -1;
+    }
+    *out = result->nodes;
+    return result->count;
+}
+
+static bool fs_text_collect(FileNode* node, void* user) {
+    FsTextResult* result = user;
+    if (node->is_directory) {
+        fs_each_child(node, "", 0, fs_text_collect, result);
+    } else {
+        fs_text_result_add(result, node);
+    }
+    return !result->failed;
+}
+
+// Keeps the ids of ids[0..count) that list also holds. Both are ascending;
+// the list is usually the longer, so it is probed by binary search.
+static uint32_t fs_text_intersect(uint32_t* ids, uint32_t count, const FsTextList* list) {
+    uint32_t kept = 0, low = 0;
+    for (uint32_t i = 0; i < count && low < list->count; i++) {
+        uint32_t high = list->count;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (list->ids[mid] < ids[i]) low = mid + 1;
+            else high = mid;
+        }
+        if (low < list->count && list->ids[low] == ids[i]) ids[kept++] = ids[i];
+    }
+    return kept;
+}
+
+static int fs_text_compare_lists(const void* a, const void* b) {
+    uint32_t x = (*(FsTextList* const*)a)->count, y = (*(FsTextList* const*)b)->count;
+    return x < y ? -1 : x > y;
+}
+
+// Every file under root, for when the index cannot narrow the search
+static long fs_text_all(const FileNode* root, FileNode*** out) {
+    FsTextResult result = {NULL, 0, 0, false};
+    if (root->is_directory) {
+        fs_each_child(root, "", 0, fs_text_collect, &result);
+    } else {
+        fs_text_result_add(&result, (FileNode*)root);
+    }
+    return fs_text_finish(&result, out);
+}
+
+static long fs_text_search(FileSystem* fs, const char* pattern, const FileNode* root, FileNode*** out) {
+    FsTextResult result = {NULL, 0, 0, false};
+    size_t length = strlen(pattern);
+    if (length < 3) return fs_text_all(root, out);
+
+    if (!fs->text || SDL_AtomicGet(&fs->text->stale)) {
+        // Built, or repaired, with writers held off, so no change slips past the walk
+        fs_write_begin(fs);
+        if (!fs->text) {
+            fs_text_create(fs);
+        } else if (SDL_AtomicGet(&fs->text->stale)) {
+            fs_text_repair(fs, fs->text);
+        }
+        fs_write_end(fs);
+        if (!fs->text) return -1;
+    }
+    // Rarest trigram first, so the candidate set shrinks fastest
+    size_t gram_count = length - 2;
+    FsTextList** lists = malloc(gram_count * sizeof(FsTextList*));
+    FsText* text = fs->text;
+    SDL_LockMutex(text->lock);
+    if (SDL_AtomicGet(&text->stale)) {
+        // Still missing files, so none can be ruled out
+        SDL_UnlockMutex(text->lock);
+        free(lists);
+        return fs_text_all(root, out);
+    }
+    fs_text_index_pending(fs, text);
+    // Not while another search reads bodies by the ids it took
+    if (!text->indexing && text->dead > FS_TEXT_COMPACT_MIN && text->dead * 2 > text->entry_count) {
+        fs_text_compact(text);
+    }
+
+    uint32_t* ids = NULL;
+    uint32_t count = 0;
+    bool missing = false;
+    if (!lists) result.failed = true;
+    for (size_t i = 0; lists && i < gram_count; i++) {
+        lists[i] = fs_text_find(text, fs_text_gram(pattern + i));
+        if (!lists[i] || lists[i]->count == 0) {
+            missing = true;
+            break;
+        }
+        fs_text_sort(text, lists[i]);
+    }
+    if (lists && !missing) {
+        qsort(lists, gram_count, sizeof(FsTextList*), fs_text_compare_lists);
+        ids = malloc(lists[0]->count * sizeof(uint32_t));
+        if (ids) {
+            memcpy(ids, lists[0]->ids, lists[0]->count * sizeof(uint32_t));
+            count = lists[0]->count;
+            for (size_t i = 1; i < gram_count && count; i++) {
+                count = fs_text_intersect(ids, count, lists[i]);
+            }
+        } else {
+            result.failed = true;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        FileNode* node = text->entries[ids[i]].node;
+        if (node && fs_text_under(node, root)) fs_text_result_add(&result, node);
+    }
+    // Bodies that could not be indexed are never ruled out
+    for (size_t i = 0; i < text->pending_count; i++) {
+        FileNode* node = text->entries[text->pending[i]].node;
+        if (node && fs_text_under(node, root)) fs_text_result_add(&result, node);
+    }
+    SDL_UnlockMutex(text->lock);
+    free(ids);
+    free(lists);
+
+    return fs_text_finish(&result, out);
+}
+
+long fs_text_candidates(FileSystem* fs, const char* pattern, const FileNode* root, FileNode*** out) {
+    fs_read_begin(fs);
+    long count = fs_text_search(fs, pattern, root, out);
+    fs_read_end(fs);
+    return count;
+}
+
+void fs_text_release(FileSystem* fs) {
+    FsText* text = fs->text;
+    if (!text) return;
+    for (size_t i = 0; i < text->list_capacity; i++) {
+        free(text->lists[i].ids);
+    }
+    free(text->lists);
+    free(text->entries);
+    free(text->pending);
+    free(text->seen);
+    free(text->scan_seen);
+    free(text->grams);
+    SDL_DestroyMutex(text->lock);
+    free(text);
+    fs->text = NULL;
+}
@@ -0,0 +1,71 @@
+#ifndef MICROOS_FSTEXT_H
+#define MICROOS_FSTEXT_H
+
+#include "filesystem.h"
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FS_TEXT_GRAMS (1u << 24)    // Distinct trigrams (three bytes, ASCII case folded)
+
+// Files holding one trigram, by entry id
+typedef struct {
+    uint32_t gram;
+    uint32_t count;
+    uint32_t sorted;        // Leading ids in ascending order without repeats
+    uint32_t capacity;
+    uint32_t* ids;          // NULL marks a free slot
+} FsTextList;
+
+typedef struct {
+    FileNode* node;         // NULL once the file is freed or its id replaced
+    bool pending;           // Body not indexed yet
+    uint32_t changes;       // Writes while pending, so a body read meanwhile is not trusted
+} FsTextEntry;
+
+// Trigram inverted index over file bodies. A rewritten file gets a new id and
+// is queued; the queue is indexed by the next search, so writes cost O(1).
+// The search reads the queued bodies without the lock and only publishes
+// their postings under it, so writers never wait out the indexing.
+// Appends index only the new bytes. Ids of rewritten and freed files linger
+// in the lists until a compaction renumbers the survivors.
+typedef struct FsText {
+    FsTextList* lists;      // Open addressing on gram, power of two
+    size_t list_capacity;
+    size_t list_count;
+    size_t postings;
+    FsTextEntry* entries;   // By id; id 0 is unused
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    uint32_t dead;          // Entries whose node is gone
+    uint32_t* pending;      // Ids queued for indexing, ascending
+    size_t pending_count;
+    size_t pending_capacity;
+    uint8_t* seen;          // FS_TEXT_GRAMS bits: trigrams of the body being indexed
+    uint32_t* grams;        // Those trigrams, to clear seen afterwards
+    size_t gram_capacity;
+    uint8_t* scan_seen;     // Like seen, for a search reading queued bodies unlocked
+    bool indexing;          // A search is reading queued bodies; their ids stay fixed
+    SDL_atomic_t stale;     // Some file could not be queued and has no id
+    SDL_mutex* lock;        // Job threads search and write too
+} FsText;
+
+// Called by the filesystem when a file's body is replaced, extended from
+// old_size, or the node is freed, and by rollback for nodes it puts back.
+// They do nothing until the first search builds the index.
+void fs_text_changed(FileSystem* fs, FileNode* file);
+void fs_text_appended(FileSystem* fs, FileNode* file, size_t old_size);
+void fs_text_forget(FileSystem* fs, FileNode* node);
+void fs_text_track(FileSystem* fs, FileNode* node);
+
+// Collects into *out (malloc'd, caller frees) the files under root whose
+// bodies may contain pattern, ignoring ASCII case. A pattern under three
+// bytes cannot be narrowed and yields every file under root. The first call
+// indexes the whole tree. Returns the count, or -1 if out of memory.
+long fs_text_candidates(FileSystem* fs, const char* pattern, const FileNode* root, FileNode*** out);
+
+// Frees the index. Called by fs_destroy.
+void fs_text_release(FileSystem* fs);
+
+#endif // MICROOS_FSTEXT_H
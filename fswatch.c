@@ -0,0 +1,137 @@
+#include "fswatch.h"
+#include <stdlib.h>
+
+// What a poll hands to one callback, copied out so callbacks run unlocked
+typedef struct {
+    FsWatchCallback callback;
+    FileNode* node;
+    void* user;
+} FsWatchEvent;
+
+static bool fs_watch_on(const FsWatches* watches, const FileNode* node) {
+    for (int i = 0; i < watches->count; i++) {
+        if (watches->list[i].id && watches->list[i].node == node) return true;
+    }
+    return false;
+}
+
+int fs_watch(FileSystem* fs, FileNode* node, bool subtree, FsWatchCallback callback, void* user) {
+    fs_write_begin(fs);  // Writers read node->watched
+    if (!fs->watches) fs->watches = calloc(1, sizeof(FsWatches));
+    FsWatches* watches = fs->watches;
+    if (!watches) {
+        fs_write_end(fs);
+        return 0;
+    }
+    SDL_AtomicLock(&watches->lock);
+    int slot = 0;
+    while (slot < watches->count && watches->list[slot].id) slot++;
+    if (slot == watches->capacity) {
+        int capacity = watches->capacity ? watches->capacity * 2 : 8;
+        FsWatch* list = realloc(watches->list, capacity * sizeof(FsWatch));
+        if (!list) {
+            SDL_AtomicUnlock(&watches->lock);
+            fs_write_end(fs);
+            return 0;
+        }
+        watches->list = list;
+        watches->capacity = capacity;
+    }
+    if (slot == watches->count) watches->count++;
+    int id = ++watches->next_id;
+    watches->list[slot] = (FsWatch){id, node, subtree, false, false, callback, user};
+    node->watched = true;
+    SDL_AtomicUnlock(&watches->lock);
+    fs_write_end(fs);
+    return id;
+}
+
+void fs_unwatch(FileSystem* fs, int id) {
+    FsWatches* watches = fs->watches;
+    if (!watches || id == 0) return;
+    fs_write_begin(fs);
+    SDL_AtomicLock(&watches->lock);
+    for (int i = 0; i < watches->count; i++) {
+        FsWatch* watch = &watches->list[i];
+        if (watch->id != id) continue;
+        if (watch->pending) watches->pending--;
+        FileNode* node = watch->node;
+        watch->id = 0;
+        if (node && !fs_watch_on(watches, node)) node->watched = false;
+        break;
+    }
+    while (watches->count > 0 && !watches->list[watches->count - 1].id) watches->count--;
+    SDL_AtomicUnlock(&watches->lock);
+    fs_write_end(fs);
+}
+
+void fs_watch_notify(FileSystem* fs, FileNode* node, int depth) {
+    FsWatches* watches = fs->watches;
+    if (!watches) return;
+    SDL_AtomicLock(&watches->lock);
+    for (int i = 0; i < watches->count; i++) {
+        FsWatch* watch = &watches->list[i];
+        if (watch->id && watch->node == node && !watch->pending && (depth <= 1 || watch->subtree)) {
+            watch->pending = true;
+            watches->pending++;
+        }
+    }
+    SDL_AtomicUnlock(&watches->lock);
+}
+
+void fs_watch_forget(FileSystem* fs, FileNode* node) {
+    FsWatches* watches = fs->watches;
+    if (!watches) return;
+    SDL_AtomicLock(&watches->lock);
+    for (int i = 0; i < watches->count; i++) {
+        FsWatch* watch = &watches->list[i];
+        if (!watch->id || watch->node != node) continue;
+        watch->node = NULL;
+        watch->deleted = true;
+        if (!watch->pending) watches->pending++;
+        watch->pending = true;
+    }
+    node->watched = false;
+    SDL_AtomicUnlock(&watches->lock);
+}
+
+void fs_watch_poll(FileSystem* fs) {
+    FsWatches* watches = fs->watches;
+    if (!watches || watches->pending == 0) return;
+
+    SDL_AtomicLock(&watches->lock);
+    FsWatchEvent* events = malloc(watches->pending * sizeof(FsWatchEvent));
+    if (!events) {
+        SDL_AtomicUnlock(&watches->lock);
+        return;  // Still queued for the next poll
+    }
+    int count = 0;
+    for (int i = 0; i < watches->count; i++) {
+        FsWatch* watch = &watches->list[i];
+        if (!watch->id || !watch->pending) continue;
+        events[count++] = (FsWatchEvent){watch->callback, watch->node, watch->user};
+        watch->pending = false;
+        if (watch->deleted) watch->id = 0;
+    }
+    watches->pending = 0;
+    while (watches->count > 0 && !watches->list[watches->count - 1].id) watches->count--;
+    SDL_AtomicUnlock(&watches->lock);
+
+    // Callbacks may watch, unwatch or change the tree. Nodes stay valid for
+    // the caller's read section, even if deleted meanwhile.
+    for (int i = 0; i < count; i++) {
+        events[i].callback(fs, events[i].node, events[i].user);
+    }
+    free(events);
+}
+
+void fs_watch_release(FileSystem* fs) {
+    FsWatches* watches = fs->watches;
+    if (!watches) return;
+    for (int i = 0; i < watches->count; i++) {
+        if (watches->list[i].node) watches->list[i].node->watched = false;
+    }
+    free(watches->list);
+    free(watches);
+    fs->watches = NULL;
+}
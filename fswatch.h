@@ -0,0 +1,51 @@
+#ifndef MICROOS_FSWATCH_H
+#define MICROOS_FSWATCH_H
+
+#include "filesystem.h"
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Called by fs_watch_poll for a watch whose node changed since the last
+// poll. node is NULL if it was deleted, and the watch is gone by then.
+typedef void (*FsWatchCallback)(FileSystem* fs, FileNode* node, void* user);
+
+typedef struct {
+    int id;                 // 0 marks a free slot
+    FileNode* node;
+    bool subtree;           // Fire for changes anywhere below, not just to node and its children
+    bool pending;           // Changed since the last poll
+    bool deleted;
+    FsWatchCallback callback;
+    void* user;
+} FsWatch;
+
+// Watches are few, so they are scanned. Writers on any thread queue events;
+// the main loop delivers them, so callbacks need no locking of their own.
+typedef struct FsWatches {
+    FsWatch* list;
+    int count;              // Slots in use or freed, up to the highest live one
+    int capacity;
+    int next_id;
+    int pending;            // Watches with an event queued
+    SDL_SpinLock lock;
+} FsWatches;
+
+// Calls callback once per poll after node changes: its body, its name or
+// place, or a child being added, removed or changed. With subtree, any change
+// below node counts too. Returns an id for fs_unwatch, or 0 if out of memory.
+int fs_watch(FileSystem* fs, FileNode* node, bool subtree, FsWatchCallback callback, void* user);
+void fs_unwatch(FileSystem* fs, int id);
+
+// Runs the callbacks of the watches that fired. Call from the main loop.
+void fs_watch_poll(FileSystem* fs);
+
+// Called by the filesystem for a watched node on the path from a change up to
+// the root; depth 0 is the changed node itself. And when a watched node is freed.
+void fs_watch_notify(FileSystem* fs, FileNode* node, int depth);
+void fs_watch_forget(FileSystem* fs, FileNode* node);
+
+// Drops every watch. Called by fs_destroy.
+void fs_watch_release(FileSystem* fs);
+
+#endif // MICROOS_FSWATCH_H
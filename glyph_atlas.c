@@ -0,0 +1,281 @@
+#include "glyph_atlas.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLYPH_ATLAS_PADDING 1  // Empty pixels between glyphs so filtering never bleeds
+
+typedef struct {
+    SDL_Rect src;     // Glyph cell inside the atlas texture (w == 0 if not provided)
+    int advance;      // Horizontal pen advance in pixels
+} GlyphInfo;
+
+typedef struct {
+    SDL_Renderer* renderer;
+    TTF_Font* font;
+    SDL_Texture* texture;
+    int texture_w;
+    int texture_h;
+    int line_height;
+    GlyphInfo glyphs[256];
+} GlyphAtlas;
+
+static GlyphAtlas atlases[GLYPH_ATLAS_MAX_FONTS];
+static int atlas_count = 0;
+
+// Scratch buffers reused by every draw call so batching never allocates per frame
+static SDL_Vertex* batch_vertices = NULL;
+static int* batch_indices = NULL;
+static int batch_capacity = 0;  // In glyphs
+
+static void glyph_atlas_release(GlyphAtlas* atlas) {
+    if (atlas->texture) {
+        SDL_DestroyTexture(atlas->texture);
+    }
+    memset(atlas, 0, sizeof(GlyphAtlas));
+}
+
+// Rasterizes every glyph of the font once and packs them row by row into one texture.
+static bool glyph_atlas_build(GlyphAtlas* atlas, SDL_Renderer* renderer, TTF_Font* font) {
+    SDL_Surface* glyph_surfaces[256] = {0};
+    SDL_Color white = {255, 255, 255, 255};
+
+    memset(atlas, 0, sizeof(GlyphAtlas));
+    atlas->renderer = renderer;
+    atlas->font = font;
+    atlas->line_height = TTF_FontHeight(font);
+
+    // First pass: render glyphs and lay them out on shelves
+    int pen_x = 0;
+    int pen_y = 0;
+    int row_height = 0;
+    for (int ch = GLYPH_ATLAS_FIRST_CHAR; ch <= GLYPH_ATLAS_LAST_CHAR; ch++) {
+        if (!TTF_GlyphIsProvided(font, (Uint16)ch)) continue;
+
+        int advance = 0;
+        if (TTF_GlyphMetrics(font, (Uint16)ch, NULL, NULL, NULL, NULL, &advance) != 0) continue;
+        atlas->glyphs[ch].advance = advance;
+
+        SDL_Surface* surface = TTF_RenderGlyph_Blended(font, (Uint16)ch, white);
+        if (!surface) continue;
+        glyph_surfaces[ch] = surface;
+
+        if (pen_x + surface->w > GLYPH_ATLAS_WIDTH) {
+            pen_x = 0;
+            pen_y += row_height + GLYPH_ATLAS_PADDING;
+            row_height = 0;
+        }
+        atlas->glyphs[ch].src = (SDL_Rect){pen_x, pen_y, surface->w, surface->h};
+        pen_x += surface->w + GLYPH_ATLAS_PADDING;
+        if (surface->h > row_height) row_height = surface->h;
+    }
+    atlas->texture_w = GLYPH_ATLAS_WIDTH;
+    atlas->texture_h = pen_y + row_height;
+
+    // Second pass: copy every glyph into the atlas surface
+    bool ok = false;
+    SDL_Surface* sheet = NULL;
+    if (atlas->texture_h > 0) {
+        sheet = SDL_CreateRGBSurfaceWithFormat(0, atlas->texture_w, atlas->texture_h, 32,
+                                               SDL_PIXELFORMAT_RGBA32);
+    }
+    if (sheet) {
+        SDL_FillRect(sheet, NULL, 0);
+        for (int ch = GLYPH_ATLAS_FIRST_CHAR; ch <= GLYPH_ATLAS_LAST_CHAR; ch++) {
+            if (!glyph_surfaces[ch]) continue;
+            SDL_Rect dst = atlas->glyphs[ch].src;
+            SDL_SetSurfaceBlendMode(glyph_surfaces[ch], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyph_surfaces[ch], NULL, sheet, &dst);
+        }
+        atlas->texture = SDL_CreateTextureFromSurface(renderer, sheet);
+        if (atlas->texture) {
+            SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+            ok = true;
+        } else {
+            fprintf(stderr, "Glyph atlas texture error: %s\n", SDL_GetError());
+        }
+        SDL_FreeSurface(sheet);
+    } else {
+        fprintf(stderr, "Glyph atlas surface error: %s\n", TTF_GetError());
+    }
+
+    for (int ch = 0; ch < 256; ch++) {
+        if (glyph_surfaces[ch]) SDL_FreeSurface(glyph_surfaces[ch]);
+    }
+
+    // Characters the font does not provide are drawn with '?' instead
+    GlyphInfo fallback = atlas->glyphs['?'];
+    for (int ch = 0; ch < 256; ch++) {
+        if (atlas->glyphs[ch].src.w == 0 && atlas->glyphs[ch].advance == 0) {
+            atlas->glyphs[ch] = (ch < GLYPH_ATLAS_FIRST_CHAR) ? atlas->glyphs[' '] : fallback;
+        }
+    }
+    return ok;
+}
+
+static GlyphAtlas* glyph_atlas_get(SDL_Renderer* renderer, TTF_Font* font) {
+    for (int i = 0; i < atlas_count; i++) {
+        if (atlases[i].renderer == renderer && atlases[i].font == font) {
+            return &atlases[i];
+        }
+    }
+
+    // Evict the oldest atlas if every slot is taken
+    if (atlas_count == GLYPH_ATLAS_MAX_FONTS) {
+        glyph_atlas_release(&atlases[0]);
+        memmove(&atlases[0], &atlases[1], (GLYPH_ATLAS_MAX_FONTS - 1) * sizeof(GlyphAtlas));
+        atlas_count--;
+    }
+
+    GlyphAtlas* atlas = &atlases[atlas_count];
+    if (!glyph_atlas_build(atlas, renderer, font)) {
+        glyph_atlas_release(atlas);
+        return NULL;
+    }
+    atlas_count++;
+    return atlas;
+}
+
+static bool glyph_atlas_reserve(int glyph_count) {
+    if (glyph_count <= batch_capacity) return true;
+
+    int capacity = batch_capacity ? batch_capacity : 64;
+    while (capacity < glyph_count) capacity *= 2;
+
+    SDL_Vertex* vertices = realloc(batch_vertices, sizeof(SDL_Vertex) * 4 * capacity);
+    if (!vertices) return false;
+    batch_vertices = vertices;
+    int* indices = realloc(batch_indices, sizeof(int) * 6 * capacity);
+    if (!indices) return false;
+    batch_indices = indices;
+    batch_capacity = capacity;
+    return true;
+}
+
+SDL_Rect glyph_atlas_draw_text_n(SDL_Renderer* renderer, TTF_Font* font, const char* text,
+                                 int length, int x, int y, SDL_Color color) {
+    SDL_Rect bounds = {x, y, 0, 0};
+    GlyphAtlas* atlas = glyph_atlas_get(renderer, font);
+    if (!atlas || !text || length <= 0) return bounds;
+    if (!glyph_atlas_reserve(length)) return bounds;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    float inv_w = 1.0f / atlas->texture_w;
+    float inv_h = 1.0f / atlas->texture_h;
+#endif
+    const unsigned char* p = (const unsigned char*)text;
+    int pen_x = x;
+    int quads = 0;
+
+    for (int i = 0; i < length; i++) {
+        const GlyphInfo* glyph = &atlas->glyphs[p[i]];
+        if (glyph->src.w > 0) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+            float x0 = (float)pen_x;
+            float y0 = (float)y;
+            float x1 = x0 + glyph->src.w;
+            float y1 = y0 + glyph->src.h;
+            float u0 = glyph->src.x * inv_w;
+            float v0 = glyph->src.y * inv_h;
+            float u1 = (glyph->src.x + glyph->src.w) * inv_w;
+            float v1 = (glyph->src.y + glyph->src.h) * inv_h;
+
+            SDL_Vertex* v = &batch_vertices[quads * 4];
+            v[0] = (SDL_Vertex){{x0, y0}, color, {u0, v0}};
+            v[1] = (SDL_Vertex){{x1, y0}, color, {u1, v0}};
+            v[2] = (SDL_Vertex){{x1, y1}, color, {u1, v1}};
+            v[3] = (SDL_Vertex){{x0, y1}, color, {u0, v1}};
+
+            int* idx = &batch_indices[quads * 6];
+            int base = quads * 4;
+            idx[0] = base; idx[1] = base + 1; idx[2] = base + 2;
+            idx[3] = base; idx[4] = base + 2; idx[5] = base + 3;
+#else
+            // Older SDL has no geometry API: fall back to one copy per glyph
+            SDL_Rect dst = {pen_x, y, glyph->src.w, glyph->src.h};
+            if (quads == 0) {
+                SDL_SetTextureColorMod(atlas->texture, color.r, color.g, color.b);
+                SDL_SetTextureAlphaMod(atlas->texture, color.a);
+            }
+            SDL_RenderCopy(renderer, atlas->texture, &glyph->src, &dst);
+#endif
+            quads++;
+        }
+        pen_x += glyph->advance;
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (quads > 0) {
+        SDL_RenderGeometry(renderer, atlas->texture, batch_vertices, quads * 4,
+                           batch_indices, quads * 6);
+    }
+#endif
+
+    bounds.w = pen_x - x;
+    bounds.h = atlas->line_height;
+    return bounds;
+}
+
+SDL_Rect glyph_atlas_draw_text(SDL_Renderer* renderer, TTF_Font* font, const char* text,
+                               int x, int y, SDL_Color color) {
+    return glyph_atlas_draw_text_n(renderer, font, text, text ? (int)strlen(text) : 0, x, y, color);
+}
+
+SDL_Texture* glyph_atlas_render_texture(SDL_Renderer* renderer, TTF_Font* font, const char* text,
+                                        SDL_Color color, int* w, int* h) {
+    int text_w, text_h;
+    glyph_atlas_size_text(renderer, font, text, &text_w, &text_h);
+    if (w) *w = text_w;
+    if (h) *h = text_h;
+    if (text_w <= 0 || text_h <= 0) return NULL;
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                                             SDL_TEXTUREACCESS_TARGET, text_w, text_h);
+    if (!texture) return NULL;
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    // Draw into the texture without disturbing the caller's target or draw state
+    SDL_Texture* previous_target = SDL_GetRenderTarget(renderer);
+    Uint8 r, g, b, a;
+    SDL_BlendMode blend;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_GetRenderDrawBlendMode(renderer, &blend);
+
+    if (SDL_SetRenderTarget(renderer, texture) != 0) {
+        SDL_DestroyTexture(texture);
+        return NULL;
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    glyph_atlas_draw_text(renderer, font, text, 0, 0, color);
+
+    SDL_SetRenderTarget(renderer, previous_target);
+    SDL_SetRenderDrawBlendMode(renderer, blend);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+    return texture;
+}
+
+void glyph_atlas_size_text(SDL_Renderer* renderer, TTF_Font* font, const char* text, int* w, int* h) {
+    GlyphAtlas* atlas = glyph_atlas_get(renderer, font);
+    int width = 0;
+    if (atlas && text) {
+        for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+            width += atlas->glyphs[*p].advance;
+        }
+    }
+    if (w) *w = width;
+    if (h) *h = atlas ? atlas->line_height : 0;
+}
+
+void glyph_atlas_shutdown(void) {
+    for (int i = 0; i < atlas_count; i++) {
+        glyph_atlas_release(&atlases[i]);
+    }
+    atlas_count = 0;
+    free(batch_vertices);
+    free(batch_indices);
+    batch_vertices = NULL;
+    batch_indices = NULL;
+    batch_capacity = 0;
+}
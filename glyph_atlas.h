@@ -0,0 +1,34 @@
+#ifndef MICROOS_GLYPH_ATLAS_H
+#define MICROOS_GLYPH_ATLAS_H
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#define GLYPH_ATLAS_FIRST_CHAR 32   // First Latin-1 code rasterized into the atlas
+#define GLYPH_ATLAS_LAST_CHAR 255   // Last Latin-1 code rasterized into the atlas
+#define GLYPH_ATLAS_WIDTH 512       // Atlas rows wrap at this many pixels
+#define GLYPH_ATLAS_MAX_FONTS 4     // Distinct renderer/font pairs kept alive at once
+
+// Draws Latin-1 text with its top-left corner at (x, y). All glyphs come from a
+// single atlas texture that is built the first time a renderer/font pair is seen,
+// and the whole string is submitted as one batch of textured quads.
+// Returns the area covered by the text.
+SDL_Rect glyph_atlas_draw_text(SDL_Renderer* renderer, TTF_Font* font, const char* text,
+                               int x, int y, SDL_Color color);
+
+// Same as glyph_atlas_draw_text but only draws the first 'length' bytes of text.
+SDL_Rect glyph_atlas_draw_text_n(SDL_Renderer* renderer, TTF_Font* font, const char* text,
+                                 int length, int x, int y, SDL_Color color);
+
+// Rasterizes text once into its own transparent texture so callers can keep it
+// across frames. Returns NULL for empty text or if render targets are unsupported.
+SDL_Texture* glyph_atlas_render_texture(SDL_Renderer* renderer, TTF_Font* font, const char* text,
+                                        SDL_Color color, int* w, int* h);
+
+// Measures text as glyph_atlas_draw_text would draw it, without drawing anything.
+void glyph_atlas_size_text(SDL_Renderer* renderer, TTF_Font* font, const char* text, int* w, int* h);
+
+// Releases all atlas textures. Call before destroying the renderer or closing fonts.
+void glyph_atlas_shutdown(void);
+
+#endif // MICROOS_GLYPH_ATLAS_H
@@ -0,0 +1,186 @@
+#include "history.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int history_bucket(unsigned char a, unsigned char b) {
+    return ((unsigned int)a * 31u + b) & (HISTORY_BUCKETS - 1);
+}
+
+static void history_reset(History* history) {
+    history->log_used = 0;
+    history->count = 0;
+    for (int i = 0; i < HISTORY_BUCKETS; i++) {
+        history->buckets[i].count = 0;
+    }
+}
+
+void history_init(History* history, FileSystem* fs) {
+    memset(history, 0, sizeof(History));
+    history->fs = fs;
+}
+
+void history_free(History* history) {
+    free(history->log);
+    free(history->offsets);
+    for (int i = 0; i < HISTORY_BUCKETS; i++) {
+        free(history->buckets[i].ids);
+    }
+    memset(history, 0, sizeof(History));
+}
+
+// Adds one entry to the log and the search index, without persisting it
+static void history_append(History* history, const char* line, size_t length) {
+    if (history->log_used + length + 1 > history->log_capacity) {
+        while (history->log_used + length + 1 > history->log_capacity) {
+            history->log_capacity = history->log_capacity ? history->log_capacity * 2 : 4096;
+        }
+        history->log = realloc(history->log, history->log_capacity);
+    }
+    if (history->count == history->capacity) {
+        history->capacity = history->capacity ? history->capacity * 2 : 256;
+        history->offsets = realloc(history->offsets, sizeof(Uint32) * history->capacity);
+    }
+
+    int id = history->count++;
+    history->offsets[id] = (Uint32)history->log_used;
+    memcpy(history->log + history->log_used, line, length);
+    history->log[history->log_used + length] = '\0';
+    history->log_used += length + 1;
+
+    for (size_t i = 0; i + 1 < length; i++) {
+        HistoryPostings* postings = &history->buckets[history_bucket(line[i], line[i + 1])];
+        if (postings->count > 0 && postings->ids[postings->count - 1] == id) continue;
+        if (postings->count == postings->capacity) {
+            postings->capacity = postings->capacity ? postings->capacity * 2 : 16;
+            postings->ids = realloc(postings->ids, sizeof(int) * postings->capacity);
+        }
+        postings->ids[postings->count++] = id;
+    }
+}
+
+// Keeps the newest half once the log is full. Ids shift, so the index is rebuilt.
+static void history_compact(History* history) {
+    int keep_from = history->count / 2;
+    size_t start = history->offsets[keep_from];
+    size_t kept_bytes = history->log_used - start;
+    char* kept = malloc(kept_bytes);
+    memcpy(kept, history->log + start, kept_bytes);
+
+    history_reset(history);
+    for (size_t pos = 0; pos < kept_bytes;) {
+        size_t length = strlen(kept + pos);
+        history_append(history, kept + pos, length);
+        pos += length + 1;
+    }
+    free(kept);
+}
+
+// Rewrites the history file with the newest entries that fill half of it, so
+// the appends that follow have room before the next rewrite.
+static void history_rewrite_file(History* history) {
+    size_t budget = HISTORY_FILE_SIZE / 2;
+    size_t used = 0;
+    int first = history->count;
+    while (first > 0) {
+        size_t length = strlen(history_get(history, first - 1)) + 1;
+        if (used + length > budget) break;
+        used += length;
+        first--;
+    }
+
+    char* content = malloc(used + 1);
+    if (!content) return;
+    size_t pos = 0;
+    for (int i = first; i < history->count; i++) {
+        const char* entry = history_get(history, i);
+        size_t length = strlen(entry);
+        memcpy(content + pos, entry, length);
+        content[pos + length] = '\n';
+        pos += length + 1;
+    }
+    content[pos] = '\0';
+    fs_write_file(history->fs, HISTORY_FILE, content);
+    free(content);
+}
+
+void history_load(History* history) {
+    history_reset(history);
+    if (!history->fs) return;
+
+    const char* content = fs_read_file(history->fs, HISTORY_FILE);
+    if (!content) return;
+    while (*content) {
+        const char* newline = strchr(content, '\n');
+        size_t length = newline ? (size_t)(newline - content) : strlen(content);
+        if (length > 0) history_append(history, content, length);
+        content += length + (newline ? 1 : 0);
+    }
+}
+
+void history_add(History* history, const char* line) {
+    size_t length = strlen(line);
+    if (length == 0) return;
+    if (history->count > 0 && strcmp(history_get(history, history->count - 1), line) == 0) return;
+
+    if (history->count >= HISTORY_MAX_ENTRIES) {
+        history_compact(history);
+    }
+    history_append(history, line, length);
+
+    if (!history->fs) return;
+    FileNode* file = fs_get_file(history->fs, HISTORY_FILE);
+    if (!file) {
+        file = fs_create_file(history->fs, HISTORY_FILE, false);
+        if (!file) return;
+    }
+    // Appending is the common case; the file is only rewritten when it fills up
+    if (file->size + length + 1 < HISTORY_FILE_SIZE) {
+        // One append, so a crash never leaves an entry without its newline
+        char* entry = malloc(length + 1);
+        if (!entry) return;
+        memcpy(entry, line, length);
+        entry[length] = '\n';
+        fs_append_file(history->fs, HISTORY_FILE, entry, length + 1);
+        free(entry);
+    } else {
+        history_rewrite_file(history);
+    }
+}
+
+const char* history_get(const History* history, int index) {
+    if (index < 0 || index >= history->count) return NULL;
+    return history->log + history->offsets[index];
+}
+
+int history_search(const History* history, const char* query, int before) {
+    size_t length = strlen(query);
+    if (before > history->count) before = history->count;
+    if (length < 2) {
+        // Too short for the index: walk the log backwards
+        for (int id = before - 1; id >= 0; id--) {
+            if (strstr(history_get(history, id), query)) return id;
+        }
+        return -1;
+    }
+
+    // Only entries in the smallest bucket of the query's bigrams can match
+    const HistoryPostings* best = NULL;
+    for (size_t i = 0; i + 1 < length; i++) {
+        const HistoryPostings* postings = &history->buckets[history_bucket(query[i], query[i + 1])];
+        if (!best || postings->count < best->count) best = postings;
+    }
+
+    // Binary search for the newest candidate older than 'before'
+    int low = 0;
+    int high = best->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (best->ids[mid] < before) low = mid + 1;
+        else high = mid;
+    }
+    for (int i = low - 1; i >= 0; i--) {
+        int id = best->ids[i];
+        if (strstr(history_get(history, id), query)) return id;
+    }
+    return -1;
+}
@@ -0,0 +1,51 @@
+#ifndef MICROOS_HISTORY_H
+#define MICROOS_HISTORY_H
+
+#include "filesystem.h"
+#include <SDL.h>
+
+#define HISTORY_MAX_ENTRIES 100000       // Oldest half is dropped beyond this
+#define HISTORY_BUCKETS 4096             // Hash buckets of the bigram search index (power of two)
+#define HISTORY_FILE "/home/.history"    // Where the log is persisted in the VFS
+#define HISTORY_FILE_SIZE (64 * 1024)    // The file is rewritten to half this once full
+
+// Entry ids containing a given character pair, in ascending order
+typedef struct {
+    int* ids;
+    int count;
+    int capacity;
+} HistoryPostings;
+
+// Append-only command log. Entries are stored back to back in one buffer and
+// located through an offset table, so entry i is one lookup away. Searches go
+// through a bigram index: each bucket lists the entries containing a pair of
+// characters that hashes there, newest last.
+typedef struct {
+    char* log;                           // NUL-terminated entries, oldest first
+    size_t log_used;
+    size_t log_capacity;
+    Uint32* offsets;                     // Start of each entry in log
+    int count;
+    int capacity;
+    HistoryPostings buckets[HISTORY_BUCKETS];
+    FileSystem* fs;                      // Where the log is persisted (may be NULL)
+} History;
+
+void history_init(History* history, FileSystem* fs);
+void history_free(History* history);
+
+// Replaces the in-memory log with the entries saved in HISTORY_FILE.
+void history_load(History* history);
+
+// Appends a command, skipping blanks and repeats of the last entry, and
+// persists it to HISTORY_FILE.
+void history_add(History* history, const char* line);
+
+// Entry 'index' counted from the oldest, or NULL.
+const char* history_get(const History* history, int index);
+
+// Newest entry older than 'before' that contains query, or -1. Pass
+// history->count to search from the newest entry.
+int history_search(const History* history, const char* query, int before);
+
+#endif // MICROOS_HISTORY_H
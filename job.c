@@ -0,0 +1,186 @@
+#include "job.h"
+#include "terminal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Job jobs[JOB_MAX];
+
+// Worker side of the queue. Waits while the ring is full so a chatty job is
+// throttled to the rate the frame loop drains it.
+static void job_sink(CommandStream* stream, const char* line, size_t length) {
+    Job* job = stream->user;
+    unsigned int tail = (unsigned int)SDL_AtomicGet(&job->tail);
+    while (tail - (unsigned int)SDL_AtomicGet(&job->head) >= JOB_QUEUE_SIZE) {
+        if (SDL_AtomicGet(&job->cancel)) {
+            stream->closed = true;
+            return;
+        }
+        SDL_Delay(1);
+    }
+
+    char* copy = malloc(length + 1);
+    if (!copy) return;
+    memcpy(copy, line, length);
+    copy[length] = '\0';
+    job->queue[tail & (JOB_QUEUE_SIZE - 1)] = copy;
+    SDL_MemoryBarrierRelease();  // Publish the slot before the new tail
+    SDL_AtomicSet(&job->tail, (int)(tail + 1));
+}
+
+static int job_thread(void* data) {
+    Job* job = data;
+    // Each pipeline stage takes its own read section
+    CommandContext ctx = {job->term, job->term->fs, &job->out, NULL, false, &job->cancel};
+    job->status = command_run_line(&ctx, job->command);
+    command_stream_flush(&job->out);
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&job->finished, 1);
+    return 0;
+}
+
+// Consumer side: moves every line queued so far into the terminal
+static void job_drain(Job* job) {
+    unsigned int head = (unsigned int)SDL_AtomicGet(&job->head);
+    unsigned int tail = (unsigned int)SDL_AtomicGet(&job->tail);
+    SDL_MemoryBarrierAcquire();
+    while (head != tail) {
+        char** slot = &job->queue[head & (JOB_QUEUE_SIZE - 1)];
+        terminal_add_line(job->term, *slot);
+        free(*slot);
+        *slot = NULL;
+        head++;
+    }
+    SDL_AtomicSet(&job->head, (int)head);
+}
+
+int job_start(Terminal* term, const char* command) {
+    Job* job = NULL;
+    int id = 1;
+    for (int i = 0; i < JOB_MAX; i++) {
+        if (jobs[i].id == 0) {
+            if (!job) job = &jobs[i];
+        } else if (jobs[i].id >= id) {
+            id = jobs[i].id + 1;
+        }
+    }
+    if (!job) return 0;
+
+    memset(job, 0, sizeof(Job));
+    snprintf(job->command, sizeof(job->command), "%s", command);
+    job->term = term;
+    command_stream_init(&job->out, job_sink, job);
+    job->thread = SDL_CreateThread(job_thread, "microos-job", job);
+    if (!job->thread) return 0;
+    job->id = id;
+    return id;
+}
+
+void job_poll(void) {
+    for (int i = 0; i < JOB_MAX; i++) {
+        Job* job = &jobs[i];
+        if (job->id == 0) continue;
+
+        // Read the flag first so the drain below sees every line queued before it
+        bool finished = SDL_AtomicGet(&job->finished) != 0;
+        job_drain(job);
+        if (!finished) continue;
+
+        SDL_WaitThread(job->thread, NULL);
+        char line[COMMAND_LINE_LENGTH + 32];
+        if (SDL_AtomicGet(&job->cancel)) {
+            if (job->foreground) {
+                snprintf(line, sizeof(line), "^C");
+            } else {
+                snprintf(line, sizeof(line), "[%d] Cancelled  %s", job->id, job->command);
+            }
+            terminal_add_line(job->term, line);
+        } else if (!job->foreground) {
+            if (job->status == 0) {
+                snprintf(line, sizeof(line), "[%d] Done  %s", job->id, job->command);
+            } else {
+                snprintf(line, sizeof(line), "[%d] Exit %d  %s", job->id, job->status, job->command);
+            }
+            terminal_add_line(job->term, line);
+        }
+        job->id = 0;
+    }
+}
+
+Job* job_foreground(void) {
+    for (int i = 0; i < JOB_MAX; i++) {
+        if (jobs[i].id != 0 && jobs[i].foreground) return &jobs[i];
+    }
+    return NULL;
+}
+
+void job_cancel(Job* job) {
+    SDL_AtomicSet(&job->cancel, 1);
+}
+
+void job_shutdown(void) {
+    for (int i = 0; i < JOB_MAX; i++) {
+        if (jobs[i].id != 0) job_cancel(&jobs[i]);
+    }
+    for (int i = 0; i < JOB_MAX; i++) {
+        Job* job = &jobs[i];
+        if (job->id == 0) continue;
+        SDL_WaitThread(job->thread, NULL);
+        for (int j = 0; j < JOB_QUEUE_SIZE; j++) {
+            free(job->queue[j]);
+        }
+        job->id = 0;
+    }
+}
+
+static int job_cmd_jobs(CommandContext* ctx, int argc, char** argv) {
+    if (!command_require_foreground(ctx, argv[0])) return 1;
+    for (int i = 0; i < JOB_MAX; i++) {
+        Job* job = &jobs[i];
+        if (job->id == 0) continue;
+        command_printf(ctx, "[%d] %s  %s", job->id,
+                       SDL_AtomicGet(&job->finished) ? "Done   " : "Running", job->command);
+    }
+    return 0;
+}
+
+static int job_cmd_fg(CommandContext* ctx, int argc, char** argv) {
+    if (!command_require_foreground(ctx, argv[0])) return 1;
+
+    // Default to the most recently started job
+    Job* target = NULL;
+    int id = argc > 1 ? atoi(argv[1][0] == '%' ? argv[1] + 1 : argv[1]) : 0;
+    for (int i = 0; i < JOB_MAX; i++) {
+        Job* job = &jobs[i];
+        if (job->id == 0) continue;
+        if (id ? job->id == id : (!target || job->id > target->id)) target = job;
+    }
+    if (!target) {
+        command_print(ctx, "fg: no such job");
+        return 1;
+    }
+    // The terminal holds input until the job ends or Ctrl-C cancels it
+    target->foreground = true;
+    command_print(ctx, target->command);
+    return 0;
+}
+
+static int job_cmd_sleep(CommandContext* ctx, int argc, char** argv) {
+    if (argc < 2) {
+        command_print(ctx, "Usage: sleep <seconds>");
+        return 1;
+    }
+    Uint32 end = SDL_GetTicks() + (Uint32)(atof(argv[1]) * 1000.0);
+    while ((Sint32)(end - SDL_GetTicks()) > 0) {
+        if (command_cancelled(ctx)) return 1;
+        fs_read_quiesce(ctx->fs);  // Holds nothing, so never keeps memory from being freed
+        SDL_Delay(10);
+    }
+    return 0;
+}
+
+void job_register_commands(void) {
+    command_register("jobs", "jobs", "List background jobs", job_cmd_jobs);
+    command_register("fg", "fg [id]", "Wait for a background job (Ctrl-C cancels)", job_cmd_fg);
+    command_register("sleep", "sleep <seconds>", "Wait; useful with &", job_cmd_sleep);
+}
@@ -0,0 +1,50 @@
+#ifndef MICROOS_JOB_H
+#define MICROOS_JOB_H
+
+#include "command.h"
+#include <SDL.h>
+
+#define JOB_MAX 8                 // Background jobs that can run at once
+#define JOB_QUEUE_SIZE 256        // Output lines buffered per job (power of two)
+
+struct Terminal;
+
+// A command line running on its own worker thread. Output lines travel to the
+// main thread through a single-producer/single-consumer ring: the worker only
+// advances tail, the main thread only advances head.
+typedef struct Job {
+    int id;                       // Shown as [id]; 0 when the slot is free
+    char command[COMMAND_LINE_LENGTH];
+    struct Terminal* term;
+    SDL_Thread* thread;
+    CommandStream out;            // Worker side: turns output into queued lines
+    char* queue[JOB_QUEUE_SIZE];  // Heap copies of lines, freed by the consumer
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+    SDL_atomic_t cancel;          // Set by Ctrl-C or shutdown
+    SDL_atomic_t finished;        // Set by the worker after its last line is queued
+    int status;
+    bool foreground;
+} Job;
+
+// Starts a command line on a worker thread. Returns the job id, or 0 if all
+// job slots are busy.
+int job_start(struct Terminal* term, const char* command);
+
+// Main-thread pump, called once per frame: moves queued output into the
+// terminal and reaps finished jobs.
+void job_poll(void);
+
+// The job the terminal is waiting on after fg, or NULL.
+Job* job_foreground(void);
+
+// Asks a job to stop. Commands see it through command_cancelled.
+void job_cancel(Job* job);
+
+// Cancels every job and waits for the workers. Call before the terminal goes away.
+void job_shutdown(void);
+
+// Registers jobs, fg and sleep.
+void job_register_commands(void);
+
+#endif // MICROOS_JOB_H
@@ -13,6 +13,17 @@
 #include "settings_menu.h"  // Add new settings menu header
 #include "bios.h"       // New header for bios_restart
 #include "drivers.h"  // Ensure the drivers header is included near the top
+#include "glyph_atlas.h"  // Shared glyph atlas used for all text drawing
+#include "command.h"      // Terminal command table and text filters
+#include "job.h"          // Background terminal jobs
+#include "script.h"       // Script interpreter behind the run builtin
+#include "fsimage.h"      // On-disk filesystem image
+#include "fsjournal.h"    // Crash recovery for changes made since the last save
+#include "fssnapshot.h"   // Copy-on-write restore points
+#include "fsstore.h"      // Deduplicated file bodies
+#include "fswatch.h"      // Change notifications for the filesystem
+#include "fsmount.h"      // Host directories in the filesystem
+#include "fsfind.h"       // Parallel find and glob matching
 
 // OS State
 typedef enum
@@ -71,9 +82,6 @@ SettingsUIState settings_ui_state = {0};
 // New global flag (set according to command–line, default false)
 bool running_on_raw_hardware = false;
 
-// Prototype for new external media detection function.
-bool fs_detect_external_media(FileSystem* fs);
-
 // Function to calculate the total height of the settings content
 int calculate_settings_content_height(void) {
     int height = 60;  // Initial offset
@@ -198,22 +206,7 @@ void draw_taskbar(SDL_Renderer *renderer, TTF_Font *font)
 
     // Render "Start" text
     SDL_Color textColor = {255, 255, 255, 255};
-    SDL_Surface *textSurface = TTF_RenderText_Solid(font, "Start", textColor);
-    if (textSurface != NULL)
-    {
-        SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        if (textTexture != NULL)
-        {
-            SDL_Rect textRect = {startButtonRect.x + 5, startButtonRect.y + 5, textSurface->w, textSurface->h};
-            SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-            SDL_DestroyTexture(textTexture);
-        }
-        SDL_FreeSurface(textSurface);
-    }
-    else
-    {
-        fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-    }
+    glyph_atlas_draw_text(renderer, font, "Start", startButtonRect.x + 5, startButtonRect.y + 5, textColor);
 
     // Draw clock
     time_t now = time(NULL);
@@ -221,22 +214,7 @@ void draw_taskbar(SDL_Renderer *renderer, TTF_Font *font)
     char timeString[9];
     strftime(timeString, sizeof(timeString), "%H:%M:%S", timeinfo);
 
-    textSurface = TTF_RenderText_Solid(font, timeString, textColor);
-    if (textSurface != NULL)
-    {
-        SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        if (textTexture != NULL)
-        {
-            SDL_Rect clockRect = {260, 290, textSurface->w, textSurface->h};
-            SDL_RenderCopy(renderer, textTexture, NULL, &clockRect);
-            SDL_DestroyTexture(textTexture);
-        }
-        SDL_FreeSurface(textSurface);
-    }
-    else
-    {
-        fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-    }
+    glyph_atlas_draw_text(renderer, font, timeString, 260, 290, textColor);
 }
 
 void draw_terminal_icon(SDL_Renderer* renderer, SDL_Rect icon_rect) {
@@ -331,26 +309,12 @@ void draw_desktop(SDL_Renderer *renderer, TTF_Font *font, Application *apps, int
         }
 
         // Draw icon text
-        SDL_Surface *textSurface = TTF_RenderText_Solid(font, apps[i].name, textColor);
-        if (textSurface != NULL)
-        {
-            SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-            if (textTexture != NULL)
-            {
-                SDL_Rect textRect = {
-                    apps[i].icon.x + (apps[i].icon.w - textSurface->w) / 2,
-                    apps[i].icon.y + apps[i].icon.h + 5,
-                    textSurface->w,
-                    textSurface->h};
-                SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-                SDL_DestroyTexture(textTexture);
-            }
-            SDL_FreeSurface(textSurface);
-        }
-        else
-        {
-            fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-        }
+        int text_w;
+        glyph_atlas_size_text(renderer, font, apps[i].name, &text_w, NULL);
+        glyph_atlas_draw_text(renderer, font, apps[i].name,
+                              apps[i].icon.x + (apps[i].icon.w - text_w) / 2,
+                              apps[i].icon.y + apps[i].icon.h + 5,
+                              textColor);
     }
 }
 
@@ -362,22 +326,9 @@ void draw_boot_sequence(SDL_Renderer *renderer, TTF_Font *font, int progress, un
 
     // OS Name
     SDL_Color textColor = {255, 255, 255, 255};
-    SDL_Surface *textSurface = TTF_RenderText_Solid(font, "MicroOS 1.0", textColor);
-    if (textSurface != NULL)
-    {
-        SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        if (textTexture != NULL)
-        {
-            SDL_Rect textRect = {(320 - textSurface->w) / 2, 50, textSurface->w, textSurface->h};
-            SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-            SDL_DestroyTexture(textTexture);
-        }
-        SDL_FreeSurface(textSurface);
-    }
-    else
-    {
-        fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-    }
+    int text_w;
+    glyph_atlas_size_text(renderer, font, "MicroOS 1.0", &text_w, NULL);
+    glyph_atlas_draw_text(renderer, font, "MicroOS 1.0", (320 - text_w) / 2, 50, textColor);
 
     // Progress bar border
     SDL_Rect progressBorderRect = {60, 100, 200, 20};
@@ -392,44 +343,16 @@ void draw_boot_sequence(SDL_Renderer *renderer, TTF_Font *font, int progress, un
     // Progress text
     char progressText[10];
     sprintf(progressText, "%d%%", progress);
-    textSurface = TTF_RenderText_Solid(font, progressText, textColor);
-    if (textSurface != NULL)
-    {
-        SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        if (textTexture != NULL)
-        {
-            SDL_Rect progressTextRect = {(320 - textSurface->w) / 2, 130, textSurface->w, textSurface->h};
-            SDL_RenderCopy(renderer, textTexture, NULL, &progressTextRect);
-            SDL_DestroyTexture(textTexture);
-        }
-        SDL_FreeSurface(textSurface);
-    }
-    else
-    {
-        fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-    }
+    glyph_atlas_size_text(renderer, font, progressText, &text_w, NULL);
+    glyph_atlas_draw_text(renderer, font, progressText, (320 - text_w) / 2, 130, textColor);
 
     // Display the memory visualization during boot as a sort of "hardware check"
     render_display_memory(renderer, display_memory);
 
     // Add some loading text
     const char *loadingText = "Checking hardware...";
-    textSurface = TTF_RenderText_Solid(font, loadingText, textColor);
-    if (textSurface != NULL)
-    {
-        SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        if (textTexture != NULL)
-        {
-            SDL_Rect loadingTextRect = {(320 - textSurface->w) / 2, 200, textSurface->w, textSurface->h};
-            SDL_RenderCopy(renderer, textTexture, NULL, &loadingTextRect);
-            SDL_DestroyTexture(textTexture);
-        }
-        SDL_FreeSurface(textSurface);
-    }
-    else
-    {
-        fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-    }
+    glyph_atlas_size_text(renderer, font, loadingText, &text_w, NULL);
+    glyph_atlas_draw_text(renderer, font, loadingText, (320 - text_w) / 2, 200, textColor);
 }
 
 // Update function declaration to include apps parameter
@@ -447,22 +370,7 @@ void draw_app(SDL_Renderer *renderer, TTF_Font *font, const char *appName, SDL_C
 
     // App title
     SDL_Color textColor = {255, 255, 255, 255};
-    SDL_Surface *textSurface = TTF_RenderText_Solid(font, appName, textColor);  // Add textColor argument
-    if (textSurface != NULL)
-    {
-        SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        if (textTexture != NULL)
-        {
-            SDL_Rect textRect = {5, 2, textSurface->w, textSurface->h};
-            SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-            SDL_DestroyTexture(textTexture);
-        }
-        SDL_FreeSurface(textSurface);
-    }
-    else
-    {
-        fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-    }
+    glyph_atlas_draw_text(renderer, font, appName, 5, 2, textColor);
 
     // Close button
     SDL_Rect closeButtonRect = {295, 0, 25, 25};
@@ -507,22 +415,7 @@ void draw_app(SDL_Renderer *renderer, TTF_Font *font, const char *appName, SDL_C
                 SDL_RenderFillRect(renderer, &optionRect);
 
                 SDL_Color optionText = {0, 0, 0, 255};
-                SDL_Surface *textSurface = TTF_RenderText_Solid(font, options[i], optionText);
-                if (textSurface != NULL)
-                {
-                    SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-                    if (textTexture != NULL)
-                    {
-                        SDL_Rect textRect = {45, 65 + i * 40, textSurface->w, textSurface->h};
-                        SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-                        SDL_DestroyTexture(textTexture);
-                    }
-                    SDL_FreeSurface(textSurface);
-                }
-                else
-                {
-                    fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-                }
+                glyph_atlas_draw_text(renderer, font, options[i], 45, 65 + i * 40, optionText);
             }
         }
     }
@@ -590,19 +483,10 @@ void draw_start_menu(SDL_Renderer* renderer, TTF_Font* font) {
             draw_rounded_rect_with_shadow(renderer, itemRect, 5, itemColor);
 
             // Text
-            SDL_Surface* textSurface = TTF_RenderText_Solid(font, menuItems[i], textColor);
-            if (textSurface) {
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, textSurface);
-                SDL_Rect textRect = {
-                    itemRect.x + 10,
-                    itemRect.y + (itemRect.h - textSurface->h) / 2,
-                    textSurface->w,
-                    textSurface->h
-                };
-                SDL_RenderCopy(renderer, texture, NULL, &textRect);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(textSurface);
-            }
+            int text_h;
+            glyph_atlas_size_text(renderer, font, menuItems[i], NULL, &text_h);
+            glyph_atlas_draw_text(renderer, font, menuItems[i],
+                                  itemRect.x + 10, itemRect.y + (itemRect.h - text_h) / 2, textColor);
         }
     }
 }
@@ -615,14 +499,7 @@ void draw_settings_page(SDL_Renderer* renderer, TTF_Font* font, SDL_Rect content
 
         // Resolution selector
         const char* resolutions[] = {"144p", "360p", "480p", "720p", "1080p"};
-        SDL_Surface* surface = TTF_RenderText_Solid(font, "Resolution:", textColor);
-        if (surface) {
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_Rect textRect = {content_area.x + 10, y, surface->w, surface->h};
-            SDL_RenderCopy(renderer, texture, NULL, &textRect);
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(surface);
-        }
+        glyph_atlas_draw_text(renderer, font, "Resolution:", content_area.x + 10, y, textColor);
         y += 30;
 
         for (int i = 0; i < 5; i++) {
@@ -633,27 +510,13 @@ void draw_settings_page(SDL_Renderer* renderer, TTF_Font* font, SDL_Rect content
                 app->settings.resolution == i ? 200 : 230, 255);
             SDL_RenderFillRect(renderer, &button);
 
-            surface = TTF_RenderText_Solid(font, resolutions[i], textColor);
-            if (surface) {
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_Rect textRect = {button.x + 5, button.y + 5, surface->w, surface->h};
-                SDL_RenderCopy(renderer, texture, NULL, &textRect);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(surface);
-            }
+            glyph_atlas_draw_text(renderer, font, resolutions[i], button.x + 5, button.y + 5, textColor);
             y += 35;
         }
 
         // Theme selector
         y += 20;
-        surface = TTF_RenderText_Solid(font, "Color Theme:", textColor);
-        if (surface) {
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_Rect textRect = {content_area.x + 10, y, surface->w, surface->h};
-            SDL_RenderCopy(renderer, texture, NULL, &textRect);
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(surface);
-        }
+        glyph_atlas_draw_text(renderer, font, "Color Theme:", content_area.x + 10, y, textColor);
         y += 30;
 
         const char* themes[] = {"Default", "Cyan", "Grayscale"};
@@ -665,27 +528,13 @@ void draw_settings_page(SDL_Renderer* renderer, TTF_Font* font, SDL_Rect content
                 app->settings.theme == i ? 200 : 230, 255);
             SDL_RenderFillRect(renderer, &button);
 
-            surface = TTF_RenderText_Solid(font, themes[i], textColor);
-            if (surface) {
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_Rect textRect = {button.x + 5, button.y + 5, surface->w, surface->h};
-                SDL_RenderCopy(renderer, texture, NULL, &textRect);
-                SDL_DestroyTexture(texture);
-                SDL_FreeSurface(surface);
-            }
+            glyph_atlas_draw_text(renderer, font, themes[i], button.x + 5, button.y + 5, textColor);
             y += 35;
         }
 
         // UI Scale slider
         y += 20;
-        surface = TTF_RenderText_Solid(font, "UI Scale:", textColor);
-        if (surface) {
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_Rect textRect = {content_area.x + 10, y, surface->w, surface->h};
-            SDL_RenderCopy(renderer, texture, NULL, &textRect);
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(surface);
-        }
+        glyph_atlas_draw_text(renderer, font, "UI Scale:", content_area.x + 10, y, textColor);
         y += 30;
 
         // Draw slider
@@ -700,14 +549,7 @@ void draw_settings_page(SDL_Renderer* renderer, TTF_Font* font, SDL_Rect content
 
         char scaleText[32];
         snprintf(scaleText, sizeof(scaleText), "%.0f%%", app->settings.ui_scale * 100);
-        surface = TTF_RenderText_Solid(font, scaleText, textColor);
-        if (surface) {
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_Rect textRect = {content_area.x + 220, y - 5, surface->w, surface->h};
-            SDL_RenderCopy(renderer, texture, NULL, &textRect);
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(surface);
-        }
+        glyph_atlas_draw_text(renderer, font, scaleText, content_area.x + 220, y - 5, textColor);
     }
 }
 
@@ -722,6 +564,11 @@ void reset_temporary_data(Application* apps) {
         editor_reset(apps[2].editor);
     }
     
+    // Restore the filesystem if a boot snapshot was taken
+    if (apps[2].fs) {
+        fs_snapshot_rollback(apps[2].fs, FS_SNAPSHOT_BOOT);
+    }
+
     // Reset settings UI state
     settings_ui_state = (SettingsUIState){0};
     showSettingsSidebar = false;
@@ -735,19 +582,9 @@ void draw_settings_section(SDL_Renderer* renderer, TTF_Font* font, SDL_Rect* rec
 
     // Draw title
     SDL_Color text_color = {255, 255, 255, 255};
-    SDL_Surface* surface = TTF_RenderText_Solid(font, title, text_color);
-    if (surface) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_Rect text_rect = {
-            rect->x + 10,
-            rect->y + (rect->h - surface->h) / 2,
-            surface->w,
-            surface->h
-        };
-        SDL_RenderCopy(renderer, texture, NULL, &text_rect);
-        SDL_DestroyTexture(texture);
-        SDL_FreeSurface(surface);
-    }
+    int text_h;
+    glyph_atlas_size_text(renderer, font, title, NULL, &text_h);
+    glyph_atlas_draw_text(renderer, font, title, rect->x + 10, rect->y + (rect->h - text_h) / 2, text_color);
 
     // Draw expand/collapse arrow
     int arrow_size = 10;
@@ -891,7 +728,12 @@ int main(int argc, char *argv[])
     apps[2].icon = (SDL_Rect){240, 40, 50, 50};
     apps[2].color = (SDL_Color){255, 255, 255, 255};
 
-    FileSystem* fs = fs_init();
+    // Reopen the saved filesystem; the sample tree is only for the first run
+    FileSystem* fs = fs_image_open(FS_IMAGE_FILE);
+    if (!fs) fs = fs_init();
+    if (!fs_journal_open(fs, FS_JOURNAL_FILE)) {
+        printf("Failed to open %s; changes will only be saved on exit\n", FS_JOURNAL_FILE);
+    }
     apps[2].fs = fs;  // Assign to Files app
 
     // After initializing apps array:
@@ -899,6 +741,18 @@ int main(int argc, char *argv[])
     apps[2].fileui = fileui_create(fs);
     apps[2].editor = editor_create();
 
+    // Populate the terminal's command table
+    terminal_register_commands();
+    command_register_filters();
+    job_register_commands();
+    script_register_commands();
+    fs_register_commands();
+    fs_journal_register_commands();
+    fs_snapshot_register_commands();
+    fs_store_register_commands();
+    fs_mount_register_commands();
+    fs_find_register_commands();
+
     OSState currentState = OS_STATE_BOOT;
     int bootProgress = 0;
     bool showMenu = false;
@@ -923,6 +777,8 @@ int main(int argc, char *argv[])
 
     while (running)
     {
+        // A frame is one read section: nodes it holds outlive jobs' deletes
+        fs_read_begin(fs);
         while (SDL_PollEvent(&e))
         {
             if (e.type == SDL_QUIT)
@@ -1038,6 +894,16 @@ int main(int argc, char *argv[])
             }
             else if (e.type == SDL_KEYDOWN && currentState == OS_STATE_APP1) {
                 terminal_handle_keypress(apps[0].terminal, &e.key);
+                if (apps[0].terminal->reboot_requested) {
+                    apps[0].terminal->reboot_requested = false;
+                    if (running_on_raw_hardware) {
+                        bios_restart();
+                    } else {
+                        reset_temporary_data(apps);
+                        currentState = OS_STATE_BOOT;
+                        bootProgress = 0;
+                    }
+                }
             }
             else if (e.type == SDL_MOUSEWHEEL && currentState == OS_STATE_APP1) {
                 terminal_handle_mouse(apps[0].terminal, &e.wheel);
@@ -1141,6 +1007,13 @@ int main(int argc, char *argv[])
             }
         }
 
+        // Move output from background jobs into the terminal
+        job_poll();
+        fs_journal_poll(fs, FS_IMAGE_FILE);  // Folds a large journal back into the image
+        fs_store_poll(fs->store);            // Compresses file bodies left unread
+        fs_mount_poll(fs);                   // Applies host changes to mounted directories
+        fs_watch_poll(fs);                   // Tells watchers what changed since the last frame
+
         // Update logic
         Uint32 currentTime = SDL_GetTicks();
         if (currentTime - lastTime >= 16)
@@ -1156,6 +1029,10 @@ int main(int argc, char *argv[])
                 {
                     currentState = OS_STATE_DESKTOP;
                     snprintf(notification, sizeof(notification), "MicroOS Started!");
+                    // A host "external" directory shows up as a drive
+                    if (fs_mount(fs, FS_MEDIA_DIR, FS_MEDIA_PATH)) {
+                        snprintf(notification, sizeof(notification), "External media connected!");
+                    }
                     notificationTime = time(NULL);
                 }
             }
@@ -1164,12 +1041,6 @@ int main(int argc, char *argv[])
             frameCount++;
         }
 
-        // Update external media detection once per frame
-        if (fs_detect_external_media(fs)) {
-            snprintf(notification, sizeof(notification), "External media connected!");
-            notificationTime = time(NULL);
-        }
-
         // Rendering
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
@@ -1224,36 +1095,32 @@ int main(int argc, char *argv[])
 
             // Draw notification text
             SDL_Color notifTextColor = {255, 255, 255, 255};
-            SDL_Surface *textSurface = TTF_RenderText_Solid(font, notification, notifTextColor);
-            if (textSurface != NULL)
-            {
-                SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-                if (textTexture != NULL)
-                {
-                    SDL_Rect textRect = {
-                        (320 - textSurface->w) / 2,
-                        (notifRect.y + (notifRect.h - textSurface->h) / 2),
-                        textSurface->w,
-                        textSurface->h};
-                    SDL_RenderCopy(renderer, textTexture, NULL, &textRect);
-                    SDL_DestroyTexture(textTexture);
-                }
-                SDL_FreeSurface(textSurface);
-            }
-            else
-            {
-                fprintf(stderr, "TTF_RenderText_Solid Error: %s\n", TTF_GetError());
-            }
+            int notif_w, notif_h;
+            glyph_atlas_size_text(renderer, font, notification, &notif_w, &notif_h);
+            glyph_atlas_draw_text(renderer, font, notification,
+                                  (320 - notif_w) / 2,
+                                  notifRect.y + (notifRect.h - notif_h) / 2,
+                                  notifTextColor);
             SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
         }
 
         SDL_RenderPresent(renderer);
+        fs_read_end(fs);
+        fs_reclaim(fs);  // Frees what jobs and commands unlinked, now no frame holds it
 
         // Cap frame rate
         SDL_Delay(16); // ~60 FPS
     }
 
     // Cleanup
+    job_shutdown();  // Workers write into the terminal, so stop them first
+    script_cache_clear();
+    if (!fs_journal_checkpoint(fs, FS_IMAGE_FILE)) {
+        printf("Failed to save filesystem to %s\n", FS_IMAGE_FILE);
+    }
+    fs_journal_close(fs);
+    terminal_destroy(apps[0].terminal);  // Frees cached line textures before the renderer goes away
+    glyph_atlas_shutdown();  // Atlas textures belong to the renderer and font
     TTF_CloseFont(font);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
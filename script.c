@@ -0,0 +1,636 @@
+#include "script.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compiled scripts, shared by the terminal and background jobs
+static Script* script_cache[SCRIPT_CACHE_SIZE];
+static Uint32 script_clock = 0;
+static SDL_SpinLock script_cache_lock = 0;
+
+static void script_free(Script* script) {
+    free(script->code);
+    free(script->strings);
+    free(script);
+}
+
+// Compiler
+
+enum { SCRIPT_BLOCK_IF, SCRIPT_BLOCK_ELSE, SCRIPT_BLOCK_WHILE, SCRIPT_BLOCK_FOR };
+
+typedef struct {
+    int kind;
+    int start;           // Loop head to jump back to
+    int jump;            // Instruction whose target is patched at else/end
+} ScriptBlock;
+
+typedef struct {
+    Script* script;
+    int code_capacity;
+    size_t strings_used;
+    size_t strings_capacity;
+    ScriptBlock blocks[SCRIPT_MAX_BLOCK_DEPTH];
+    int block_count;
+    int loop_count;      // Open for loops, which is also the next loop slot
+    int line;
+    char error[128];
+} ScriptCompiler;
+
+static int script_intern(ScriptCompiler* c, const char* text, size_t length) {
+    size_t needed = c->strings_used + length + 1;
+    if (needed > c->strings_capacity) {
+        while (needed > c->strings_capacity) {
+            c->strings_capacity = c->strings_capacity ? c->strings_capacity * 2 : 256;
+        }
+        c->script->strings = realloc(c->script->strings, c->strings_capacity);
+    }
+    int offset = (int)c->strings_used;
+    memcpy(c->script->strings + offset, text, length);
+    c->script->strings[offset + length] = '\0';
+    c->strings_used = needed;
+    return offset;
+}
+
+static int script_emit(ScriptCompiler* c, ScriptOp op, int a, int b) {
+    Script* script = c->script;
+    if (script->count == c->code_capacity) {
+        c->code_capacity = c->code_capacity ? c->code_capacity * 2 : 32;
+        script->code = realloc(script->code, sizeof(ScriptInstr) * c->code_capacity);
+    }
+    script->code[script->count] = (ScriptInstr){(Uint8)op, 0, (Uint16)c->line, a, b, -1};
+    return script->count++;
+}
+
+static bool script_fail(ScriptCompiler* c, const char* message) {
+    snprintf(c->error, sizeof(c->error), "line %d: %s", c->line, message);
+    return false;
+}
+
+static bool script_push_block(ScriptCompiler* c, int kind, int start, int jump) {
+    if (c->block_count == SCRIPT_MAX_BLOCK_DEPTH) return script_fail(c, "blocks nested too deeply");
+    c->blocks[c->block_count++] = (ScriptBlock){kind, start, jump};
+    return true;
+}
+
+static size_t script_name_length(const char* text) {
+    size_t length = 0;
+    if (!isalpha((unsigned char)text[0]) && text[0] != '_') return 0;
+    while (isalnum((unsigned char)text[length]) || text[length] == '_') length++;
+    return length;
+}
+
+// A variable name must fill the whole word and fit in ScriptVar
+static bool script_valid_name(const char* text, size_t length) {
+    return length > 0 && length < 32 && script_name_length(text) == length;
+}
+
+// Splits "word rest" and returns rest with leading blanks skipped
+static char* script_split_word(char* text, size_t* word_length) {
+    char* rest = text;
+    while (*rest && !isspace((unsigned char)*rest)) rest++;
+    *word_length = (size_t)(rest - text);
+    while (isspace((unsigned char)*rest)) rest++;
+    return rest;
+}
+
+static bool script_word_is(const char* word, size_t length, const char* keyword) {
+    return strlen(keyword) == length && strncmp(word, keyword, length) == 0;
+}
+
+// Compiles "NAME value" for set and let
+static bool script_compile_assign(ScriptCompiler* c, ScriptOp op, char* rest) {
+    size_t name_length;
+    char* value = script_split_word(rest, &name_length);
+    if (!script_valid_name(rest, name_length)) {
+        return script_fail(c, "expected a variable name");
+    }
+    script_emit(c, op, script_intern(c, rest, name_length), script_intern(c, value, strlen(value)));
+    return true;
+}
+
+static bool script_compile_line(ScriptCompiler* c, char* text) {
+    Script* script = c->script;
+    size_t word_length;
+    char* rest = script_split_word(text, &word_length);
+
+    if (script_word_is(text, word_length, "if") || script_word_is(text, word_length, "while")) {
+        if (!*rest) return script_fail(c, "missing condition");
+        int start = script->count;
+        int test = script_emit(c, SCRIPT_OP_TEST, script_intern(c, rest, strlen(rest)), -1);
+        int kind = script_word_is(text, word_length, "if") ? SCRIPT_BLOCK_IF : SCRIPT_BLOCK_WHILE;
+        return script_push_block(c, kind, start, test);
+    }
+    if (script_word_is(text, word_length, "else")) {
+        ScriptBlock* block = c->block_count ? &c->blocks[c->block_count - 1] : NULL;
+        if (!block || block->kind != SCRIPT_BLOCK_IF) return script_fail(c, "else without if");
+        int jump = script_emit(c, SCRIPT_OP_JUMP, -1, -1);
+        script->code[block->jump].target = script->count;
+        block->jump = jump;
+        block->kind = SCRIPT_BLOCK_ELSE;
+        return true;
+    }
+    if (script_word_is(text, word_length, "for")) {
+        size_t name_length, in_length;
+        char* after_name = script_split_word(rest, &name_length);
+        char* words = script_split_word(after_name, &in_length);
+        if (!script_valid_name(rest, name_length) ||
+            !script_word_is(after_name, in_length, "in")) {
+            return script_fail(c, "expected: for NAME in words...");
+        }
+        if (c->loop_count == SCRIPT_MAX_LOOP_DEPTH) return script_fail(c, "for loops nested too deeply");
+
+        int init = script_emit(c, SCRIPT_OP_FOR_INIT, -1, script_intern(c, words, strlen(words)));
+        int start = script_emit(c, SCRIPT_OP_FOR_NEXT, script_intern(c, rest, name_length), -1);
+        script->code[init].slot = (Uint8)c->loop_count;
+        script->code[start].slot = (Uint8)c->loop_count;
+        c->loop_count++;
+        return script_push_block(c, SCRIPT_BLOCK_FOR, start, start);
+    }
+    if (script_word_is(text, word_length, "end")) {
+        if (c->block_count == 0) return script_fail(c, "end without a block");
+        ScriptBlock block = c->blocks[--c->block_count];
+        if (block.kind == SCRIPT_BLOCK_WHILE || block.kind == SCRIPT_BLOCK_FOR) {
+            int jump = script_emit(c, SCRIPT_OP_JUMP, -1, -1);
+            script->code[jump].target = block.start;
+            if (block.kind == SCRIPT_BLOCK_FOR) c->loop_count--;
+        }
+        script->code[block.jump].target = script->count;
+        return true;
+    }
+    if (script_word_is(text, word_length, "set")) {
+        return script_compile_assign(c, SCRIPT_OP_SET, rest);
+    }
+    if (script_word_is(text, word_length, "let")) {
+        return script_compile_assign(c, SCRIPT_OP_LET, rest);
+    }
+    if (script_word_is(text, word_length, "exit")) {
+        script_emit(c, SCRIPT_OP_EXIT, *rest ? script_intern(c, rest, strlen(rest)) : -1, -1);
+        return true;
+    }
+
+    // NAME=value
+    size_t name_length = script_name_length(text);
+    if (name_length > 0 && name_length < 32 && text[name_length] == '=') {
+        const char* value = text + name_length + 1;
+        script_emit(c, SCRIPT_OP_SET, script_intern(c, text, name_length), script_intern(c, value, strlen(value)));
+        return true;
+    }
+
+    script_emit(c, SCRIPT_OP_RUN, script_intern(c, text, strlen(text)), -1);
+    return true;
+}
+
+// Parses a whole script into instructions. Returns NULL and fills error on a
+// syntax error.
+static Script* script_compile(const char* content, size_t size, char* error, size_t error_size) {
+    ScriptCompiler c;
+    memset(&c, 0, sizeof(c));
+    c.script = calloc(1, sizeof(Script));
+
+    const char* p = content;
+    const char* end = content + size;
+    bool ok = true;
+    while (ok && p < end) {
+        const char* newline = memchr(p, '\n', end - p);
+        const char* line_end = newline ? newline : end;
+        c.line++;
+
+        char line[COMMAND_LINE_LENGTH];
+        size_t length = (size_t)(line_end - p);
+        if (length >= sizeof(line)) {
+            ok = script_fail(&c, "line too long");
+            break;
+        }
+        memcpy(line, p, length);
+        line[length] = '\0';
+        p = newline ? newline + 1 : end;
+
+        // Trim, then skip blank lines and comments
+        while (length > 0 && isspace((unsigned char)line[length - 1])) line[--length] = '\0';
+        char* text = line;
+        while (isspace((unsigned char)*text)) text++;
+        if (*text == '\0' || *text == '#') continue;
+
+        ok = script_compile_line(&c, text);
+    }
+    if (ok && c.block_count > 0) {
+        c.line = c.script->code[c.blocks[c.block_count - 1].jump].line;
+        ok = script_fail(&c, "block is missing its end");
+    }
+
+    if (!ok) {
+        snprintf(error, error_size, "%s", c.error);
+        script_free(c.script);
+        return NULL;
+    }
+
+    // Trim the growth slack; compiled scripts stay cached
+    Script* script = c.script;
+    if (script->count > 0) {
+        script->code = realloc(script->code, sizeof(ScriptInstr) * script->count);
+    }
+    if (c.strings_used > 0) {
+        script->strings = realloc(script->strings, c.strings_used);
+    }
+    return script;
+}
+
+// Cache
+
+// Returns a compiled script with a reference held, compiling only on a miss
+static Script* script_acquire(FileSystem* fs, FileNode* file, char* error, size_t error_size) {
+    char path[MAX_PATH];
+    fs_node_path(file, path, sizeof(path));
+
+    SDL_AtomicLock(&script_cache_lock);
+    for (int i = 0; i < SCRIPT_CACHE_SIZE; i++) {
+        Script* script = script_cache[i];
+        if (script && script->generation == fs_get_generation(file) && strcmp(script->path, path) == 0) {
+            script->refs++;
+            script->last_used = ++script_clock;
+            SDL_AtomicUnlock(&script_cache_lock);
+            return script;
+        }
+    }
+    SDL_AtomicUnlock(&script_cache_lock);
+
+    // Taken before the body, so a write racing the compile leaves a stale key, not a stale script
+    unsigned generation = fs_get_generation(file);
+    const char* content = fs_file_content(fs, file);
+    if (!content) {
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    Script* script = script_compile(content, strlen(content), error, error_size);
+    if (!script) return NULL;
+    snprintf(script->path, sizeof(script->path), "%s", path);
+    script->generation = generation;
+    script->refs = 1;
+
+    // Replace a stale copy of the same file, else a free slot, else the LRU entry
+    SDL_AtomicLock(&script_cache_lock);
+    int slot = -1;
+    for (int i = 0; i < SCRIPT_CACHE_SIZE && slot < 0; i++) {
+        if (script_cache[i] && strcmp(script_cache[i]->path, path) == 0) slot = i;
+    }
+    for (int i = 0; i < SCRIPT_CACHE_SIZE && slot < 0; i++) {
+        if (!script_cache[i]) slot = i;
+    }
+    if (slot < 0) {
+        slot = 0;
+        for (int i = 1; i < SCRIPT_CACHE_SIZE; i++) {
+            if (script_cache[i]->last_used < script_cache[slot]->last_used) slot = i;
+        }
+    }
+    Script* victim = script_cache[slot];
+    if (victim) {
+        victim->cached = false;
+        if (victim->refs == 0) script_free(victim);
+    }
+    script->cached = true;
+    script->last_used = ++script_clock;
+    script_cache[slot] = script;
+    SDL_AtomicUnlock(&script_cache_lock);
+    return script;
+}
+
+static void script_release(Script* script) {
+    SDL_AtomicLock(&script_cache_lock);
+    script->refs--;
+    bool dead = script->refs == 0 && !script->cached;
+    SDL_AtomicUnlock(&script_cache_lock);
+    if (dead) script_free(script);
+}
+
+void script_cache_clear(void) {
+    SDL_AtomicLock(&script_cache_lock);
+    for (int i = 0; i < SCRIPT_CACHE_SIZE; i++) {
+        Script* script = script_cache[i];
+        if (!script) continue;
+        script->cached = false;
+        if (script->refs == 0) script_free(script);
+        script_cache[i] = NULL;
+    }
+    SDL_AtomicUnlock(&script_cache_lock);
+}
+
+// Interpreter
+
+typedef struct {
+    char name[32];
+    char value[SCRIPT_VALUE_LENGTH];
+} ScriptVar;
+
+typedef struct {
+    char buffer[COMMAND_LINE_LENGTH];
+    char* words[COMMAND_MAX_ARGS + 1];
+    int count;
+    int next;
+} ScriptLoop;
+
+typedef struct {
+    const Script* script;
+    CommandContext ctx;  // Copy of the caller's context, one level deeper
+    int argc;
+    char** argv;
+    int status;
+    ScriptVar vars[SCRIPT_MAX_VARS];
+    int var_count;
+    ScriptLoop loops[SCRIPT_MAX_LOOP_DEPTH];
+} ScriptRun;
+
+static ScriptVar* script_find_var(ScriptRun* run, const char* name, size_t length) {
+    for (int i = 0; i < run->var_count; i++) {
+        if (strlen(run->vars[i].name) == length && strncmp(run->vars[i].name, name, length) == 0) {
+            return &run->vars[i];
+        }
+    }
+    return NULL;
+}
+
+static bool script_set_var(ScriptRun* run, const char* name, const char* value) {
+    ScriptVar* var = script_find_var(run, name, strlen(name));
+    if (!var) {
+        if (run->var_count == SCRIPT_MAX_VARS) return false;
+        var = &run->vars[run->var_count++];
+        snprintf(var->name, sizeof(var->name), "%s", name);
+    }
+    snprintf(var->value, sizeof(var->value), "%s", value);
+    return true;
+}
+
+// Resolves $name, $1..$9, $# or $? to its text
+static const char* script_lookup(ScriptRun* run, const char* name, size_t length, char* number) {
+    if (length == 1 && isdigit((unsigned char)name[0])) {
+        int index = name[0] - '0';
+        return index < run->argc ? run->argv[index] : "";
+    }
+    if (length == 1 && (name[0] == '?' || name[0] == '#')) {
+        snprintf(number, 16, "%d", name[0] == '?' ? run->status : run->argc - 1);
+        return number;
+    }
+    ScriptVar* var = script_find_var(run, name, length);
+    return var ? var->value : "";
+}
+
+// Substitutes variables into a command line. Single quotes suppress expansion.
+static void script_expand(ScriptRun* run, const char* text, char* out, size_t size) {
+    size_t used = 0;
+    char quote = 0;
+    const char* p = text;
+    while (*p) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+        }
+
+        if (*p == '$' && quote != '\'') {
+            const char* name = p + 1;
+            size_t length = 0;
+            const char* next = name;
+            if (*name == '{') {
+                const char* close = strchr(name, '}');
+                if (close) {
+                    name++;
+                    length = (size_t)(close - name);
+                    next = close + 1;
+                }
+            } else if (isdigit((unsigned char)*name) || *name == '?' || *name == '#') {
+                length = 1;
+                next = name + 1;
+            } else {
+                length = script_name_length(name);
+                next = name + length;
+            }
+
+            if (length > 0) {
+                char number[16];
+                const char* value = script_lookup(run, name, length, number);
+                size_t value_length = strlen(value);
+                if (used + value_length >= size) value_length = size - used - 1;
+                memcpy(out + used, value, value_length);
+                used += value_length;
+                p = next;
+                continue;
+            }
+        }
+        if (used + 1 < size) out[used++] = *p;
+        p++;
+    }
+    out[used] = '\0';
+}
+
+// Evaluates "a", or "a op b" with op one of + - * / %
+static bool script_arith(const char* text, long* result) {
+    char buffer[COMMAND_LINE_LENGTH];
+    char* words[4];
+    int count = command_parse(text, buffer, sizeof(buffer), words, 4);
+    if (count != 1 && count != 3) return false;
+
+    char* end;
+    long a = strtol(words[0], &end, 10);
+    if (*end) return false;
+    if (count == 1) {
+        *result = a;
+        return true;
+    }
+    long b = strtol(words[2], &end, 10);
+    if (*end || strlen(words[1]) != 1) return false;
+    switch (words[1][0]) {
+        case '+': *result = a + b; return true;
+        case '-': *result = a - b; return true;
+        case '*': *result = a * b; return true;
+        case '/': if (b == 0) return false; *result = a / b; return true;
+        case '%': if (b == 0) return false; *result = a % b; return true;
+    }
+    return false;
+}
+
+// The script holds no nodes between steps, so each one runs outside the
+// read section of the 'run' stage; a long script then never keeps the
+// epoch from advancing, and each step's stages take sections of their own
+static int script_run_step(CommandContext* ctx, const char* line) {
+    fs_read_end(ctx->fs);
+    int status = command_run_line(ctx, line);
+    fs_read_begin(ctx->fs);
+    return status;
+}
+
+static int script_execute(ScriptRun* run) {
+    const Script* script = run->script;
+    const char* strings = script->strings;
+    CommandContext* ctx = &run->ctx;
+    char line[COMMAND_LINE_LENGTH];
+    long steps = 0;
+    int pc = 0;
+
+    while (pc < script->count) {
+        const ScriptInstr* instr = &script->code[pc++];
+        if (++steps > SCRIPT_MAX_STEPS) {
+            command_printf(ctx, "run: %s: stopped after %d steps", script->path, SCRIPT_MAX_STEPS);
+            return 1;
+        }
+        if (command_cancelled(ctx)) return 1;
+        fs_read_quiesce(ctx->fs);  // Steps hold no nodes
+
+        switch (instr->op) {
+            case SCRIPT_OP_RUN:
+                script_expand(run, strings + instr->a, line, sizeof(line));
+                run->status = script_run_step(ctx, line);
+                break;
+            case SCRIPT_OP_TEST:
+                script_expand(run, strings + instr->a, line, sizeof(line));
+                run->status = script_run_step(ctx, line);
+                if (run->status != 0) pc = instr->target;
+                break;
+            case SCRIPT_OP_JUMP:
+                pc = instr->target;
+                break;
+            case SCRIPT_OP_SET:
+            case SCRIPT_OP_LET: {
+                script_expand(run, strings + instr->b, line, sizeof(line));
+                if (instr->op == SCRIPT_OP_LET) {
+                    long value;
+                    if (!script_arith(line, &value)) {
+                        command_printf(ctx, "run: %s:%d: bad expression '%s'", script->path, instr->line, line);
+                        return 1;
+                    }
+                    snprintf(line, sizeof(line), "%ld", value);
+                }
+                if (!script_set_var(run, strings + instr->a, line)) {
+                    command_printf(ctx, "run: %s:%d: too many variables", script->path, instr->line);
+                    return 1;
+                }
+                break;
+            }
+            case SCRIPT_OP_FOR_INIT: {
+                ScriptLoop* loop = &run->loops[instr->slot];
+                script_expand(run, strings + instr->b, line, sizeof(line));
+                loop->count = command_parse(line, loop->buffer, sizeof(loop->buffer), loop->words, COMMAND_MAX_ARGS);
+                loop->next = 0;
+                break;
+            }
+            case SCRIPT_OP_FOR_NEXT: {
+                ScriptLoop* loop = &run->loops[instr->slot];
+                if (loop->next >= loop->count) {
+                    pc = instr->target;
+                } else if (!script_set_var(run, strings + instr->a, loop->words[loop->next++])) {
+                    command_printf(ctx, "run: %s:%d: too many variables", script->path, instr->line);
+                    return 1;
+                }
+                break;
+            }
+            case SCRIPT_OP_EXIT:
+                if (instr->a >= 0) {
+                    script_expand(run, strings + instr->a, line, sizeof(line));
+                    return atoi(line);
+                }
+                return run->status;
+        }
+    }
+    return run->status;
+}
+
+int script_run_file(CommandContext* ctx, const char* path, int argc, char** argv) {
+    if (ctx->script_depth >= SCRIPT_MAX_DEPTH) {
+        command_printf(ctx, "run: %s: scripts nested too deeply", path);
+        return 1;
+    }
+    FileNode* file = fs_get_file(ctx->fs, path);
+    if (!file || file->is_directory) {
+        command_printf(ctx, "run: %s: File not found or cannot be read.", path);
+        return 1;
+    }
+
+    char error[128];
+    Script* script = script_acquire(ctx->fs, file, error, sizeof(error));
+    if (!script) {
+        command_printf(ctx, "run: %s: %s", path, error);
+        return 2;
+    }
+
+    ScriptRun* run = calloc(1, sizeof(ScriptRun));
+    run->script = script;
+    run->ctx = *ctx;
+    run->ctx.state = NULL;
+    run->ctx.done = false;
+    run->ctx.script_depth++;
+    run->argc = argc;
+    run->argv = argv;
+    int status = script_execute(run);
+    free(run);
+
+    script_release(script);
+    return status;
+}
+
+// Builtins
+
+static int script_cmd_run(CommandContext* ctx, int argc, char** argv) {
+    if (argc < 2) {
+        command_print(ctx, "Usage: run <file> [args...]");
+        return 1;
+    }
+    return script_run_file(ctx, argv[1], argc - 1, argv + 1);
+}
+
+static int script_cmd_true(CommandContext* ctx, int argc, char** argv) {
+    return 0;
+}
+
+static int script_cmd_false(CommandContext* ctx, int argc, char** argv) {
+    return 1;
+}
+
+// test EXPR: -e/-f/-d PATH, -z/-n STRING, A = B, A != B, A -eq/-ne/-lt/-le/-gt/-ge B,
+// or a lone STRING (true if non-empty). A leading ! negates.
+static int script_cmd_test(CommandContext* ctx, int argc, char** argv) {
+    bool negate = argc > 1 && strcmp(argv[1], "!") == 0;
+    char** args = argv + 1 + negate;
+    int count = argc - 1 - negate;
+    bool result;
+
+    if (count == 1) {
+        result = args[0][0] != '\0';
+    } else if (count == 2 && args[0][0] == '-') {
+        FileNode* node = fs_get_file(ctx->fs, args[1]);
+        switch (args[0][1]) {
+            case 'e': result = node != NULL; break;
+            case 'f': result = node && !node->is_directory; break;
+            case 'd': result = node && node->is_directory; break;
+            case 'z': result = args[1][0] == '\0'; break;
+            case 'n': result = args[1][0] != '\0'; break;
+            default:
+                command_printf(ctx, "test: unknown operator %s", args[0]);
+                return 2;
+        }
+    } else if (count == 3) {
+        const char* op = args[1];
+        long a = strtol(args[0], NULL, 10);
+        long b = strtol(args[2], NULL, 10);
+        if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) result = strcmp(args[0], args[2]) == 0;
+        else if (strcmp(op, "!=") == 0) result = strcmp(args[0], args[2]) != 0;
+        else if (strcmp(op, "-eq") == 0) result = a == b;
+        else if (strcmp(op, "-ne") == 0) result = a != b;
+        else if (strcmp(op, "-lt") == 0) result = a < b;
+        else if (strcmp(op, "-le") == 0) result = a <= b;
+        else if (strcmp(op, "-gt") == 0) result = a > b;
+        else if (strcmp(op, "-ge") == 0) result = a >= b;
+        else {
+            command_printf(ctx, "test: unknown operator %s", op);
+            return 2;
+        }
+    } else {
+        result = false;
+    }
+    return result != negate ? 0 : 1;
+}
+
+void script_register_commands(void) {
+    command_register("run", "run <file>", "Run a script of commands", script_cmd_run);
+    command_register("test", "test <expr>", "Check a condition for if/while", script_cmd_test);
+    command_register("true", "true", "Succeed", script_cmd_true);
+    command_register("false", "false", "Fail", script_cmd_false);
+}
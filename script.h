@@ -0,0 +1,67 @@
+#ifndef MICROOS_SCRIPT_H
+#define MICROOS_SCRIPT_H
+
+#include "command.h"
+#include <SDL.h>
+
+#define SCRIPT_CACHE_SIZE 16        // Compiled scripts kept between runs
+#define SCRIPT_MAX_VARS 64          // Variables one run may define
+#define SCRIPT_VALUE_LENGTH 256     // Longest variable value
+#define SCRIPT_MAX_LOOP_DEPTH 8     // Nested for loops
+#define SCRIPT_MAX_BLOCK_DEPTH 32   // Nested if/while/for blocks
+#define SCRIPT_MAX_DEPTH 8          // Nested run calls
+#define SCRIPT_MAX_STEPS 1000000    // Instructions one run may execute
+
+// Script syntax, one statement per line ('#' starts a comment):
+//   NAME=value | set NAME value    assign (values are expanded)
+//   let NAME a + b                 integer arithmetic (+ - * / %)
+//   if <command> / else / end      branch on the command's status
+//   while <command> / end
+//   for NAME in words... / end
+//   exit [status]
+//   anything else runs as a command line after $NAME / ${NAME} expansion.
+// $1..$9 are the script arguments, $# their count and $? the last status.
+typedef enum {
+    SCRIPT_OP_RUN,       // Expand a and run it as a command line
+    SCRIPT_OP_SET,       // Variable a = expanded b
+    SCRIPT_OP_LET,       // Variable a = arithmetic on expanded b
+    SCRIPT_OP_TEST,      // Run a; jump to target if it fails
+    SCRIPT_OP_JUMP,      // Jump to target
+    SCRIPT_OP_FOR_INIT,  // Expand b into the word list of loop 'slot'
+    SCRIPT_OP_FOR_NEXT,  // Variable a = next word of loop 'slot', or jump to target
+    SCRIPT_OP_EXIT       // Stop with the expanded status in a (or the last status)
+} ScriptOp;
+
+typedef struct {
+    Uint8 op;
+    Uint8 slot;          // For-loop nesting level
+    Uint16 line;         // Source line, for error messages
+    int a;               // Offsets into the string pool, -1 if unused
+    int b;
+    int target;          // Jump target instruction
+} ScriptInstr;
+
+// A script compiled once into a flat instruction list plus one string pool
+typedef struct Script {
+    char path[MAX_PATH];
+    unsigned generation; // Cache key together with path: the file's generation when compiled
+    ScriptInstr* code;
+    int count;
+    char* strings;
+    Uint32 last_used;
+    int refs;            // Runs in progress; an evicted script is freed at zero
+    bool cached;
+} Script;
+
+// Runs a script from the virtual filesystem, compiling it only if the cached
+// copy is missing or stale. argv[0] is the script path. Returns the status.
+// Called from a handler; steps run outside its read section.
+int script_run_file(CommandContext* ctx, const char* path, int argc, char** argv);
+
+// Drops every cached compilation.
+void script_cache_clear(void);
+
+// Registers run, test, true and false.
+void script_register_commands(void);
+
+#endif // MICROOS_SCRIPT_H
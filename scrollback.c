@@ -0,0 +1,175 @@
+#include "scrollback.h"
+#include <stdlib.h>
+#include <string.h>
+
+void scrollback_init(Scrollback* sb, int max_lines, int max_chunks) {
+    memset(sb, 0, sizeof(Scrollback));
+    sb->lines = malloc(sizeof(ScrollbackLine) * max_lines);
+    sb->capacity = max_lines;
+    sb->max_chunks = max_chunks < 2 ? 2 : max_chunks;
+}
+
+static void scrollback_free_chunk_list(ScrollbackChunk* chunk) {
+    while (chunk) {
+        ScrollbackChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void scrollback_free(Scrollback* sb) {
+    scrollback_free_chunk_list(sb->oldest_chunk);
+    scrollback_free_chunk_list(sb->free_chunks);
+    free(sb->lines);
+    memset(sb, 0, sizeof(Scrollback));
+}
+
+// Returns an emptied chunk to the free list, or frees it if it was oversized
+static void scrollback_recycle_chunk(Scrollback* sb, ScrollbackChunk* chunk) {
+    if (chunk->capacity > SCROLLBACK_CHUNK_SIZE) {
+        free(chunk);
+        return;
+    }
+    chunk->used = 0;
+    chunk->live_lines = 0;
+    chunk->next = sb->free_chunks;
+    sb->free_chunks = chunk;
+}
+
+void scrollback_clear(Scrollback* sb) {
+    ScrollbackChunk* chunk = sb->oldest_chunk;
+    while (chunk) {
+        ScrollbackChunk* next = chunk->next;
+        scrollback_recycle_chunk(sb, chunk);
+        chunk = next;
+    }
+    sb->oldest_chunk = NULL;
+    sb->newest_chunk = NULL;
+    sb->first_seq += sb->count;
+    sb->head = 0;
+    sb->count = 0;
+}
+
+// Recycles chunks at the old end of the FIFO that no line points into anymore.
+// Lines are allocated in order, so only the oldest chunks can ever become empty.
+static void scrollback_release_empty_chunks(Scrollback* sb) {
+    while (sb->oldest_chunk && sb->oldest_chunk != sb->newest_chunk &&
+           sb->oldest_chunk->live_lines == 0) {
+        ScrollbackChunk* chunk = sb->oldest_chunk;
+        sb->oldest_chunk = chunk->next;
+        scrollback_recycle_chunk(sb, chunk);
+    }
+}
+
+// Drops the oldest line in O(1)
+static void scrollback_evict_oldest(Scrollback* sb) {
+    if (sb->count == 0) return;
+
+    ScrollbackChunk* chunk = sb->lines[sb->head].chunk;
+    sb->head = (sb->head + 1) % sb->capacity;
+    sb->count--;
+    sb->first_seq++;
+
+    chunk->live_lines--;
+    if (chunk->live_lines == 0) {
+        scrollback_release_empty_chunks(sb);
+    }
+}
+
+static void scrollback_link_chunk(Scrollback* sb, ScrollbackChunk* chunk) {
+    chunk->next = NULL;
+    if (sb->newest_chunk) {
+        sb->newest_chunk->next = chunk;
+    } else {
+        sb->oldest_chunk = chunk;
+    }
+    sb->newest_chunk = chunk;
+    scrollback_release_empty_chunks(sb);
+}
+
+// Makes room for 'size' bytes at the end of the newest chunk
+static ScrollbackChunk* scrollback_reserve(Scrollback* sb, size_t size) {
+    ScrollbackChunk* chunk = sb->newest_chunk;
+    if (chunk && chunk->capacity - chunk->used >= size) return chunk;
+
+    // A lone line bigger than a chunk gets a chunk of its own
+    if (size > SCROLLBACK_CHUNK_SIZE) {
+        chunk = malloc(sizeof(ScrollbackChunk) + size);
+        if (!chunk) return NULL;
+        chunk->used = 0;
+        chunk->capacity = size;
+        chunk->live_lines = 0;
+        scrollback_link_chunk(sb, chunk);
+        return chunk;
+    }
+
+    // Out of budget: evict old lines until their chunk becomes reusable
+    while (!sb->free_chunks && sb->chunk_count >= sb->max_chunks && sb->count > 0) {
+        scrollback_evict_oldest(sb);
+    }
+
+    if (sb->free_chunks) {
+        chunk = sb->free_chunks;
+        sb->free_chunks = chunk->next;
+    } else {
+        chunk = malloc(sizeof(ScrollbackChunk) + SCROLLBACK_CHUNK_SIZE);
+        if (!chunk) return NULL;
+        chunk->capacity = SCROLLBACK_CHUNK_SIZE;
+        sb->chunk_count++;
+    }
+    chunk->used = 0;
+    chunk->live_lines = 0;
+    scrollback_link_chunk(sb, chunk);
+    return chunk;
+}
+
+const char* scrollback_push(Scrollback* sb, const char* text, int length) {
+    if (length < 0) length = 0;
+    if (sb->count == sb->capacity) {
+        scrollback_evict_oldest(sb);
+    }
+
+    ScrollbackChunk* chunk = scrollback_reserve(sb, (size_t)length + 1);
+    if (!chunk) return NULL;
+
+    char* dest = chunk->data + chunk->used;
+    memcpy(dest, text, length);
+    dest[length] = '\0';
+    chunk->used += (size_t)length + 1;
+    chunk->live_lines++;
+
+    ScrollbackLine* line = &sb->lines[(sb->head + sb->count) % sb->capacity];
+    line->text = dest;
+    line->length = length;
+    line->chunk = chunk;
+    sb->count++;
+    return dest;
+}
+
+int scrollback_append_text(Scrollback* sb, const char* text, size_t length) {
+    if (length == 0) {
+        scrollback_push(sb, "", 0);
+        return 1;
+    }
+
+    int appended = 0;
+    const char* end = text + length;
+    while (text < end) {
+        const char* newline = memchr(text, '\n', end - text);
+        const char* line_end = newline ? newline : end;
+        int line_length = (int)(line_end - text);
+        if (line_length > 0 && text[line_length - 1] == '\r') line_length--;
+
+        scrollback_push(sb, text, line_length);
+        appended++;
+        text = newline ? newline + 1 : end;
+    }
+    return appended;
+}
+
+const char* scrollback_get(const Scrollback* sb, int index, int* length) {
+    if (index < 0 || index >= sb->count) return NULL;
+    const ScrollbackLine* line = &sb->lines[(sb->head + index) % sb->capacity];
+    if (length) *length = line->length;
+    return line->text;
+}
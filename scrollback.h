@@ -0,0 +1,54 @@
+#ifndef MICROOS_SCROLLBACK_H
+#define MICROOS_SCROLLBACK_H
+
+#include <stddef.h>
+
+#define SCROLLBACK_CHUNK_SIZE (64 * 1024)  // Bytes of line text per arena chunk
+
+// Arena chunk holding the bytes of many consecutive lines
+typedef struct ScrollbackChunk {
+    struct ScrollbackChunk* next;  // Next newer chunk
+    size_t used;
+    size_t capacity;
+    int live_lines;                // Lines in the ring still pointing into this chunk
+    char data[];
+} ScrollbackChunk;
+
+typedef struct {
+    const char* text;              // NUL-terminated, stored inside chunk
+    int length;
+    ScrollbackChunk* chunk;
+} ScrollbackLine;
+
+// Ring buffer of lines whose text lives in a FIFO of arena chunks. Appending a
+// line is a bump allocation, and the oldest line is evicted in O(1) when either
+// the ring or the chunk budget is full.
+typedef struct {
+    ScrollbackLine* lines;
+    int capacity;                  // Maximum number of lines kept
+    int head;                      // Ring index of the oldest line
+    int count;
+    unsigned long long first_seq;  // Sequence number of the oldest line (grows on eviction)
+    ScrollbackChunk* oldest_chunk;
+    ScrollbackChunk* newest_chunk;
+    ScrollbackChunk* free_chunks;  // Emptied chunks kept for reuse
+    int chunk_count;               // Standard-size chunks allocated, in use or free
+    int max_chunks;
+} Scrollback;
+
+void scrollback_init(Scrollback* sb, int max_lines, int max_chunks);
+void scrollback_free(Scrollback* sb);
+void scrollback_clear(Scrollback* sb);
+
+// Appends one line (without newline). Returns the stored copy.
+const char* scrollback_push(Scrollback* sb, const char* text, int length);
+
+// Bulk append: splits text on '\n' (a trailing newline does not add an empty
+// line). Lines are stored unwrapped; wrapping is up to the reader.
+// Returns the number of lines appended.
+int scrollback_append_text(Scrollback* sb, const char* text, size_t length);
+
+// Returns line 'index' counted from the oldest retained line, or NULL.
+const char* scrollback_get(const Scrollback* sb, int index, int* length);
+
+#endif // MICROOS_SCROLLBACK_H
@@ -1,6 +1,7 @@
 #include "settings_menu.h"
 #include "microos.h"  // Include the header file for draw_rounded_rect_with_shadow
 #include "settings.h"
+#include "glyph_atlas.h"
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
@@ -19,14 +20,7 @@ void draw_settings_menu(SDL_Renderer* renderer, TTF_Font* font, SystemSettings*
     draw_rounded_rect_with_shadow(renderer, sidebar, 8, (SDL_Color){60, 60, 80, 255});
     
     // Draw header text
-    SDL_Surface* headerSurf = TTF_RenderText_Solid(font, "Settings", (SDL_Color){255,255,255,255});
-    if(headerSurf) {
-        SDL_Texture* headerTex = SDL_CreateTextureFromSurface(renderer, headerSurf);
-        SDL_Rect headerRect = {10, 10, headerSurf->w, headerSurf->h};
-        SDL_RenderCopy(renderer, headerTex, NULL, &headerRect);
-        SDL_DestroyTexture(headerTex);
-        SDL_FreeSurface(headerSurf);
-    }
+    glyph_atlas_draw_text(renderer, font, "Settings", 10, 10, (SDL_Color){255,255,255,255});
 
     // Draw close button
     SDL_Rect closeButtonRect = {sidebar.w - 30, 10, 20, 20};
@@ -39,40 +33,21 @@ void draw_settings_menu(SDL_Renderer* renderer, TTF_Font* font, SystemSettings*
     // Draw resolution selector
     int y = 50;
     const char* resOptions[] = {"144p", "360p", "480p", "720p", "1080p"};
-    SDL_Surface* label = TTF_RenderText_Solid(font, "Resolution:", (SDL_Color){200,200,200,255});
-    if(label){
-        SDL_Texture* labelTex = SDL_CreateTextureFromSurface(renderer, label);
-        SDL_Rect labelRect = {10, y, label->w, label->h};
-        SDL_RenderCopy(renderer, labelTex, NULL, &labelRect);
-        SDL_DestroyTexture(labelTex);
-        SDL_FreeSurface(label);
-    }
+    glyph_atlas_draw_text(renderer, font, "Resolution:", 10, y, (SDL_Color){200,200,200,255});
     y += 25;
     for(int i = 0; i < 5; i++){
         SDL_Rect btn = {10, y, 120, 25};
         SDL_Color btnColor = (settings->resolution == i) ? (SDL_Color){180,180,220,255} : (SDL_Color){100,100,120,255};
         draw_rounded_rect_with_shadow(renderer, btn, 5, btnColor);
         
-        SDL_Surface* optSurf = TTF_RenderText_Solid(font, resOptions[i], (SDL_Color){255,255,255,255});
-        if(optSurf){
-            SDL_Texture* optTex = SDL_CreateTextureFromSurface(renderer, optSurf);
-            SDL_Rect optRect = {btn.x + 10, btn.y + (btn.h - optSurf->h)/2, optSurf->w, optSurf->h};
-            SDL_RenderCopy(renderer, optTex, NULL, &optRect);
-            SDL_DestroyTexture(optTex);
-            SDL_FreeSurface(optSurf);
-        }
+        int optH;
+        glyph_atlas_size_text(renderer, font, resOptions[i], NULL, &optH);
+        glyph_atlas_draw_text(renderer, font, resOptions[i], btn.x + 10, btn.y + (btn.h - optH)/2, (SDL_Color){255,255,255,255});
         y += 35;
     }
     
     // Draw UI Scale slider
-    SDL_Surface* scaleLabel = TTF_RenderText_Solid(font, "UI Scale:", (SDL_Color){200,200,200,255});
-    if(scaleLabel){
-        SDL_Texture* scaleTex = SDL_CreateTextureFromSurface(renderer, scaleLabel);
-        SDL_Rect scaleRect = {10, y, scaleLabel->w, scaleLabel->h};
-        SDL_RenderCopy(renderer, scaleTex, NULL, &scaleRect);
-        SDL_DestroyTexture(scaleTex);
-        SDL_FreeSurface(scaleLabel);
-    }
+    glyph_atlas_draw_text(renderer, font, "UI Scale:", 10, y, (SDL_Color){200,200,200,255});
     y += 25;
     SDL_Rect slider = {10, y, 100, 8};
     SDL_SetRenderDrawColor(renderer, 150, 150, 150, 255);
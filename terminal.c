@@ -1,75 +1,330 @@
 #include "terminal.h" // Include the terminal header file
 #include "editor.h"  // Include the editor header file
+#include "glyph_atlas.h" // Shared glyph atlas for text drawing
+#include "command.h" // Command table used to dispatch builtins
+#include "job.h" // Background jobs started with '&'
+#include "trie.h" // Prefix index used by Tab completion
 #include <string.h> // Include string.h for string functions
 #include <stdio.h> // Include stdio.h for standard I/O functions
 #include <stdlib.h> // Include stdlib.h for memory allocation functions
 
+// FNV-1a hash of a line, used to find its rasterized copy in the render cache
+static Uint32 terminal_hash_text(const char* text) {
+    Uint32 hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void terminal_cache_release(TerminalLineCache* entry) {
+    if (entry->texture) SDL_DestroyTexture(entry->texture);
+    free(entry->text);
+    memset(entry, 0, sizeof(TerminalLineCache));
+}
+
+// Drops every rasterized line, e.g. when the renderer or font changes
+static void terminal_cache_flush(Terminal* term) {
+    for (int i = 0; i < TERMINAL_LINE_CACHE_SIZE; i++) {
+        terminal_cache_release(&term->line_cache[i]);
+    }
+    terminal_cache_release(&term->cwd_cache);
+    terminal_cache_release(&term->prompt_cache);
+    term->row_slot_count = -1;  // Force rows to be resolved again
+}
+
+static bool terminal_cache_matches(const TerminalLineCache* entry, const char* text, Uint32 hash, int wrap_width) {
+    return entry->text && entry->hash == hash && entry->wrap_width == wrap_width &&
+           strcmp(entry->text, text) == 0;
+}
+
+static void terminal_cache_store(Terminal* term, TerminalLineCache* entry, SDL_Renderer* renderer, TTF_Font* font,
+                                 const char* text, Uint32 hash, int wrap_width, SDL_Color color) {
+    terminal_cache_release(entry);
+    entry->text = strdup(text);
+    entry->hash = hash;
+    entry->wrap_width = wrap_width;
+    entry->texture = glyph_atlas_render_texture(renderer, font, text, color, &entry->w, &entry->h);
+    entry->last_used = term->render_frame;
+}
+
+// Finds the cache slot holding this line, rasterizing it into the least recently
+// used slot on a miss. Returns -1 if every slot is already in use this frame.
+static int terminal_cache_lookup(Terminal* term, SDL_Renderer* renderer, TTF_Font* font,
+                                 const char* text, int wrap_width, SDL_Color color) {
+    Uint32 hash = terminal_hash_text(text);
+    int victim = -1;
+    for (int i = 0; i < TERMINAL_LINE_CACHE_SIZE; i++) {
+        TerminalLineCache* entry = &term->line_cache[i];
+        if (terminal_cache_matches(entry, text, hash, wrap_width)) {
+            entry->last_used = term->render_frame;
+            return i;
+        }
+        if (entry->last_used == term->render_frame && entry->text) continue;
+        if (victim < 0 || !entry->text ||
+            (term->line_cache[victim].text && entry->last_used < term->line_cache[victim].last_used)) {
+            victim = i;
+        }
+    }
+    if (victim >= 0) {
+        terminal_cache_store(term, &term->line_cache[victim], renderer, font, text, hash, wrap_width, color);
+    }
+    return victim;
+}
+
+// Draws a cached line, falling back to direct atlas drawing if no texture could be made
+static void terminal_cache_draw(SDL_Renderer* renderer, TTF_Font* font, const TerminalLineCache* entry,
+                                int x, int y, SDL_Color color) {
+    if (entry->texture) {
+        SDL_Rect position = {x, y, entry->w, entry->h};
+        SDL_RenderCopy(renderer, entry->texture, NULL, &position);
+    } else if (entry->text && entry->text[0]) {
+        glyph_atlas_draw_text(renderer, font, entry->text, x, y, color);
+    }
+}
+
+// Welcome lines shown at the top of a fresh terminal
+static void terminal_add_banner(Terminal* term) {
+    terminal_add_line(term, "MicroOS Terminal v1.0");
+    terminal_add_line(term, "Type 'help' for available commands");
+}
+
 Terminal* terminal_create(FileSystem* fs) {
     Terminal* term = malloc(sizeof(Terminal));
-    term->line_count = 0;
+    scrollback_init(&term->scrollback, MAX_TERMINAL_LINES, TERMINAL_SCROLLBACK_CHUNKS);
     term->cursor_position = 0;
-    term->scroll_position = 0;
+    term->follow_output = true;
+    term->scroll_seq = 0;
+    term->scroll_row = 0;
+    term->view_version = 0;
     term->fs = fs;
-    term->history_count = 0;
+    history_init(&term->history, fs);
+    history_load(&term->history);
     term->history_position = -1;
+    term->searching = false;
+    term->search_query[0] = '\0';
+    term->search_match = -1;
     term->visible_lines = 0;  // Will be set in render
     term->max_chars_per_line = 0;  // Will be set in render
     term->current_command[0] = '\0';
-    terminal_add_line(term, "MicroOS Terminal v1.0");
-    terminal_add_line(term, "Type 'help' for available commands");
+    memset(term->line_cache, 0, sizeof(term->line_cache));
+    memset(&term->cwd_cache, 0, sizeof(TerminalLineCache));
+    memset(&term->prompt_cache, 0, sizeof(TerminalLineCache));
+    term->rows = NULL;
+    term->row_slots = NULL;
+    term->row_capacity = 0;
+    term->row_slot_count = -1;
+    term->content_version = 0;
+    term->rendered_version = 0;
+    term->rendered_view = 0;
+    term->rendered_wrap = 0;
+    term->rendered_visible = 0;
+    term->render_frame = 0;
+    term->reboot_requested = false;
+    term->cache_renderer = NULL;
+    term->cache_font = NULL;
+    terminal_add_banner(term);
     return term;
 }
 
 void terminal_destroy(Terminal* term) {
-    for (int i = 0; i < term->line_count; ++i) {
-        free(term->lines[i]);
-    }
+    scrollback_free(&term->scrollback);
+    history_free(&term->history);
+    terminal_cache_flush(term);
+    free(term->rows);
+    free(term->row_slots);
     free(term);
 }
 
 void terminal_add_line(Terminal* term, const char* line) {
-    if (term->line_count < MAX_TERMINAL_LINES) {
-        // Word wrap long lines
-        if (term->max_chars_per_line > 0 && strlen(line) > term->max_chars_per_line) {
-            char buffer[MAX_COMMAND_LENGTH];
-            int pos = 0;
-            while (pos < strlen(line)) {
-                int chars_to_copy = term->max_chars_per_line;
-                if (strlen(line + pos) > chars_to_copy) {
-                    // Look for last space within the limit
-                    int last_space = chars_to_copy;
-                    while (last_space > 0 && line[pos + last_space] != ' ') {
-                        last_space--;
-                    }
-                    if (last_space > 0) {
-                        chars_to_copy = last_space;
-                    }
-                } else {
-                    chars_to_copy = strlen(line + pos);
-                }
-                
-                strncpy(buffer, line + pos, chars_to_copy);
-                buffer[chars_to_copy] = '\0';
-                term->lines[term->line_count++] = strdup(buffer);
-                pos += chars_to_copy;
-                if (line[pos] == ' ') pos++; // Skip space
+    terminal_add_text(term, line, strlen(line));
+}
+
+void terminal_add_text(Terminal* term, const char* text, size_t length) {
+    // Lines are copied unwrapped into the scrollback arena and the oldest lines
+    // are evicted once the scrollback is full. Wrapping happens at render time.
+    scrollback_append_text(&term->scrollback, text, length);
+    term->content_version++;
+    // A view scrolled up stays put; terminal_layout follows again once the
+    // bottom is back in view
+    term->view_version++;
+}
+
+// Wrap width in effect; before the first render there is no real width yet
+static int terminal_wrap_width(const Terminal* term) {
+    int width = term->max_chars_per_line;
+    if (width <= 0 || width > TERMINAL_MAX_ROW_CHARS) width = TERMINAL_MAX_ROW_CHARS;
+    return width;
+}
+
+// Lays out the row of a line that begins at 'start', breaking at the last
+// space that fits or mid-word if there is none. Returns where the next row
+// starts, which is 'length' after the last row.
+static int terminal_wrap_row(const char* text, int length, int start, int width, int* row_length) {
+    if (length - start <= width) {
+        *row_length = length - start;
+        return length;
+    }
+    int cut = width;
+    while (cut > 0 && text[start + cut] != ' ') cut--;
+    if (cut == 0) cut = width;
+    *row_length = cut;
+    int next = start + cut;
+    if (text[next] == ' ') next++;  // Skip the space we broke on
+    return next;
+}
+
+// Number of rows a logical line wraps to (an empty line still takes one)
+static int terminal_line_rows(const Terminal* term, int line) {
+    int length;
+    const char* text = scrollback_get(&term->scrollback, line, &length);
+    int width = terminal_wrap_width(term);
+    int rows = 0;
+    int start = 0;
+    do {
+        int row_length;
+        start = terminal_wrap_row(text, length, start, width, &row_length);
+        rows++;
+    } while (start < length);
+    return rows;
+}
+
+// Appends rows first_row.. of a line to term->rows until 'limit' rows are laid out
+static int terminal_layout_line(Terminal* term, int line, int first_row, int count, int limit) {
+    int length;
+    const char* text = scrollback_get(&term->scrollback, line, &length);
+    int width = terminal_wrap_width(term);
+    int start = 0;
+    int row = 0;
+    do {
+        int row_length;
+        int next = terminal_wrap_row(text, length, start, width, &row_length);
+        if (row >= first_row) {
+            if (count == limit) break;
+            term->rows[count++] = (TerminalRow){line, start, row_length};
+        }
+        start = next;
+        row++;
+    } while (start < length);
+    return count;
+}
+
+// Wraps just the lines that are on screen into term->rows. Costs O(visible
+// rows) however long the scrollback is, which is what makes resizing cheap.
+static void terminal_layout(Terminal* term) {
+    const Scrollback* sb = &term->scrollback;
+    int visible = term->visible_lines > 0 ? term->visible_lines : 0;
+    if (term->row_capacity < visible) {
+        term->rows = realloc(term->rows, sizeof(TerminalRow) * visible);
+        term->row_slots = realloc(term->row_slots, sizeof(int) * visible);
+        term->row_capacity = visible;
+    }
+    int count = 0;
+
+    if (!term->follow_output) {
+        // Top-down from the anchor; the oldest lines may have been evicted since
+        int line = 0;
+        int row = 0;
+        if (term->scroll_seq >= sb->first_seq) {
+            line = (int)(term->scroll_seq - sb->first_seq);
+            row = term->scroll_row;
+        }
+        if (line < sb->count) {
+            int rows = terminal_line_rows(term, line);
+            if (row >= rows) row = rows - 1;  // The line wraps to fewer rows after a resize
+            for (; line < sb->count && count < visible; line++, row = 0) {
+                count = terminal_layout_line(term, line, row, count, visible);
             }
+        }
+        // Showing the end of the newest line means we are back at the bottom
+        bool at_end = count < visible;
+        if (count > 0 && term->rows[count - 1].line == sb->count - 1) {
+            int length;
+            scrollback_get(sb, sb->count - 1, &length);
+            at_end = term->rows[count - 1].start + term->rows[count - 1].length == length;
+        }
+        if (at_end) {
+            term->follow_output = true;
+            count = 0;
+        }
+    }
+
+    if (term->follow_output) {
+        // Bottom-up from the newest line, keeping only the rows that fit
+        int top_line = sb->count;
+        int top_row = 0;
+        int needed = visible;
+        while (top_line > 0 && needed > 0) {
+            int rows = terminal_line_rows(term, top_line - 1);
+            top_line--;
+            top_row = rows > needed ? rows - needed : 0;
+            needed -= rows - top_row;
+        }
+        for (int line = top_line, row = top_row; line < sb->count && count < visible; line++, row = 0) {
+            count = terminal_layout_line(term, line, row, count, visible);
+        }
+        // Remember the top so scrolling up starts from what is on screen
+        term->scroll_seq = sb->first_seq + top_line;
+        term->scroll_row = top_row;
+    }
+    term->row_slot_count = count;
+}
+
+// Moves (line, row) one wrapped row up or down. Returns false at either end.
+static bool terminal_step_row(const Terminal* term, int* line, int* row, bool down) {
+    if (down) {
+        if (*row + 1 < terminal_line_rows(term, *line)) {
+            (*row)++;
+        } else if (*line + 1 < term->scrollback.count) {
+            (*line)++;
+            *row = 0;
         } else {
-            term->lines[term->line_count++] = strdup(line);
+            return false;
         }
-        
-        // Auto-scroll to bottom when new line is added
-        if (term->line_count > term->visible_lines) {
-            term->scroll_position = term->line_count - term->visible_lines;
+    } else {
+        if (*row > 0) {
+            (*row)--;
+        } else if (*line > 0) {
+            (*line)--;
+            *row = terminal_line_rows(term, *line) - 1;
+        } else {
+            return false;
         }
     }
+    return true;
 }
 
-void terminal_execute_command(Terminal* term) {
-    if (strlen(term->current_command) > 0) {
-        strcpy(term->command_history[term->history_count], term->current_command);
-        term->history_count = (term->history_count + 1) % MAX_COMMAND_HISTORY;
+void terminal_scroll(Terminal* term, int rows) {
+    const Scrollback* sb = &term->scrollback;
+    if (rows == 0 || sb->count == 0 || term->visible_lines <= 0) return;
+    if (term->follow_output) {
+        if (rows > 0) return;  // Already at the bottom
+        terminal_layout(term);  // Pins the anchor to the current top row
+    }
+
+    int line = 0;
+    int row = 0;
+    if (term->scroll_seq >= sb->first_seq && term->scroll_seq - sb->first_seq < (unsigned long long)sb->count) {
+        line = (int)(term->scroll_seq - sb->first_seq);
+        row = term->scroll_row;
+        int line_rows = terminal_line_rows(term, line);
+        if (row >= line_rows) row = line_rows - 1;
     }
+    for (int i = 0; i < abs(rows); i++) {
+        if (!terminal_step_row(term, &line, &row, rows > 0)) break;
+    }
+    term->scroll_seq = sb->first_seq + line;
+    term->scroll_row = row;
+    term->follow_output = false;
+    term->view_version++;
+    // terminal_layout switches back to following once the bottom is in view
+}
+
+void terminal_execute_command(Terminal* term) {
+    history_add(&term->history, term->current_command);
+    term->history_position = -1;
+    term->follow_output = true;  // Running a command jumps back to the bottom
 
     char cmd[256];
     int written = snprintf(cmd, sizeof(cmd), "> %s", term->current_command);
@@ -78,76 +333,27 @@ void terminal_execute_command(Terminal* term) {
     }
     terminal_add_line(term, cmd);
 
-    char* command = strtok(term->current_command, " ");
-    if (!command) return;
-
-    if (strcmp(command, "help") == 0) {
-        terminal_add_line(term, "Available commands:");
-        terminal_add_line(term, "  ls            - List files in current directory");
-        terminal_add_line(term, "  cd <dir>      - Change directory");
-        terminal_add_line(term, "  cat <file>    - Display file contents");
-        terminal_add_line(term, "  miVo <file>   - Edit file");
-        terminal_add_line(term, "  mkdir <dir>   - Create directory");
-        terminal_add_line(term, "  touch <file>  - Create empty file");
-        terminal_add_line(term, "  clear         - Clear terminal");
-        terminal_add_line(term, "  pwd           - Print working directory");
-        terminal_add_line(term, "  dir           - List files and directories in current directory");
-        terminal_add_line(term, "  nedir <dir>   - Create a new directory");
-        terminal_add_line(term, "  reboot        - Reboots / Restarts the system");
-    } else if (strcmp(command, "view") == 0) {
-        char* file = strtok(NULL, " ");
-        if (file) {
-            terminal_open_file_view(term, file);
-        } else {
-            terminal_add_line(term, "Error: No file specified.");
-        }
-    } else if (strcmp(command, "edit") == 0) {
-        char* file = strtok(NULL, " ");
-        if (file) {
-            terminal_open_file_edit(term, file);
+    // A trailing '&' runs the line on a worker thread instead of this frame
+    char line[MAX_COMMAND_LENGTH];
+    snprintf(line, sizeof(line), "%s", term->current_command);
+    size_t length = strlen(line);
+    while (length > 0 && line[length - 1] == ' ') line[--length] = '\0';
+    if (length > 0 && line[length - 1] == '&') {
+        line[--length] = '\0';
+        while (length > 0 && line[length - 1] == ' ') line[--length] = '\0';
+        int id = job_start(term, line);
+        if (id) {
+            char started[MAX_COMMAND_LENGTH + 16];
+            snprintf(started, sizeof(started), "[%d] %s", id, line);
+            terminal_add_line(term, started);
         } else {
-            terminal_add_line(term, "Error: No file specified.");
+            terminal_add_line(term, "Error: Too many background jobs");
         }
-    } else if (strcmp(command, "ls") == 0 || strcmp(command, "dir") == 0) {
-        FileNode** files;
-        int count;
-        fs_list_directory(term->fs, fs_get_current_path(term->fs), &files, &count);
-        for (int i = 0; i < count; i++) {
-            char info[256];
-            snprintf(info, sizeof(info) - 1, "%s  %s  %s",  // Ensure null-termination
-                    files[i]->name,
-                    fs_format_size(files[i]->size),
-                    fs_format_time(files[i]->modified));
-            terminal_add_line(term, info);
-            if (files[i]->is_directory) {
-                FileNode** sub_files;
-                int sub_count;
-                fs_list_directory(term->fs, files[i]->name, &sub_files, &sub_count);
-                for (int j = 0; j < sub_count; j++) {
-                    snprintf(info, sizeof(info) - 1, "  %s  %s  %s",  // Ensure null-termination
-                            sub_files[j]->name,
-                            fs_format_size(sub_files[j]->size),
-                            fs_format_time(sub_files[j]->modified));
-                    terminal_add_line(term, info);
-                }
-            }
-        }
-    } else if (strcmp(command, "cd") == 0) {
-        char* dir = strtok(NULL, " ");
-        if (dir && fs_change_dir(term->fs, dir))
-            terminal_add_line(term, "Directory changed");
-        else
-            terminal_add_line(term, "Error: Invalid directory");
-    } else if (strcmp(command, "pwd") == 0) {
-        terminal_add_line(term, fs_get_current_path(term->fs));
-    } else if (strcmp(command, "nedir") == 0) {
-        char* dir = strtok(NULL, " ");
-        if (dir && fs_create_file(term->fs, dir, true))
-            terminal_add_line(term, "Directory created");
-        else
-            terminal_add_line(term, "Error: Could not create directory");
-    }
-    // Further commands can be added here
+    } else {
+        // Builtins are looked up in the command table; the line itself is left untouched
+        CommandContext ctx = {term, term->fs};
+        command_run_line(&ctx, line);
+    }
 
     term->current_command[0] = '\0';
     term->cursor_position = 0;
@@ -163,32 +369,54 @@ void terminal_render(Terminal* term, SDL_Renderer* renderer, TTF_Font* font, SDL
     SDL_RenderFillRect(renderer, &content_area);
 
     SDL_Color text_color = {0, 255, 0, 255};
+
+    // Cached textures belong to one renderer and font
+    if (term->cache_renderer != renderer || term->cache_font != font) {
+        terminal_cache_flush(term);
+        term->cache_renderer = renderer;
+        term->cache_font = font;
+    }
+    term->render_frame++;
     
-    // Calculate the range of lines to display for history (excluding cwd and prompt)
-    int start_line = term->scroll_position;
-    int end_line = start_line + term->visible_lines;
-    if (end_line > term->line_count) end_line = term->line_count;
+    // Re-wrap the visible window only when the lines, view or size changed;
+    // a static screen just redraws the textures picked last frame.
+    if (term->row_slot_count < 0 ||
+        term->rendered_version != term->content_version ||
+        term->rendered_view != term->view_version ||
+        term->rendered_wrap != term->max_chars_per_line ||
+        term->rendered_visible != term->visible_lines) {
+        terminal_layout(term);
+        for (int i = 0; i < term->row_slot_count; i++) {
+            const TerminalRow* row = &term->rows[i];
+            char text[TERMINAL_MAX_ROW_CHARS + 1];
+            memcpy(text, scrollback_get(&term->scrollback, row->line, NULL) + row->start, row->length);
+            text[row->length] = '\0';
+            term->row_slots[i] = terminal_cache_lookup(term, renderer, font, text, 0, text_color);
+        }
+        term->rendered_version = term->content_version;
+        term->rendered_view = term->view_version;
+        term->rendered_wrap = term->max_chars_per_line;
+        term->rendered_visible = term->visible_lines;
+    }
 
     // Render terminal history lines
-    for (int i = start_line; i < end_line; i++) {
-        SDL_Surface* surface = TTF_RenderText_Solid(font, term->lines[i], text_color);
-        if (surface) {
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-            SDL_Rect position = {
-                content_area.x + 5,
-                content_area.y + (i - start_line) * CHAR_HEIGHT,
-                surface->w,
-                surface->h
-            };
-            SDL_RenderCopy(renderer, texture, NULL, &position);
-            SDL_DestroyTexture(texture);
-            SDL_FreeSurface(surface);
+    for (int i = 0; i < term->row_slot_count; i++) {
+        int x = content_area.x + 5;
+        int y = content_area.y + i * CHAR_HEIGHT;
+        int slot = term->row_slots[i];
+        if (slot >= 0) {
+            term->line_cache[slot].last_used = term->render_frame;
+            terminal_cache_draw(renderer, font, &term->line_cache[slot], x, y, text_color);
+        } else {
+            const TerminalRow* row = &term->rows[i];
+            const char* text = scrollback_get(&term->scrollback, row->line, NULL) + row->start;
+            glyph_atlas_draw_text_n(renderer, font, text, row->length, x, y, text_color);
         }
     }
 
     // Render current working directory above prompt
     char cwd_buffer[MAX_PATH];
-    strcpy(cwd_buffer, fs_get_current_path(term->fs));
+    if (!fs_get_current_path(term->fs, cwd_buffer, sizeof(cwd_buffer))) strcpy(cwd_buffer, "?");
     char cwd_display[MAX_PATH];
     int max_chars = term->max_chars_per_line - 5; // allow space for "cwd: "
     if ((int)strlen(cwd_buffer) > max_chars) {
@@ -203,41 +431,39 @@ void terminal_render(Terminal* term, SDL_Renderer* renderer, TTF_Font* font, SDL
     if (written >= sizeof(cwd_text)) {
         fprintf(stderr, "CWD text truncation detected in terminal_render\n");
     }
-    SDL_Surface* cwdSurface = TTF_RenderText_Solid(font, cwd_text, text_color);
-    if (cwdSurface) {
-        SDL_Texture* cwdTexture = SDL_CreateTextureFromSurface(renderer, cwdSurface);
-        SDL_Rect cwdRect = {
-            content_area.x + 5,
-            content_area.y + content_area.h - 2 * CHAR_HEIGHT,
-            cwdSurface->w,
-            cwdSurface->h
-        };
-        SDL_RenderCopy(renderer, cwdTexture, NULL, &cwdRect);
-        SDL_DestroyTexture(cwdTexture);
-        SDL_FreeSurface(cwdSurface);
+    Uint32 cwd_hash = terminal_hash_text(cwd_text);
+    if (!terminal_cache_matches(&term->cwd_cache, cwd_text, cwd_hash, term->max_chars_per_line)) {
+        terminal_cache_store(term, &term->cwd_cache, renderer, font, cwd_text, cwd_hash,
+                             term->max_chars_per_line, text_color);
     }
+    terminal_cache_draw(renderer, font, &term->cwd_cache,
+                        content_area.x + 5,
+                        content_area.y + content_area.h - 2 * CHAR_HEIGHT,
+                        text_color);
     
     // Render command line in fixed position at bottom
-    char prompt[MAX_COMMAND_LENGTH + 3];
-    snprintf(prompt, sizeof(prompt), "> %s", term->current_command);
-    SDL_Surface* surface = TTF_RenderText_Solid(font, prompt, text_color);
-    if (surface) {
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_Rect position = {
-            content_area.x + 5,
-            content_area.y + content_area.h - CHAR_HEIGHT,
-            surface->w,
-            surface->h
-        };
-        SDL_RenderCopy(renderer, texture, NULL, &position);
-        SDL_DestroyTexture(texture);
-        SDL_FreeSurface(surface);
+    char prompt[2 * MAX_COMMAND_LENGTH + 32];
+    if (term->searching) {
+        snprintf(prompt, sizeof(prompt), "(reverse-i-search)`%s': %s", term->search_query,
+                 term->search_match >= 0 ? term->current_command : "");
+    } else {
+        snprintf(prompt, sizeof(prompt), "> %s", term->current_command);
     }
+    Uint32 prompt_hash = terminal_hash_text(prompt);
+    if (!terminal_cache_matches(&term->prompt_cache, prompt, prompt_hash, term->max_chars_per_line)) {
+        terminal_cache_store(term, &term->prompt_cache, renderer, font, prompt, prompt_hash,
+                             term->max_chars_per_line, text_color);
+    }
+    terminal_cache_draw(renderer, font, &term->prompt_cache,
+                        content_area.x + 5,
+                        content_area.y + content_area.h - CHAR_HEIGHT,
+                        text_color);
 
-    // Draw scrollbar if needed
-    if (term->line_count > term->visible_lines) {
-        int scrollbar_height = (content_area.h - 2 * CHAR_HEIGHT) * term->visible_lines / term->line_count;
-        int scrollbar_position = (content_area.h - 2 * CHAR_HEIGHT) * term->scroll_position / term->line_count;
+    // Draw scrollbar if needed. Total wrapped rows are never computed, so the
+    // bar is sized and placed by logical lines.
+    if (term->scrollback.count > term->visible_lines && term->row_slot_count > 0) {
+        int scrollbar_height = (content_area.h - 2 * CHAR_HEIGHT) * term->visible_lines / term->scrollback.count;
+        int scrollbar_position = (content_area.h - 2 * CHAR_HEIGHT) * term->rows[0].line / term->scrollback.count;
         
         SDL_Rect scrollbar = {
             content_area.x + content_area.w - 8,
@@ -250,7 +476,170 @@ void terminal_render(Terminal* term, SDL_Renderer* renderer, TTF_Font* font, SDL
     }
 }
 
+typedef struct {
+    char line[MAX_COMMAND_LENGTH];
+    size_t used;
+    int shown;
+} TerminalMatchList;
+
+// Collects candidate names into one output line
+static bool terminal_collect_match(const char* key, void* value, void* user) {
+    TerminalMatchList* list = user;
+    size_t length = strlen(key);
+    if (list->used + length + 2 >= sizeof(list->line)) {
+        snprintf(list->line + list->used, sizeof(list->line) - list->used, " ...");
+        return false;
+    }
+    list->used += snprintf(list->line + list->used, sizeof(list->line) - list->used,
+                           list->shown ? "  %s" : "%s", key);
+    list->shown++;
+    return true;
+}
+
+// Completes the word before the cursor: the first word against command names,
+// later words against the entries of the directory they name.
+static void terminal_complete(Terminal* term) {
+    char* line = term->current_command;
+    int end = term->cursor_position;
+    line[end] = '\0';
+
+    int start = end;
+    while (start > 0 && line[start - 1] != ' ') start--;
+    bool is_command = true;
+    for (int i = 0; i < start; i++) {
+        if (line[i] != ' ') is_command = false;
+    }
+
+    const char* word = line + start;
+    const char* base = word;
+    const Trie* index = NULL;
+    if (is_command) {
+        index = command_index();
+    } else {
+        FileNode* dir = term->fs->current_dir;
+        const char* slash = strrchr(word, '/');
+        if (slash) {
+            char dir_path[MAX_COMMAND_LENGTH];
+            size_t dir_length = slash == word ? 1 : (size_t)(slash - word);
+            memcpy(dir_path, word, dir_length);
+            dir_path[dir_length] = '\0';
+            dir = fs_get_file(term->fs, dir_path);
+            base = slash + 1;
+        }
+        if (!dir || !dir->is_directory) return;
+        index = dir->index;
+    }
+
+    char completed[TRIE_MAX_KEY];
+    int matches = trie_complete(index, base, completed, sizeof(completed));
+    if (matches == 0) return;
+
+    size_t base_length = strlen(base);
+    size_t extra = strlen(completed) - base_length;
+    if (matches > 1 && extra == 0) {
+        // Nothing shared to add: show the candidates instead
+        TerminalMatchList list = {{0}, 0, 0};
+        trie_each_prefix(index, base, terminal_collect_match, &list);
+        terminal_add_line(term, list.line);
+        return;
+    }
+
+    // Unique matches also get a separator: '/' after directories, else a space
+    char suffix = 0;
+    if (matches == 1) {
+        if (is_command) {
+            suffix = ' ';
+        } else {
+            FileNode* node = trie_find(index, completed);
+            suffix = node && node->is_directory ? '/' : ' ';
+        }
+    }
+    if (end + extra + (suffix ? 1 : 0) >= MAX_COMMAND_LENGTH) return;
+    memcpy(line + end, completed + base_length, extra);
+    end += (int)extra;
+    if (suffix) line[end++] = suffix;
+    line[end] = '\0';
+    term->cursor_position = end;
+}
+
+// Shows a history entry on the command line
+static void terminal_show_history(Terminal* term, int index) {
+    const char* entry = index >= 0 ? history_get(&term->history, index) : "";
+    snprintf(term->current_command, sizeof(term->current_command), "%s", entry ? entry : "");
+    term->cursor_position = strlen(term->current_command);
+}
+
+// Looks for the query in entries older than 'before' and shows the hit
+static void terminal_search_history(Terminal* term, int before) {
+    int match = history_search(&term->history, term->search_query, before);
+    if (match >= 0) {
+        term->search_match = match;
+        terminal_show_history(term, match);
+    }
+}
+
+// Key handling while Ctrl-R search is active. Returns false if the key ends
+// the search and should then be handled normally.
+static bool terminal_search_keypress(Terminal* term, SDL_KeyboardEvent* event) {
+    SDL_Keycode key = event->keysym.sym;
+    size_t length = strlen(term->search_query);
+
+    if ((event->keysym.mod & KMOD_CTRL) && key == SDLK_r) {
+        // Next older match
+        terminal_search_history(term, term->search_match >= 0 ? term->search_match : term->history.count);
+        return true;
+    }
+    if (key == SDLK_BACKSPACE) {
+        if (length > 0) term->search_query[length - 1] = '\0';
+        term->search_match = -1;
+        terminal_search_history(term, term->history.count);
+        return true;
+    }
+    if (key == SDLK_ESCAPE) {
+        term->searching = false;
+        return true;
+    }
+    if (key >= 32 && key < 127 && !(event->keysym.mod & KMOD_CTRL)) {
+        if (length + 1 < sizeof(term->search_query)) {
+            term->search_query[length] = (char)key;
+            term->search_query[length + 1] = '\0';
+        }
+        // A longer query can still match the current entry
+        terminal_search_history(term, term->search_match >= 0 ? term->search_match + 1 : term->history.count);
+        return true;
+    }
+
+    // Anything else accepts the match; Enter runs it
+    term->searching = false;
+    return false;
+}
+
 void terminal_handle_keypress(Terminal* term, SDL_KeyboardEvent* event) {
+    Job* foreground = job_foreground();
+    if ((event->keysym.mod & KMOD_CTRL) && event->keysym.sym == SDLK_c) {
+        term->searching = false;
+        if (foreground) {
+            job_cancel(foreground);
+        } else {
+            // Abandon the line being typed
+            char cmd[MAX_COMMAND_LENGTH + 8];
+            snprintf(cmd, sizeof(cmd), "> %s^C", term->current_command);
+            terminal_add_line(term, cmd);
+            term->current_command[0] = '\0';
+            term->cursor_position = 0;
+        }
+        return;
+    }
+    if (foreground) return;  // Typing resumes once the fg job ends
+
+    if (term->searching && terminal_search_keypress(term, event)) return;
+    if ((event->keysym.mod & KMOD_CTRL) && event->keysym.sym == SDLK_r) {
+        term->searching = true;
+        term->search_query[0] = '\0';
+        term->search_match = -1;
+        return;
+    }
+
     if (event->keysym.sym == SDLK_RETURN) {
         terminal_execute_command(term);
     } else if (event->keysym.sym == SDLK_BACKSPACE) {
@@ -259,35 +648,33 @@ void terminal_handle_keypress(Terminal* term, SDL_KeyboardEvent* event) {
             term->current_command[term->cursor_position] = '\0';
         }
     } else if (event->keysym.sym == SDLK_UP) {
-        if (term->history_position < term->history_count - 1) {
-            term->history_position++;
-            strcpy(term->current_command, term->command_history[term->history_position]);
-            term->cursor_position = strlen(term->current_command);
+        // Step from the newest entry towards older ones
+        if (term->history_position < 0) {
+            term->history_position = term->history.count;
         }
-    } else if (event->keysym.sym == SDLK_DOWN) {
         if (term->history_position > 0) {
             term->history_position--;
-            strcpy(term->current_command, term->command_history[term->history_position]);
-            term->cursor_position = strlen(term->current_command);
+            terminal_show_history(term, term->history_position);
+        }
+    } else if (event->keysym.sym == SDLK_DOWN) {
+        // Step back towards the newest entry, then to an empty line
+        if (term->history_position >= 0 && term->history_position < term->history.count - 1) {
+            term->history_position++;
+            terminal_show_history(term, term->history_position);
         } else {
-            term->current_command[0] = '\0';
-            term->cursor_position = 0;
+            term->history_position = -1;
+            terminal_show_history(term, -1);
         }
+    } else if (event->keysym.sym == SDLK_TAB) {
+        terminal_complete(term);
     } else if (event->keysym.sym == SDLK_LEFT) {
         if (term->cursor_position > 0) term->cursor_position--;
     } else if (event->keysym.sym == SDLK_RIGHT) {
         if (term->cursor_position < strlen(term->current_command)) term->cursor_position++;
     } else if (event->keysym.sym == SDLK_PAGEUP) {
-        if (term->scroll_position > 0) {
-            term->scroll_position -= term->visible_lines;
-            if (term->scroll_position < 0) term->scroll_position = 0;
-        }
+        terminal_scroll(term, -term->visible_lines);
     } else if (event->keysym.sym == SDLK_PAGEDOWN) {
-        int max_scroll = term->line_count - term->visible_lines;
-        if (term->scroll_position < max_scroll) {
-            term->scroll_position += term->visible_lines;
-            if (term->scroll_position > max_scroll) term->scroll_position = max_scroll;
-        }
+        terminal_scroll(term, term->visible_lines);
     } else {
         if (term->cursor_position < MAX_COMMAND_LENGTH - 1) {
             term->current_command[term->cursor_position] = event->keysym.sym;
@@ -301,28 +688,19 @@ void terminal_handle_keypress(Terminal* term, SDL_KeyboardEvent* event) {
 void terminal_handle_mouse(Terminal* term, SDL_MouseWheelEvent* event) {
     // Scroll up
     if (event->y > 0) {
-        if (term->scroll_position > 0) {
-            term->scroll_position--;
-        }
+        terminal_scroll(term, -1);
     }
     // Scroll down
     else if (event->y < 0) {
-        int max_scroll = term->line_count - term->visible_lines;
-        if (term->scroll_position < max_scroll) {
-            term->scroll_position++;
-        }
+        terminal_scroll(term, 1);
     }
 }
 
 void terminal_open_file_view(Terminal* term, const char* path) {
-    char* content = fs_read_file(term->fs, path);
+    const char* content = fs_read_file(term->fs, path);
     if (content) {
         terminal_add_line(term, "Viewing file:");
-        char* line = strtok(content, "\n");
-        while (line) {
-            terminal_add_line(term, line);
-            line = strtok(NULL, "\n");
-        }
+        terminal_add_text(term, content, strlen(content));
     } else {
         terminal_add_line(term, "Error: File not found or cannot be read.");
     }
@@ -342,14 +720,84 @@ void terminal_open_file_edit(Terminal* term, const char* path) {
 }
 
 void terminal_reset(Terminal* term) {
-    // Clear all lines except the first two (welcome messages)
-    for (int i = 2; i < term->line_count; i++) {
-        free(term->lines[i]);
-    }
-    term->line_count = 2;
+    // Clear all lines except the welcome messages
+    scrollback_clear(&term->scrollback);
+    terminal_add_banner(term);
     term->cursor_position = 0;
-    term->scroll_position = 0;
+    term->follow_output = true;
+    term->view_version++;
     term->current_command[0] = '\0';
-    term->history_count = 0;
+    // History is persisted in the VFS, so it survives a reboot
     term->history_position = -1;
+    term->searching = false;
+}
+
+void terminal_clear(Terminal* term) {
+    scrollback_clear(&term->scrollback);
+    term->follow_output = true;
+    term->view_version++;
+    term->content_version++;
+}
+
+static int terminal_cmd_help(CommandContext* ctx, int argc, char** argv) {
+    // Pad the usage column to the longest entry
+    int width = 13;
+    for (int i = 0; i < command_count(); i++) {
+        int length = (int)strlen(command_at(i)->usage);
+        if (length > width) width = length;
+    }
+    command_print(ctx, "Available commands:");
+    for (int i = 0; i < command_count(); i++) {
+        const Command* command = command_at(i);
+        command_printf(ctx, "  %-*s - %s", width, command->usage, command->description);
+    }
+    return 0;
+}
+
+static int terminal_cmd_clear(CommandContext* ctx, int argc, char** argv) {
+    if (!command_require_foreground(ctx, argv[0])) return 1;
+    terminal_clear(ctx->term);
+    return 0;
+}
+
+static int terminal_cmd_view(CommandContext* ctx, int argc, char** argv) {
+    if (argc < 2) {
+        command_print(ctx, "Error: No file specified.");
+        return 1;
+    }
+    size_t size;
+    const char* content = fs_read_file_n(ctx->fs, argv[1], &size);
+    if (!content) {
+        command_print(ctx, "Error: File not found or cannot be read.");
+        return 1;
+    }
+    command_print(ctx, "Viewing file:");
+    command_print_text(ctx, content, size);
+    return 0;
+}
+
+static int terminal_cmd_edit(CommandContext* ctx, int argc, char** argv) {
+    if (argc < 2) {
+        command_print(ctx, "Error: No file specified.");
+        return 1;
+    }
+    if (!command_require_foreground(ctx, argv[0])) return 1;
+    terminal_open_file_edit(ctx->term, argv[1]);
+    return 0;
+}
+
+static int terminal_cmd_reboot(CommandContext* ctx, int argc, char** argv) {
+    // The main loop owns the OS state, so it performs the actual reboot
+    if (!command_require_foreground(ctx, argv[0])) return 1;
+    ctx->term->reboot_requested = true;
+    return 0;
+}
+
+void terminal_register_commands(void) {
+    command_register("help", "help", "Show this list", terminal_cmd_help);
+    command_register("clear", "clear", "Clear terminal", terminal_cmd_clear);
+    command_register("view", "view <file>", "Display file contents with a header", terminal_cmd_view);
+    command_register("edit", "edit <file>", "Edit file", terminal_cmd_edit);
+    command_register("miVo", "miVo <file>", "Edit file", terminal_cmd_edit);
+    command_register("reboot", "reboot", "Reboots / Restarts the system", terminal_cmd_reboot);
 }
@@ -2,27 +2,76 @@
 #define MICROOS_TERMINAL_H
 
 #include "filesystem.h"
+#include "scrollback.h"
+#include "history.h"
 #include <SDL.h>
 #include <SDL_ttf.h>
 
-#define MAX_COMMAND_HISTORY 100
 #define MAX_COMMAND_LENGTH 256
-#define MAX_TERMINAL_LINES 1000
+#define MAX_TERMINAL_LINES 10000  // Scrollback lines kept before the oldest are evicted
+#define TERMINAL_SCROLLBACK_CHUNKS 64 // Arena chunks of line text (64 KB each)
 #define CHAR_WIDTH 10  // Increase from 8 to 10
 #define CHAR_HEIGHT 20 // Increase from 16 to 20
+#define TERMINAL_LINE_CACHE_SIZE 128 // Rasterized lines kept between frames
+#define TERMINAL_MAX_ROW_CHARS 512   // Upper bound on the wrap width
 
+// One rasterized line, keyed on its content and the wrap width it was laid out for
 typedef struct {
-    char* lines[MAX_TERMINAL_LINES];
-    int line_count;
+    char* text;           // Copy of the rendered content (NULL if the slot is free)
+    Uint32 hash;          // Hash of text, checked before comparing strings
+    int wrap_width;       // max_chars_per_line when the texture was built
+    SDL_Texture* texture;
+    int w;
+    int h;
+    Uint32 last_used;     // Frame stamp used to evict the least recently drawn line
+} TerminalLineCache;
+
+// One visible screen row: a slice of a logical scrollback line
+typedef struct {
+    int line;             // Scrollback index of the logical line
+    int start;            // Byte offset of the row within the line
+    int length;
+} TerminalRow;
+
+typedef struct Terminal {
+    Scrollback scrollback;  // Ring buffer of output lines, oldest first
     char current_command[MAX_COMMAND_LENGTH];
     int cursor_position;
-    int scroll_position;  // Number of lines scrolled
+    // View position. Lines are stored unwrapped and only the visible window is
+    // wrapped, so the view is anchored to a logical line rather than a row.
+    bool follow_output;   // Keep the newest line at the bottom
+    unsigned long long scroll_seq; // Scrollback sequence number of the top line when not following
+    int scroll_row;       // Wrapped row of that line shown first
+    Uint32 view_version;  // Bumped whenever the view position changes
     int visible_lines;    // Number of lines that can be displayed
     int max_chars_per_line; // Maximum characters per line
     FileSystem* fs;
-    char command_history[MAX_COMMAND_HISTORY][MAX_COMMAND_LENGTH];
-    int history_count;
-    int history_position;
+    History history;        // Persistent command log
+    int history_position;   // Entry shown by Up/Down, or -1 while typing a new line
+
+    // Ctrl-R reverse incremental search
+    bool searching;
+    char search_query[MAX_COMMAND_LENGTH];
+    int search_match;       // History entry currently shown, or -1
+
+    // Retained render state: only lines whose content changed get re-rasterized
+    TerminalLineCache line_cache[TERMINAL_LINE_CACHE_SIZE];
+    TerminalLineCache cwd_cache;
+    TerminalLineCache prompt_cache;
+    TerminalRow* rows;       // Wrapped rows of the visible window, top to bottom
+    int* row_slots;          // Cache slot drawn on each visible row during the last frame
+    int row_capacity;
+    int row_slot_count;
+    Uint32 content_version;  // Bumped whenever the history lines change
+    Uint32 rendered_version; // content_version the rows were laid out for
+    Uint32 rendered_view;    // view_version the rows were laid out for
+    int rendered_wrap;       // max_chars_per_line the rows were laid out for
+    int rendered_visible;    // visible_lines the rows were laid out for
+    Uint32 render_frame;
+    SDL_Renderer* cache_renderer;
+    TTF_Font* cache_font;
+
+    bool reboot_requested;   // Set by the reboot builtin, handled by the main loop
 } Terminal;
 
 Terminal* terminal_create(FileSystem* fs);
@@ -30,16 +79,25 @@ void terminal_destroy(Terminal* term);  // declaration only, remove inline defin
 void terminal_handle_keypress(Terminal* term, SDL_KeyboardEvent* event);
 void terminal_execute_command(Terminal* term);
 void terminal_add_line(Terminal* term, const char* line);
+// Appends a block of newline-separated output in one go (e.g. a whole file)
+void terminal_add_text(Terminal* term, const char* text, size_t length);
 void terminal_render(Terminal* term, SDL_Renderer* renderer, TTF_Font* font, SDL_Rect content_area);
 
 // Add new function declaration
 void terminal_handle_mouse(Terminal* term, SDL_MouseWheelEvent* event);
 
+// Scrolls the view by wrapped rows (negative is up, towards older output)
+void terminal_scroll(Terminal* term, int rows);
+
 // Add new function declarations for opening files in view and edit modes
 void terminal_open_file_view(Terminal* term, const char* path);
 void terminal_open_file_edit(Terminal* term, const char* path);
 
 // Add new function declaration
 void terminal_reset(Terminal* term);
+void terminal_clear(Terminal* term);
+
+// Registers the terminal's own builtins (help, clear, view, reboot)
+void terminal_register_commands(void);
 
 #endif // MICROOS_TERMINAL_H
@@ -0,0 +1,292 @@
+#include "trie.h"
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIE_COMPACT_MIN 32  // Unlinked nodes a shared trie keeps before compacting
+
+// The pool a reader walks. A shared trie's writer may swap in a new one at
+// any time, so each walk loads it once and keeps to it.
+static const TrieNode* trie_pool(const Trie* trie) {
+    return SDL_AtomicGetPtr((void**)&trie->nodes);
+}
+
+// Swaps in a new pool for a shared trie and retires the old one
+static void trie_publish(Trie* trie, TrieNode* pool) {
+    TrieNode* old = SDL_AtomicSetPtr((void**)&trie->nodes, pool);
+    trie->retire(old, trie->retire_user);
+}
+
+// Readers may see a count a writer is changing, so it is always accessed atomically
+static int trie_count(const TrieNode* nodes, int node) {
+    return SDL_AtomicGet((SDL_atomic_t*)&nodes[node].count);
+}
+
+static int trie_alloc_node(Trie* trie, unsigned char byte) {
+    int index;
+    if (trie->free_list >= 0) {
+        index = trie->free_list;
+        trie->free_list = trie->nodes[index].next_sibling;
+    } else {
+        if (trie->node_count == trie->capacity) {
+            trie->capacity = trie->capacity ? trie->capacity * 2 : 16;
+            if (trie->retire && trie->nodes) {
+                TrieNode* pool = malloc(sizeof(TrieNode) * trie->capacity);
+                memcpy(pool, trie->nodes, sizeof(TrieNode) * trie->node_count);
+                trie_publish(trie, pool);
+            } else {
+                trie->nodes = realloc(trie->nodes, sizeof(TrieNode) * trie->capacity);
+            }
+        }
+        index = trie->node_count++;
+    }
+    trie->nodes[index] = (TrieNode){-1, -1, {0}, byte, NULL};
+    return index;
+}
+
+static void trie_free_subtree(Trie* trie, int index) {
+    int child = trie->nodes[index].first_child;
+    while (child >= 0) {
+        int next = trie->nodes[child].next_sibling;
+        trie_free_subtree(trie, child);
+        child = next;
+    }
+    trie->nodes[index].next_sibling = trie->free_list;
+    trie->free_list = index;
+}
+
+// Nodes in an unlinked branch of a shared trie, which readers may still be in
+static int trie_count_subtree(const Trie* trie, int index) {
+    int count = 1;
+    for (int child = trie->nodes[index].first_child; child >= 0; child = trie->nodes[child].next_sibling) {
+        count += trie_count_subtree(trie, child);
+    }
+    return count;
+}
+
+// Copies the branch at index into to, children kept in order. Returns its new index.
+static int trie_copy(const TrieNode* from, int index, TrieNode* to, int* count) {
+    int copy = (*count)++;
+    to[copy] = from[index];
+    int* link = &to[copy].first_child;
+    for (int child = from[index].first_child; child >= 0; child = from[child].next_sibling) {
+        int copied = trie_copy(from, child, to, count);
+        *link = copied;
+        link = &to[copied].next_sibling;
+    }
+    *link = -1;
+    return copy;
+}
+
+// Moves a shared trie's live nodes into a fresh pool
+static void trie_compact(Trie* trie) {
+    TrieNode* pool = malloc(sizeof(TrieNode) * trie->capacity);
+    if (!pool) return;  // Keeps the dead nodes a while longer
+    int count = 0;
+    trie_copy(trie->nodes, 0, pool, &count);
+    trie->node_count = count;
+    trie->dead = 0;
+    trie_publish(trie, pool);
+}
+
+Trie* trie_create(void) {
+    Trie* trie = calloc(1, sizeof(Trie));
+    trie->free_list = -1;
+    trie_alloc_node(trie, 0);
+    return trie;
+}
+
+Trie* trie_create_shared(TrieRetire retire, void* user) {
+    Trie* trie = trie_create();
+    if (!trie) return NULL;
+    trie->retire = retire;
+    trie->retire_user = user;
+    return trie;
+}
+
+void trie_destroy(Trie* trie) {
+    if (!trie) return;
+    if (trie->retire) {
+        trie->retire(trie->nodes, trie->retire_user);
+        trie->retire(trie, trie->retire_user);
+        return;
+    }
+    free(trie->nodes);
+    free(trie);
+}
+
+static int trie_find_child(const TrieNode* nodes, int parent, unsigned char byte) {
+    int child = nodes[parent].first_child;
+    while (child >= 0 && nodes[child].byte < byte) {
+        child = nodes[child].next_sibling;
+    }
+    return (child >= 0 && nodes[child].byte == byte) ? child : -1;
+}
+
+// Node reached by walking the first length bytes of key, or -1
+static int trie_walk_n(const TrieNode* nodes, const char* key, size_t length) {
+    int node = 0;
+    for (size_t i = 0; i < length && node >= 0; i++) {
+        node = trie_find_child(nodes, node, (unsigned char)key[i]);
+    }
+    return node;
+}
+
+static int trie_walk(const TrieNode* nodes, const char* key) {
+    return trie_walk_n(nodes, key, strlen(key));
+}
+
+// Finds or creates the child for byte, keeping siblings sorted
+static int trie_child(Trie* trie, int parent, unsigned char byte) {
+    int prev = -1;
+    int child = trie->nodes[parent].first_child;
+    while (child >= 0 && trie->nodes[child].byte < byte) {
+        prev = child;
+        child = trie->nodes[child].next_sibling;
+    }
+    if (child >= 0 && trie->nodes[child].byte == byte) return child;
+
+    // trie_alloc_node may move the pool, so only hold indices across it
+    int created = trie_alloc_node(trie, byte);
+    trie->nodes[created].next_sibling = child;
+    SDL_MemoryBarrierRelease();  // Readers reach the node only once it is built
+    if (prev >= 0) {
+        trie->nodes[prev].next_sibling = created;
+    } else {
+        trie->nodes[parent].first_child = created;
+    }
+    return created;
+}
+
+bool trie_insert(Trie* trie, const char* key, void* value) {
+    size_t length = strlen(key);
+    if (length >= TRIE_MAX_KEY) return false;
+
+    int existing = trie_walk(trie->nodes, key);
+    if (existing >= 0 && trie->nodes[existing].value) {
+        SDL_MemoryBarrierRelease();
+        trie->nodes[existing].value = value;
+        return true;
+    }
+
+    int path[TRIE_MAX_KEY];
+    path[0] = 0;
+    for (size_t i = 0; i < length; i++) {
+        path[i + 1] = trie_child(trie, path[i], (unsigned char)key[i]);
+    }
+    SDL_MemoryBarrierRelease();
+    trie->nodes[path[length]].value = value;
+    // Counts go up only once the key can be found, and down before it goes
+    // (see trie_remove), so skipping by count never skips a reachable key
+    for (size_t i = 0; i <= length; i++) {
+        SDL_AtomicAdd(&trie->nodes[path[i]].count, 1);
+    }
+    return true;
+}
+
+bool trie_remove(Trie* trie, const char* key) {
+    int target = trie_walk(trie->nodes, key);
+    if (target < 0 || !trie->nodes[target].value) return false;
+
+    size_t length = strlen(key);  // Under TRIE_MAX_KEY, as trie_insert took it
+    int path[TRIE_MAX_KEY];
+    path[0] = 0;
+    for (size_t i = 0; i < length; i++) {
+        path[i + 1] = trie_find_child(trie->nodes, path[i], (unsigned char)key[i]);
+    }
+    size_t prune = 0;  // Shallowest node left without keys, if not the root
+    for (size_t i = 0; i <= length; i++) {
+        if (SDL_AtomicAdd(&trie->nodes[path[i]].count, -1) == 1 && i > 0 && prune == 0) prune = i;
+    }
+    if (prune == 0) {
+        trie->nodes[target].value = NULL;
+        return true;
+    }
+
+    // Nothing else lives below here: unlink and recycle the whole branch
+    int child = path[prune];
+    int* link = &trie->nodes[path[prune - 1]].first_child;
+    while (*link != child) link = &trie->nodes[*link].next_sibling;
+    *link = trie->nodes[child].next_sibling;
+    if (!trie->retire) {
+        trie_free_subtree(trie, child);
+        return true;
+    }
+    // Readers may be inside the branch, so it stays as it is until the pool is replaced
+    trie->dead += trie_count_subtree(trie, child);
+    if (trie->dead >= TRIE_COMPACT_MIN && trie->dead * 2 > trie->node_count) trie_compact(trie);
+    return true;
+}
+
+void* trie_find(const Trie* trie, const char* key) {
+    return trie_find_n(trie, key, strlen(key));
+}
+
+void* trie_find_n(const Trie* trie, const char* key, size_t length) {
+    if (!trie) return NULL;
+    const TrieNode* nodes = trie_pool(trie);
+    int node = trie_walk_n(nodes, key, length);
+    return node >= 0 ? nodes[node].value : NULL;
+}
+
+int trie_complete(const Trie* trie, const char* prefix, char* out, size_t out_size) {
+    size_t length = strlen(prefix);
+    if (out_size == 0 || length >= out_size) return 0;
+    memcpy(out, prefix, length + 1);
+
+    if (!trie) return 0;
+    const TrieNode* nodes = trie_pool(trie);
+    int node = trie_walk(nodes, prefix);
+    if (node < 0 || trie_count(nodes, node) == 0) return 0;
+
+    // Follow the branch while every match continues with the same byte
+    while (!nodes[node].value && length + 1 < out_size) {
+        int child = nodes[node].first_child;
+        if (child < 0 || nodes[child].next_sibling >= 0) break;
+        out[length++] = (char)nodes[child].byte;
+        node = child;
+    }
+    out[length] = '\0';
+    return trie_count(nodes, node);
+}
+
+static bool trie_visit(const TrieNode* nodes, int node, char* key, size_t length, int* skip,
+                       TrieVisitor visit, void* user) {
+    int count = trie_count(nodes, node);
+    if (*skip >= count) {
+        *skip -= count;
+        return true;
+    }
+    void* value = nodes[node].value;
+    if (value) {
+        if (*skip > 0) {
+            (*skip)--;
+        } else {
+            key[length] = '\0';
+            if (!visit(key, value, user)) return false;
+        }
+    }
+    if (length + 1 >= TRIE_MAX_KEY) return true;
+    for (int child = nodes[node].first_child; child >= 0; child = nodes[child].next_sibling) {
+        key[length] = (char)nodes[child].byte;
+        if (!trie_visit(nodes, child, key, length + 1, skip, visit, user)) return false;
+    }
+    return true;
+}
+
+void trie_each_range(const Trie* trie, const char* prefix, int skip, TrieVisitor visit, void* user) {
+    size_t length = strlen(prefix);
+    if (!trie || length >= TRIE_MAX_KEY) return;
+    const TrieNode* nodes = trie_pool(trie);
+    int node = trie_walk(nodes, prefix);
+    if (node < 0) return;
+
+    char key[TRIE_MAX_KEY];
+    memcpy(key, prefix, length);
+    if (skip < 0) skip = 0;
+    trie_visit(nodes, node, key, length, &skip, visit, user);
+}
+
+void trie_each_prefix(const Trie* trie, const char* prefix, TrieVisitor visit, void* user) {
+    trie_each_range(trie, prefix, 0, visit, user);
+}
@@ -0,0 +1,70 @@
+#ifndef MICROOS_TRIE_H
+#define MICROOS_TRIE_H
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TRIE_MAX_KEY 256  // Longest key, including the terminator
+
+// Byte-wise prefix tree mapping strings to non-NULL values. Nodes live in one
+// pool and each keeps its children as a list sorted by byte, so walking a
+// prefix costs O(key length) and keys come out in sorted order.
+typedef struct {
+    int first_child;      // -1 if none
+    int next_sibling;     // Next child of the same parent (higher byte), or free list link
+    SDL_atomic_t count;   // Keys stored at or below this node; never more than a reader can reach
+    unsigned char byte;
+    void* value;          // Set if a key ends here
+} TrieNode;
+
+// Takes memory a shared trie has stopped using
+typedef void (*TrieRetire)(void* memory, void* user);
+
+typedef struct Trie {
+    TrieNode* nodes;      // nodes[0] is the root
+    int node_count;
+    int capacity;
+    int free_list;
+    TrieRetire retire;    // Shared tries only: where replaced pools go
+    void* retire_user;
+    int dead;             // Shared tries: unlinked nodes the pool still holds
+} Trie;
+
+// Called for each key by trie_each_prefix; return false to stop.
+typedef bool (*TrieVisitor)(const char* key, void* value, void* user);
+
+// Lookups, completion and visits treat a NULL trie as empty.
+Trie* trie_create(void);
+void trie_destroy(Trie* trie);
+
+// A trie that readers may walk while one writer changes it. Nodes are linked
+// in only once built and are never reused, so a reader always sees a whole
+// key set, old or new. The pool is replaced rather than resized (and, once
+// half of it is unlinked nodes, compacted); old pools and finally the trie
+// itself go to retire, which must keep them alive until readers are done.
+Trie* trie_create_shared(TrieRetire retire, void* user);
+
+// Adds or replaces a key. Returns false if the key is too long.
+bool trie_insert(Trie* trie, const char* key, void* value);
+
+// Removes a key and prunes the branch it leaves empty. Returns false if absent.
+bool trie_remove(Trie* trie, const char* key);
+
+void* trie_find(const Trie* trie, const char* key);
+
+// Looks up the first length bytes of key, which need not be terminated.
+void* trie_find_n(const Trie* trie, const char* key, size_t length);
+
+// Number of keys starting with prefix. out receives the longest prefix they
+// all share (at least the given prefix when any match).
+int trie_complete(const Trie* trie, const char* prefix, char* out, size_t out_size);
+
+// Visits keys starting with prefix in sorted order.
+void trie_each_prefix(const Trie* trie, const char* prefix, TrieVisitor visit, void* user);
+
+// Same as trie_each_prefix but starts at the skip-th match. Whole subtrees are
+// skipped using their key counts, so paging deep into a large trie stays cheap.
+void trie_each_range(const Trie* trie, const char* prefix, int skip, TrieVisitor visit, void* user);
+
+#endif // MICROOS_TRIE_H